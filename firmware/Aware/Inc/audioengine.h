@@ -18,21 +18,58 @@
 #define AUDIOENGINE_ERROR -1
 #define AUDIOENGINE_NOT_INITIALIZED -2
 
+// Processing profiles: the DMA period sets the latency of the input and the output, the DSP block the granularity of gates
+// and parameters. The overhead per period and per block (task switch, parameter fetch, stage setup) is spread over its frames.
+typedef enum {
+    AUDIO_PROFILE_LOW_LATENCY = 0, // 16-frame periods and blocks, for a tight gate response
+    AUDIO_PROFILE_BALANCED,        // 32-frame periods and blocks
+    AUDIO_PROFILE_THROUGHPUT,      // 128-frame periods and blocks, for heavy FX
+    AUDIO_PROFILE_THROUGHPUT_FINE, // 128-frame periods in 32-frame blocks, the wake-ups of THROUGHPUT with the ramps of BALANCED
+    AUDIO_NUM_PROFILES
+} audio_profile_id_t;
+
+typedef struct {
+    uint16_t period_frames; // frames per DMA period, one wake-up of the audio task, at most AUDIO_MAX_PERIOD_FRAMES
+    uint16_t block_frames;  // frames per DSP block, divides period_frames, at most AUDIO_MAX_BLOCK_FRAMES
+} audio_profile_t;
+
 struct audioengine_config {
     I2S_HandleTypeDef* i2s_handle;
     uint32_t sample_rate;
-    uint16_t buffer_size;
+    uint16_t buffer_size; // samples in the DMA ring, AUDIO_DMA_PERIODS periods of the current profile
 
     TaskHandle_t audioTaskHandle;
     volatile int16_t* tx_buf_ptr;
     volatile int16_t* rx_buf_ptr;
 };
 
+// Sets up the ring for CONFIG_AUDIO_PROFILE.
 int init_audioengine(struct audioengine_config* config);
 int start_audio_engine(void);
 
-void audio_get_dma_in_buf(int16_t* buf, uint32_t buf_size);
-void audio_write_dma_out_buf(int16_t* buf, uint32_t buf_size);
+// The profile is fixed at build time by CONFIG_AUDIO_PROFILE.
+audio_profile_id_t audio_profile_id(void);
+const audio_profile_t* audio_profile(void);
+
+// The ring holds AUDIO_DMA_PERIODS periods. Each DMA notification is one more period received, the audio task processes
+// the pending ones oldest first and hands each back with audio_dma_period_done(). A period stays the task's until the DMA
+// comes round to it again, AUDIO_DMA_PERIODS - 1 periods after it was received: its output starts playing then.
+uint32_t audio_dma_pending(void);
+// Skips the pending periods the DMA has come round to already, their output played stale. Returns how many.
+uint32_t audio_dma_drop_overrun(void);
+void audio_dma_period_done(void);
+
+// The oldest pending period in the DMA buffers: the input received and the output it plays. The stages read and write
+// them in place. They are in the non-cacheable .dma_buffer section, so neither needs cache maintenance.
+const int16_t* audio_dma_in_block(void);
+int16_t* audio_dma_out_block(void);
+
+// DWT cycle count at the end of the transfer of the oldest pending period and the cycles between two transfers. Its input
+// came in over the period before that, its output starts playing AUDIO_DMA_PERIODS - 1 periods after it. Needs a pending period.
+void audio_block_timing(uint32_t* end_cycles, uint32_t* period_cycles);
+
+// Overruns, underruns and frame errors of the I2S and transfer errors of its DMA streams since boot.
+uint32_t audio_i2s_errors(void);
 
 // Test Functions
 void generateSineWave(uint16_t* phaseIndex, double phaseIncrement);
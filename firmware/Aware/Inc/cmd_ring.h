@@ -0,0 +1,72 @@
+/**
+ * @file cmd_ring.h
+ * @brief Wait-free single-producer/single-consumer ring of timestamped tape commands, from the gate ISR to the audio task.
+ */
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "stm32h7xx_hal.h"
+
+#define CMD_RING_LEN 16 // slots, a power of 2
+
+#if (CMD_RING_LEN & (CMD_RING_LEN - 1)) != 0
+#error "CMD_RING_LEN must be a power of 2"
+#endif
+
+// Gate command, the payload of the ring
+typedef enum { TAPE_CMD_PLAY, TAPE_CMD_STOP, TAPE_CMD_RECORD, TAPE_CMD_SLICE } tape_cmd_t;
+typedef struct {
+    tape_cmd_t cmd;
+    uint32_t cycles; // DWT cycle count at the gate edge, taken in the EXTI callback
+    uint32_t frame;  // frame of the audio block the gate acts on, set by the audio task
+} tape_cmd_msg_t;
+
+// Each index is written by one side only and runs freely, the slot is index & (CMD_RING_LEN - 1). A plain aligned store
+// publishes it, so neither side needs a critical section or exclusive access. The producer must not be preempted by
+// another producer: all gates share one EXTI line.
+typedef struct {
+    tape_cmd_msg_t slots[CMD_RING_LEN];
+    volatile uint32_t head; // commands pushed, written by the producer
+    volatile uint32_t tail; // commands popped, written by the consumer
+
+    // overflow counters, written by the producer
+    volatile uint32_t dropped;  // commands lost to a full ring
+    volatile uint32_t max_fill; // most commands waiting at once
+} cmd_ring_t;
+
+// Producer: append msg, or count it as dropped if the consumer is a whole ring behind.
+static inline bool cmd_ring_push(cmd_ring_t* r, const tape_cmd_msg_t* msg) {
+    uint32_t head = r->head;
+    uint32_t fill = head - r->tail;
+    if (fill >= CMD_RING_LEN) {
+        r->dropped++;
+        return false;
+    }
+
+    r->slots[head & (CMD_RING_LEN - 1)] = *msg;
+    __DMB(); // slot before the index
+    r->head = head + 1;
+
+    if (fill + 1 > r->max_fill)
+        r->max_fill = fill + 1;
+    return true;
+}
+
+// Consumer: copy the oldest command to msg without taking it off the ring.
+static inline bool cmd_ring_peek(const cmd_ring_t* r, tape_cmd_msg_t* msg) {
+    uint32_t tail = r->tail;
+    if (tail == r->head)
+        return false;
+
+    __DMB(); // index before the slot
+    *msg = r->slots[tail & (CMD_RING_LEN - 1)];
+    return true;
+}
+
+// Consumer: free the slot of the command cmd_ring_peek() returned.
+static inline void cmd_ring_pop(cmd_ring_t* r) {
+    __DMB(); // slot read before it is handed back
+    r->tail = r->tail + 1;
+}
@@ -4,6 +4,7 @@
  */
 #pragma once
 #include "FreeRTOS.h"
+#include "cmd_ring.h"
 #include "gpio.h"
 #include "queue.h"
 #include "stdbool.h"
@@ -16,7 +17,7 @@ struct gpio_config {
     TaskHandle_t userIfTaskHandle;
     TaskHandle_t controlIfTaskHandle;
 
-    QueueHandle_t tape_cmd_q;
+    cmd_ring_t* tape_cmd_ring;
     QueueHandle_t ui_cmd_q;
 
     TIM_HandleTypeDef* htim_button1_debounce;
@@ -30,7 +31,7 @@ int init_gpio_interface(TaskHandle_t controlIfTaskHandle,
                         TaskHandle_t userIfTaskHandle,
                         TIM_HandleTypeDef* htim_button1_debounce,
                         TIM_HandleTypeDef* htim_button2_debounce,
-                        QueueHandle_t tape_cmd_q);
+                        cmd_ring_t* tape_cmd_ring);
 bool wait_for_both_buttons_pushed();
 bool wait_for_both_buttons_released();
 bool are_both_buttons_pushed();
@@ -0,0 +1,37 @@
+/**
+ * @file decimator.h
+ * @brief Block-based power-of-2 decimator for the tape record path: cascade of half-band FIR stages.
+ */
+#pragma once
+
+#include <stdint.h>
+
+#include "project_config.h"
+#include "ressources.h"
+
+#define DECIMATOR_MAX_STAGES MAX_DECIMATION_POW // one half-band stage per factor of 2
+#define DECIMATOR_MAX_BLOCK 32                  // input frames per filter pass
+
+typedef enum {
+    DECIMATOR_FILTERED = 0, /**< Half-band anti-aliasing cascade. */
+    DECIMATOR_ALIASED       /**< Keep every Nth frame without filtering, folds everything above the new Nyquist back ("grit"). */
+} decimator_mode_t;
+
+/** @brief Stereo decimator state. Stage s of a channel runs at the input rate divided by 2^s. */
+typedef struct {
+    arm_fir_decimate_instance_q15 stages[2][DECIMATOR_MAX_STAGES]; // [channel][stage]
+    q15_t state[2][DECIMATOR_MAX_STAGES][HALFBAND_NUM_TAPS + DECIMATOR_MAX_BLOCK - 1];
+    uint8_t num_stages; /**< log2 of the decimation factor. */
+    decimator_mode_t mode;
+    uint32_t skip; /**< Aliased mode: input frames to drop before the next kept frame, carried across blocks. */
+} decimator_t;
+
+/** @brief Reset state and set up log2(@p factor) stages. @p factor must be a power of 2 up to 2^DECIMATOR_MAX_STAGES. */
+void decimator_init(decimator_t* dec, uint8_t factor, decimator_mode_t mode);
+
+/**
+ * @brief Decimate @p num_frames interleaved stereo frames from @p in into interleaved @p out.
+ * In filtered mode @p num_frames must be a multiple of the factor, blocks longer than DECIMATOR_MAX_BLOCK are filtered in passes.
+ * @return Number of frames written to @p out.
+ */
+uint32_t decimator_process(decimator_t* dec, const int16_t* in, uint32_t num_frames, int16_t* out);
@@ -11,6 +11,7 @@
 #include <stdint.h>
 
 #define ALPHA 0.4f
+#define EXCITE_CHUNK_FRAMES 32 // frames per pass of excite_block() over its work buffer
 
 typedef struct excite_config {
     arm_biquad_cascade_stereo_df2T_instance_f32 iir_in_instance;
@@ -23,4 +24,5 @@ typedef struct excite_config {
 } excite_config_t;
 
 void excite_init(excite_config_t* config);
-void excite_block(excite_config_t* config, const int16_t* in_buf, int16_t* out_buf, uint32_t block_size, float freq);
\ No newline at end of file
+// num_frames interleaved stereo frames from in_buf to out_buf, any length
+void excite_block(excite_config_t* config, const int16_t* in_buf, int16_t* out_buf, uint32_t num_frames, float freq);
\ No newline at end of file
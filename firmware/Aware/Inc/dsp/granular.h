@@ -0,0 +1,75 @@
+/**
+ * @file granular.h
+ * @brief Granular playback: Hann-windowed grains over the playback take, started at its slice markers plus jitter.
+ */
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "dsp/tape_codec.h"
+#include "project_config.h"
+#include "ressources.h"
+#include "util.h"
+
+#if CONFIG_GRANULAR_MAX_GRAINS > 32
+#error "the grain pool tracks its slots in one 32-bit mask"
+#endif
+
+#define GRANULAR_WINDOW_END ((uint32_t) GRAIN_WINDOW_LEN << 16) // window phase at which a grain ends
+#define GRANULAR_RELEASE_FRAMES 128                             // grains of a swapped-out take finish within this many frames
+#define GRANULAR_JITTER_FRAMES 1200                             // max random offset of a grain from its slice marker, in take frames
+
+struct tape_buffer;
+
+/**
+ * @brief Grain pool and scheduler. Grains are stored as struct of arrays indexed by slot, so that the render loop
+ * streams through one array per field. Only the audio task touches the pool: a slot is free while its bit in
+ * active is clear, so grains are claimed and freed without locks.
+ */
+typedef struct {
+    uint64_t pos_q48_16[CONFIG_GRANULAR_MAX_GRAINS];   // playhead in the take
+    uint32_t win_acc_q16[CONFIG_GRANULAR_MAX_GRAINS];  // window phase, grain_window_lut index in the upper 16 bits
+    uint32_t win_step_q16[CONFIG_GRANULAR_MAX_GRAINS]; // window phase increment per frame, sets the grain length
+    uint8_t delay[CONFIG_GRANULAR_MAX_GRAINS];         // frames into the next block before the grain starts
+    uint32_t active;                                   // bit i set: slot i holds a grain
+
+    tape_reader_t reader;   // take all grains read, shared so that the ADPCM decode cache is shared as well
+    uint32_t valid_samples; // length of that take
+    uint8_t decimation;     // decimation of that take, divides the phase increment
+    bool releasing;         // the take was swapped away, no new grains until the running ones are done
+
+    uint32_t frames_to_next; // scheduler countdown to the next grain onset
+    uint32_t rng;            // xorshift32 state for the position jitter
+    int32_t gain_q15;        // output gain, compensates the expected grain overlap
+
+    cycle_stats_t render_cycles; // grain render cost per audio block
+} granular_t;
+
+// Grain cloud parameters
+typedef struct {
+    float density;   // grain onsets per second, 0 stops scheduling
+    float size_ms;   // grain length in output time
+    float slice_pos; // normalized slice selection, same as for the tape voices
+} granular_params_t;
+
+void granular_init(granular_t* g);
+
+/**
+ * @brief Start the grains with onsets in the next @p num_frames frames. Attaches @p take first if the pool reads no take.
+ * @param gate No new grains while false, running grains play out.
+ * @param pitch_inc_q16 Q16.16 playback speed, the grains divide it by the decimation of their take.
+ */
+void granular_schedule(granular_t* g, const struct tape_buffer* take, const granular_params_t* params, uint32_t pitch_inc_q16,
+                       uint32_t num_frames, bool gate);
+
+/** @brief The playback take was swapped: running grains finish within GRANULAR_RELEASE_FRAMES, then the pool lets go of the take. */
+void granular_release(granular_t* g);
+
+/** @brief Drop all grains and the take at once. */
+void granular_stop(granular_t* g);
+
+// True while grains read the take laid out at mem.
+static inline bool granular_reads(const granular_t* g, const void* mem) {
+    return g->active && tape_store_base(&g->reader.store) == mem;
+}
@@ -0,0 +1,42 @@
+/**
+ * @file hermite_q14.h
+ * @brief Fixed-point Catmull-Rom interpolation with packed dual-16 MACs (CONFIG_TAPE_PLAYER_HERMITE_Q15).
+ *
+ * Not bit-exact with the float spline: the weights are Q14, see dev-tools/hermite_q14_test.c for the error bound.
+ */
+#pragma once
+
+#include <arm_math.h>
+#include <stdint.h>
+
+// Catmull-Rom weights for the four taps buf[idx-1..idx+2] in Q14, packed in pairs for __SMLAD.
+// Unlike the float hermite_interpolate() of tape_player_dsp.c the polynomial is expanded into per-tap weights, which only depend on the
+// fractional phase and are therefore computed once per frame and shared by both channels:
+//   w[-1] = (-t^3 + 2t^2 - t) / 2        w[0] = (3t^3 - 5t^2 + 2) / 2
+//   w[1]  = (-3t^3 + 4t^2 + t) / 2       w[2] = (t^3 - t^2) / 2
+// The basis is symmetric (w[2](1-t) == w[-1](t)), so reverse playback with t' = 1 - t over the mirrored
+// taps yields the same weights and needs no separate path.
+// The zero-order hold blend (grit) is folded into the weights as well: w' = (1 - g) * w, w[0] += g.
+static inline void hermite_weights_q14(uint32_t frac_q16, int32_t hold_q14, uint32_t* w_lo, uint32_t* w_hi) {
+    int32_t t = (int32_t) frac_q16;                             // Q16
+    int32_t t2 = (int32_t) (((uint32_t) t * t + 0x8000) >> 16); // Q16, rounded
+    int32_t t3 = (int32_t) (((uint32_t) t2 * t + 0x8000) >> 16);
+
+    // 2 * w in Q16 times the Q14 hold share, rounded to Q14 in one step (a shift by 17).
+    // w[1] is never negative and its product reaches 2^31, so it is scaled unsigned.
+    int32_t scale = 16384 - hold_q14;
+    int32_t wm1 = ((-t3 + 2 * t2 - t) * scale + (1 << 16)) >> 17;
+    int32_t w1 = (int32_t) (((uint32_t) (-3 * t3 + 4 * t2 + t) * (uint32_t) scale + (1u << 16)) >> 17);
+    int32_t w2 = ((t3 - t2) * scale + (1 << 16)) >> 17;
+    int32_t w0 = 16384 - wm1 - w1 - w2; // weights always sum to unity, hold share included
+
+    *w_lo = __PKHBT(wm1, w0, 16); // pairs with buf[idx-1] | buf[idx] << 16
+    *w_hi = __PKHBT(w1, w2, 16);  // pairs with buf[idx+1] | buf[idx+2] << 16
+}
+
+// Dual-MAC dot product of the packed taps (buf[idx-1] | buf[idx] << 16, buf[idx+1] | buf[idx+2] << 16) with the packed Q14 weights.
+static inline int16_t hermite_dot_q14(uint32_t taps_lo, uint32_t taps_hi, uint32_t w_lo, uint32_t w_hi) {
+    int32_t acc = (int32_t) __SMUAD(taps_lo, w_lo);
+    acc = (int32_t) __SMLAD(taps_hi, w_hi, (uint32_t) acc);
+    return (int16_t) __SSAT((acc + (1 << 13)) >> 14, 16);
+}
@@ -0,0 +1,30 @@
+/**
+ * @file onset_detector.h
+ * @brief Window energy onset detector for automatic slicing of the take being recorded.
+ */
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "project_config.h"
+#include "util.h"
+
+/** @brief Detector state, runs on the recorded input in windows of ONSET_WINDOW_FRAMES that span audio blocks. */
+typedef struct {
+    float slow_energy;           // slow average of the window energy, the reference an onset has to rise above
+    uint64_t window_acc;         // sum of squares of the current window so far
+    uint32_t window_pos;         // frames of the current window so far
+    uint32_t refractory;         // windows left in which no onset is reported
+    cycle_stats_t detect_cycles; // detector cost per audio block
+} onset_detector_t;
+
+/** @brief Reset the detector for a new take. */
+void onset_detector_init(onset_detector_t* det);
+
+/**
+ * @brief Analyse one block of @p num_frames interleaved stereo frames.
+ * @return true if a window with an onset ended in this block, @p late_frames is then the number of frames from the start
+ * of that window to the end of the block.
+ */
+bool onset_detector_process(onset_detector_t* det, const int16_t* in, uint32_t num_frames, uint32_t* late_frames);
@@ -2,10 +2,12 @@
 
 #include <stdint.h>
 
+#include "dsp/smoother.h"
 #include "ressources.h"
 
 #define SR_COMBS 4
 #define SR_ALLPASSES 2
+#define SR_CHUNK_FRAMES 32 /**< Frames per pass of the wet and size ramps in schroeder_rev_process_block(). */
 
 /** @brief Delay line used for both comb and allpass filters. */
 typedef struct {
@@ -34,7 +36,10 @@ typedef struct {
     sr_channel_t right;
     float wet;
     float dry;
-    float size; /**< Room size scalar [MIN_ROOM_SIZE, 1.0]. */
+    float size; /**< Room size scalar [MIN_ROOM_SIZE, 1.0], the target of the size ramp. */
+
+    smoother_t wet_smooth;  /**< Ramps wet and dry per frame. */
+    smoother_t size_smooth; /**< Glides the delay lengths per frame. */
 
     float32_t* iir_lp_coeffs;
 } schroeder_stereo_t;
@@ -45,13 +50,17 @@ void schroeder_rev_init(schroeder_stereo_t* rev);
 /** @brief Process one stereo sample pair. */
 void schroeder_rev_process(schroeder_stereo_t* rev, float inL, float inR, float* outL, float* outR);
 
-/** @brief Set wet/dry mix. @p wet in [0, 1]; dry = 1 - wet. */
+/** @brief Process @p num_frames interleaved stereo frames from @p in to @p out, which may be the same buffer. Advances the
+ * wet and size ramps per frame. */
+void schroeder_rev_process_block(schroeder_stereo_t* rev, const int16_t* in, int16_t* out, uint32_t num_frames);
+
+/** @brief Set wet/dry mix. @p wet in [0, 1]; dry = 1 - wet. Ramped by schroeder_rev_process_block(). */
 void schroeder_rev_set_wet(schroeder_stereo_t* rev, float wet);
 
 /** @brief Set comb/allpass feedback (clamped to [0, 0.999]). Controls RT60. */
 void schroeder_rev_set_feedback(schroeder_stereo_t* rev, float feedback);
 
-/** @brief Set room size scalar [MIN_ROOM_SIZE, 1.0]. Scales all delay lengths. */
+/** @brief Set room size scalar [MIN_ROOM_SIZE, 1.0]. Scales all delay lengths, ramped by schroeder_rev_process_block(). */
 void schroeder_rev_set_size(schroeder_stereo_t* rev, float size);
 
 /** @brief Set one-pole LP alpha for all comb feedback paths. @p alpha in [0, 1]. */
@@ -0,0 +1,50 @@
+/**
+ * @file sinc_interp.h
+ * @brief Polyphase windowed-sinc interpolator for the tape playheads: coefficient table and per-frame weights.
+ */
+#pragma once
+
+#include <stdint.h>
+
+#include "project_config.h"
+
+#ifdef CONFIG_TAPE_SINC_TAPS
+#if CONFIG_TAPE_SINC_TAPS != 8 && CONFIG_TAPE_SINC_TAPS != 16
+#error "CONFIG_TAPE_SINC_TAPS must be 8 or 16"
+#endif
+#ifndef CONFIG_TAPE_PLAYER_HERMITE_Q15
+#error "the sinc interpolator is fixed point, CONFIG_TAPE_SINC_TAPS needs CONFIG_TAPE_PLAYER_HERMITE_Q15"
+#endif
+
+#define SINC_PHASE_BITS 8
+#define SINC_PHASES (1u << SINC_PHASE_BITS) // table rows per frame, the weights in between are interpolated
+
+// Kaiser windowed sinc: cutoff relative to Nyquist and window beta, picked with dev-tools/interp_thdn.py.
+// The cutoff stays below Nyquist so that no weight reaches 1.0 and the table fits Q15.
+#if CONFIG_TAPE_SINC_TAPS == 8
+#define SINC_CUTOFF 0.8f
+#define SINC_BETA 7.0f
+#else
+#define SINC_CUTOFF 0.9f
+#define SINC_BETA 10.0f
+#endif
+
+// Row p holds the Q15 weights of the taps idx - CONFIG_TAPE_SINC_TAPS / 2 + 1 .. idx + CONFIG_TAPE_SINC_TAPS / 2 for a
+// playhead p / SINC_PHASES past frame idx. Each row sums to unity. Row SINC_PHASES is row 0 moved by one tap, so that
+// every phase lies between two rows.
+extern int16_t sinc_table_q15[(SINC_PHASES + 1) * CONFIG_TAPE_SINC_TAPS];
+
+/** @brief Compute sinc_table_q15. Call once before playback. */
+void sinc_interp_init(void);
+
+// Weights for a playhead frac_q16 past its frame, linearly interpolated between the two nearest rows.
+// They only depend on the phase and are shared by both channels.
+static inline void sinc_weights_q15(uint32_t frac_q16, int16_t* w) {
+    const int16_t* a = &sinc_table_q15[(frac_q16 >> (16 - SINC_PHASE_BITS)) * CONFIG_TAPE_SINC_TAPS];
+    const int16_t* b = a + CONFIG_TAPE_SINC_TAPS;
+    int32_t mu = (int32_t) (frac_q16 & ((1u << (16 - SINC_PHASE_BITS)) - 1)); // position between the rows, Q8
+
+    for (uint32_t i = 0; i < CONFIG_TAPE_SINC_TAPS; i++)
+        w[i] = (int16_t) (a[i] + (((b[i] - a[i]) * mu) >> (16 - SINC_PHASE_BITS)));
+}
+#endif
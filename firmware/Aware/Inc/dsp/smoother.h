@@ -0,0 +1,70 @@
+/**
+ * @file smoother.h
+ * @brief Parameter ramps against zipper noise: linear or one-pole glide from the current value to a target.
+ */
+#pragma once
+
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+typedef enum {
+    SMOOTHER_LINEAR = 0, /**< Straight ramp of a fixed length, restarted from the current value by each new target. */
+    SMOOTHER_ONE_POLE    /**< Exponential approach, snaps to the target within epsilon. */
+} smoother_mode_t;
+
+/** @brief Smoother state. A tick is one frame, or one update of a consumer that changes the value less often. */
+typedef struct {
+    float value;  /**< Current output, equals target once settled. */
+    float target;
+    float step;   /**< Linear: change per tick. */
+    float coeff;  /**< One-pole: 1 - exp(-1 / time constant in ticks). */
+    float epsilon;
+    uint32_t ramp_ticks; /**< Linear: ticks from one value to the next target. */
+    uint32_t remaining;  /**< Linear: ticks left in the ramp. */
+    smoother_mode_t mode;
+    bool ramping;
+} smoother_t;
+
+/**
+ * @brief Start settled at @p value. @p time_ms is the ramp length (linear) or time constant (one-pole) at @p tick_hz
+ * ticks per second. A one-pole ramp ends when it is within @p epsilon of the target.
+ */
+void smoother_init(smoother_t* s, smoother_mode_t mode, float value, float time_ms, float tick_hz, float epsilon);
+
+/** @brief Glide to @p target from the current value. The same target again changes nothing. */
+void smoother_set_target(smoother_t* s, float target);
+
+/** @brief Jump to @p value without a ramp. */
+void smoother_reset(smoother_t* s, float value);
+
+/**
+ * @brief Write the next @p num_ticks values to @p out. Returns false without writing anything if the smoother is settled,
+ * the caller then uses s->value for the whole block.
+ */
+bool smoother_process_block(smoother_t* s, float* out, uint32_t num_ticks);
+
+static inline bool smoother_settled(const smoother_t* s) {
+    return !s->ramping;
+}
+
+/** @brief Advance one tick and return the new value. */
+static inline float smoother_next(smoother_t* s) {
+    if (!s->ramping)
+        return s->value;
+
+    if (s->mode == SMOOTHER_LINEAR) {
+        s->value += s->step;
+        if (--s->remaining == 0) {
+            s->value = s->target;
+            s->ramping = false;
+        }
+    } else {
+        s->value += s->coeff * (s->target - s->value);
+        if (fabsf(s->target - s->value) <= s->epsilon) {
+            s->value = s->target;
+            s->ramping = false;
+        }
+    }
+    return s->value;
+}
@@ -0,0 +1,32 @@
+/**
+ * @file stretch_match.h
+ * @brief Similarity score of the WSOLA search (CONFIG_TAPE_TIME_STRETCH): how well a candidate grain start continues the take.
+ *
+ * See dev-tools/stretch_match_test.c for a check that the search follows a time-shifted copy of the reference.
+ */
+#pragma once
+
+#include <math.h>
+#include <stdint.h>
+
+// Sums over the compared frames of one candidate.
+typedef struct {
+    int64_t cross;  // reference times candidate
+    int64_t energy; // candidate squared
+} stretch_match_t;
+
+static inline void stretch_match_add(stretch_match_t* m, int32_t ref, int32_t cand) {
+    m->cross += (int64_t) ref * cand;
+    m->energy += (int64_t) cand * cand;
+}
+
+// Normalized cross-correlation of the candidate with the reference, squared with its sign kept: cross * |cross| / energy.
+// The reference energy is the same for all candidates of a search and left out. It ranks the candidates like
+// cross / sqrt(energy), without the square root, so a louder stretch of the take does not win over a better matching one.
+// A silent candidate scores 0.
+static inline float stretch_match_score(const stretch_match_t* m) {
+    if (m->energy <= 0)
+        return 0.0f;
+    float cross = (float) m->cross;
+    return cross * fabsf(cross) / (float) m->energy;
+}
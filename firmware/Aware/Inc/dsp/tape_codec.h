@@ -0,0 +1,215 @@
+/**
+ * @file tape_codec.h
+ * @brief Tape sample encodings: storage of a take, block encoder for recording and random-access decoder for playback.
+ */
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "project_config.h"
+
+#if (CONFIG_TAPE_ENCODING != TAPE_ENC_PCM16) && !defined(CONFIG_TAPE_BUFFER_INTERLEAVED)
+#error "compressed tape encodings store LR-packed frames and need CONFIG_TAPE_BUFFER_INTERLEAVED"
+#endif
+#if defined(CONFIG_TAPE_PREROLL) && !defined(CONFIG_TAPE_BUFFER_INTERLEAVED)
+#error "wrapped takes are read through tape_reader_taps(), CONFIG_TAPE_PREROLL needs CONFIG_TAPE_BUFFER_INTERLEAVED"
+#endif
+
+// Distance in int16 between two consecutive samples of one channel of a PCM16 take.
+// Interleaved: both channels share one LR-packed array (one uint32_t per frame, L in the low halfword),
+// ch[0]/ch[1] point at the first L/R sample. Planar: one array per channel.
+#ifdef CONFIG_TAPE_BUFFER_INTERLEAVED
+#define TAPE_CH_STRIDE 2
+#else
+#define TAPE_CH_STRIDE 1
+#endif
+
+#define TAPE_ADPCM_BLOCK_SHIFT 7
+#define TAPE_ADPCM_BLOCK_LEN (1u << TAPE_ADPCM_BLOCK_SHIFT) // frames per ADPCM block
+#define TAPE_ADPCM_NUM_BLOCKS(frames) (((frames) + TAPE_ADPCM_BLOCK_LEN - 1) >> TAPE_ADPCM_BLOCK_SHIFT)
+
+/** @brief ADPCM encoder state before the first frame of a block, so that every block decodes on its own. */
+typedef struct {
+    int16_t predictor[2];
+    uint8_t step_idx[2];
+} tape_adpcm_header_t;
+
+/** @brief Storage of one take. */
+typedef struct {
+#if CONFIG_TAPE_ENCODING == TAPE_ENC_PCM16
+    int16_t* ch[2]; /**< ch[0]=L, ch[1]=R, samples are TAPE_CH_STRIDE apart. */
+#elif CONFIG_TAPE_ENCODING == TAPE_ENC_ADPCM
+    uint8_t* frames;              /**< One byte per frame, L in the low nibble. Sized in whole blocks. */
+    tape_adpcm_header_t* headers; /**< One per TAPE_ADPCM_BLOCK_LEN frames, in front of the frames. */
+#else
+    uint16_t* frames; /**< One 8-bit code per channel, L in the low byte. */
+#endif
+#ifdef CONFIG_TAPE_PREROLL
+    uint32_t ring;  /**< Frames laid out. Frame indices of the take wrap around at this length. */
+    uint32_t start; /**< Stored frame that holds frame 0 of the take, moved by a retroactive record instead of the audio. */
+#endif
+} tape_store_t;
+
+// Stored frame holding frame idx of the take. A take recorded with pre-roll starts anywhere in its store and wraps around its end.
+static inline uint32_t tape_store_phys(const tape_store_t* store, uint32_t idx) {
+#ifdef CONFIG_TAPE_PREROLL
+    idx += store->start;
+    if (idx >= store->ring)
+        idx -= store->ring;
+#else
+    (void) store;
+#endif
+    return idx;
+}
+
+#if CONFIG_TAPE_ENCODING == TAPE_ENC_ADPCM
+/** @brief One decoded ADPCM block as LR-packed PCM16 frames. */
+typedef struct {
+    uint32_t block; /**< Block index held in frames, UINT32_MAX if empty. */
+    uint32_t frames[TAPE_ADPCM_BLOCK_LEN];
+} tape_adpcm_slot_t;
+#endif
+
+/** @brief Reading end of a take: a copy of its storage pointers plus the decode cache of one playhead. */
+typedef struct {
+    tape_store_t store;
+#if CONFIG_TAPE_ENCODING == TAPE_ENC_ADPCM
+    tape_adpcm_slot_t cache[2]; /**< Indexed by block parity, so taps straddling a block boundary do not thrash. */
+#endif
+} tape_reader_t;
+
+/** @brief Writing end of a take. Only ADPCM carries state from frame to frame. */
+typedef struct {
+#if CONFIG_TAPE_ENCODING == TAPE_ENC_ADPCM
+    int16_t predictor[2];
+    uint8_t step_idx[2];
+#else
+    uint8_t unused;
+#endif
+} tape_encoder_t;
+
+// Taps of the playback interpolator: the frames idx - TAPE_INTERP_HALF + 1 .. idx + TAPE_INTERP_HALF around a playhead at frame idx.
+#ifdef CONFIG_TAPE_SINC_TAPS
+#define TAPE_INTERP_TAPS CONFIG_TAPE_SINC_TAPS
+#else
+#define TAPE_INTERP_TAPS 4 // Hermite
+#endif
+#define TAPE_INTERP_HALF (TAPE_INTERP_TAPS / 2)
+
+// Frames a take keeps beyond its last valid frame, so the taps behind the playhead never leave its memory.
+#define TAPE_STORE_GUARD_FRAMES (TAPE_INTERP_HALF + 1)
+
+/** @brief Number of frames of the selected encoding that fit into @p bytes of tape memory. */
+uint32_t tape_store_frames_for_bytes(uint32_t bytes);
+
+/** @brief Lay out a take of @p frames frames at @p mem (NULL clears the store). */
+void tape_store_assign(tape_store_t* store, void* mem, uint32_t frames);
+
+/** @brief Bytes at the start of a take laid out for @p frames that hold its first @p valid frames plus the guard frames. */
+uint32_t tape_store_bytes_needed(uint32_t frames, uint32_t valid);
+
+/** @brief Build the decode table of the 8-bit encodings. Call once before recording or playback. */
+void tape_codec_init(void);
+
+/** @brief Reset the encoder for a new take, recording starts at frame 0. */
+void tape_encoder_reset(tape_encoder_t* enc);
+
+/** @brief Encode @p n interleaved stereo frames into @p store starting at frame @p head of the take. */
+void tape_codec_write(const tape_store_t* store, tape_encoder_t* enc, uint32_t head, const int16_t* frames, uint32_t n);
+
+/** @brief Point @p rd at @p store (NULL detaches) and drop its decode cache. */
+void tape_reader_attach(tape_reader_t* rd, const tape_store_t* store);
+
+// Start of the memory the take was laid out in by tape_store_assign().
+static inline const void* tape_store_base(const tape_store_t* store) {
+#if CONFIG_TAPE_ENCODING == TAPE_ENC_PCM16
+    return store->ch[0];
+#elif CONFIG_TAPE_ENCODING == TAPE_ENC_ADPCM
+    return store->headers;
+#else
+    return store->frames;
+#endif
+}
+
+static inline bool tape_store_is_valid(const tape_store_t* store) {
+#if CONFIG_TAPE_ENCODING == TAPE_ENC_PCM16
+    return store->ch[0] && store->ch[1];
+#else
+    return store->frames != NULL;
+#endif
+}
+
+#ifdef CONFIG_TAPE_BUFFER_INTERLEAVED
+#if CONFIG_TAPE_ENCODING == TAPE_ENC_ADPCM
+/** @brief Decode block @p block of @p store into @p slot. */
+void tape_adpcm_decode_block(const tape_store_t* store, uint32_t block, tape_adpcm_slot_t* slot);
+
+// Decoded frames of block, from the cache or freshly decoded into the slot of its parity.
+static inline const uint32_t* tape_reader_block(tape_reader_t* rd, uint32_t block) {
+    tape_adpcm_slot_t* slot = &rd->cache[block & 1];
+    if (slot->block != block)
+        tape_adpcm_decode_block(&rd->store, block, slot);
+    return slot->frames;
+}
+#elif CONFIG_TAPE_ENCODING != TAPE_ENC_PCM16
+extern int16_t tape_decode_lut[256];
+
+static inline uint32_t tape_decode_frame8(uint16_t code) {
+    return (uint16_t) tape_decode_lut[code & 0xFF] | ((uint32_t) (uint16_t) tape_decode_lut[code >> 8] << 16);
+}
+#endif
+
+// Stored frame n as LR-packed PCM16, n being an index into the store rather than the take.
+static inline uint32_t tape_reader_stored_frame(tape_reader_t* rd, uint32_t n) {
+#if CONFIG_TAPE_ENCODING == TAPE_ENC_PCM16
+    return ((const uint32_t*) rd->store.ch[0])[n];
+#elif CONFIG_TAPE_ENCODING == TAPE_ENC_ADPCM
+    return tape_reader_block(rd, n >> TAPE_ADPCM_BLOCK_SHIFT)[n & (TAPE_ADPCM_BLOCK_LEN - 1)];
+#else
+    return tape_decode_frame8(rd->store.frames[n]);
+#endif
+}
+
+// The TAPE_INTERP_TAPS LR-packed PCM16 frames from first on, for the interpolator taps.
+// PCM16 points straight into the tape, the other encodings decode into scratch (or the ADPCM cache).
+static inline const uint32_t* tape_reader_taps(tape_reader_t* rd, uint32_t first, uint32_t* scratch) {
+    uint32_t n = tape_store_phys(&rd->store, first);
+#ifdef CONFIG_TAPE_PREROLL
+    if (n + TAPE_INTERP_TAPS > rd->store.ring) {
+        // taps straddle the end of a wrapped take
+        for (uint32_t i = 0; i < TAPE_INTERP_TAPS; i++)
+            scratch[i] = tape_reader_stored_frame(rd, tape_store_phys(&rd->store, first + i));
+        return scratch;
+    }
+#endif
+#if CONFIG_TAPE_ENCODING == TAPE_ENC_PCM16
+    (void) scratch;
+    return (const uint32_t*) rd->store.ch[0] + n;
+#elif CONFIG_TAPE_ENCODING == TAPE_ENC_ADPCM
+    uint32_t offset = n & (TAPE_ADPCM_BLOCK_LEN - 1);
+    if (offset + TAPE_INTERP_TAPS <= TAPE_ADPCM_BLOCK_LEN)
+        return tape_reader_block(rd, n >> TAPE_ADPCM_BLOCK_SHIFT) + offset;
+
+    // taps straddle a block boundary
+    for (uint32_t i = 0; i < TAPE_INTERP_TAPS; i++)
+        scratch[i] = tape_reader_stored_frame(rd, n + i);
+    return scratch;
+#else
+    const uint16_t* codes = rd->store.frames + n;
+    for (uint32_t i = 0; i < TAPE_INTERP_TAPS; i++)
+        scratch[i] = tape_decode_frame8(codes[i]);
+    return scratch;
+#endif
+}
+#endif
+
+// Frame idx of a take as LR-packed PCM16, one frame at a time for analysis and the taps at the very start of a take.
+static inline uint32_t tape_reader_frame(tape_reader_t* rd, uint32_t idx) {
+#ifdef CONFIG_TAPE_BUFFER_INTERLEAVED
+    return tape_reader_stored_frame(rd, tape_store_phys(&rd->store, idx));
+#else
+    return (uint16_t) rd->store.ch[0][idx] | ((uint32_t) (uint16_t) rd->store.ch[1][idx] << 16);
+#endif
+}
@@ -8,6 +8,32 @@
 
 // Shared memory structure for parameters that are set from multiple sources (UI, CV) and need to be accessed in the audio processing code.
 
+// One generation counter per parameter, so the audio task recomputes only what changed. See param_cache_fetch().
+typedef enum {
+    PARAM_PITCH_CV = 0,
+    PARAM_PITCH_UI,
+    PARAM_ENV_ATTACK,
+    PARAM_ENV_DECAY,
+    PARAM_CYCLIC,
+    PARAM_REVERSE,
+    PARAM_DECIMATION,
+    PARAM_SLICE_POS,
+    PARAM_FX_XY,
+    PARAM_GRAIN_DENSITY,
+    PARAM_GRAIN_SIZE,
+    PARAM_OVERDUB,
+    PARAM_OVERDUB_FEEDBACK,
+    PARAM_VERB_SIZE,
+    PARAM_VERB_FEEDBACK,
+    PARAM_VERB_WET,
+    PARAM_VERB_LP_ALPHA,
+    PARAM_COUNT
+} param_id_t;
+
+#define PARAM_BIT(id) (1u << (id))
+#define PARAM_ALL (PARAM_BIT(PARAM_COUNT) - 1u)
+#define PARAM_GEN_WORDS ((PARAM_COUNT + 3) / 4)
+
 struct param_cache {
     float pitch_cv;
     float pitch_ui;
@@ -24,13 +50,33 @@ struct param_cache {
     float fx_x;
     float fx_y;
 
+    float grain_density; // grain onsets per second, 0 = off
+    float grain_size_ms;
+
+    bool overdub; // sound-on-sound into the playing take
+    float overdub_feedback;
+
     float schroeder_verb_size;
     float schroeder_verb_feedback;
     float schroeder_verb_wet;
     float schroeder_verb_lp_alpha;
+
+    union {
+        uint8_t gen[PARAM_GEN_WORDS * 4]; // bumped by every setter that changes the value
+        uint32_t gen_words[PARAM_GEN_WORDS];
+    };
 };
 
 /* public API */
+// Create the writer lock. Call before the tasks that set parameters start.
+void param_cache_init(void);
+
+// Writers: param_cache_begin() returns the parameters to change, param_cache_publish() hands all changes since to the audio
+// task at once. Pairs nest, so a batch of setters between an outer pair is published as one. Change values through the
+// setters only, they keep the generation counters.
+struct param_cache* param_cache_begin(void);
+void param_cache_publish(void);
+
 void param_cache_set_pitch_cv(float v);
 void param_cache_set_pitch_ui(float v);
 void param_cache_set_env_attack(float attack);
@@ -40,9 +86,15 @@ void param_cache_set_reverse(bool reverse);
 void param_cache_set_decimation(uint8_t decimation);
 void param_cache_set_slice_pos(float slice_pos);
 void param_cache_set_xy_fx(float x, float y);
+void param_cache_set_grain_density(float density);
+void param_cache_set_grain_size_ms(float size_ms);
+void param_cache_set_overdub(bool overdub);
+void param_cache_set_overdub_feedback(float feedback);
 void param_cache_set_schroeder_verb_size(float size);
 void param_cache_set_schroeder_verb_feedback(float feedback);
 void param_cache_set_schroeder_verb_wet(float wet);
 void param_cache_set_schroeder_verb_lp_alpha(float cutoff);
 
-void param_cache_fetch(struct param_cache* out);
+// Reader: update out to one consistent copy of the last published parameters and return the PARAM_BIT()s of the ones that
+// changed since out was fetched. Never blocks. A counter wraps after 256 changes, far more than one audio block sees.
+uint32_t param_cache_fetch(struct param_cache* out);
@@ -15,7 +15,30 @@
 #define CONFIG_USE_CALIB_STORAGE
 #define CONFIG_ENABLE_ENVELOPE
 #define CONFIG_TAPE_PLAYER_ENABLE_HERMITE
+#define CONFIG_TAPE_PLAYER_HERMITE_Q15 // fixed-point Catmull-Rom with packed dual-16 MACs instead of float Hermite. Needs CONFIG_TAPE_PLAYER_ENABLE_HERMITE
+// #define CONFIG_TAPE_SINC_TAPS 8 // polyphase windowed-sinc interpolator with 8 or 16 taps, selectable at runtime next to Hermite. Needs CONFIG_TAPE_PLAYER_HERMITE_Q15
 #define CONFIG_TAPE_PLAYER_ENABLE_FADE_IN_OUT
+// #define CONFIG_TAPE_REC_ALIASING // record decimation keeps every Nth frame without anti-alias filter, for the folded-back "grit" character
+// #define CONFIG_TAPE_BUFFER_INTERLEAVED // store tape as LR-packed frames (one 32-bit word per frame) instead of one array per channel
+#define CONFIG_TAPE_NUM_VOICES 1       // playheads over the playback take (up to 8), a new gate takes a free voice or steals the oldest one
+// #define CONFIG_ENABLE_GRANULAR         // grain cloud over the playback take on top of the voices, density and size from the XY CV
+#define CONFIG_GRANULAR_MAX_GRAINS 32  // grain pool size, at most 32
+// #define CONFIG_TAPE_ONSET_SLICING      // add a slice marker at every onset detected in the input while recording
+// #define CONFIG_TAPE_SLICE_SNAPPING     // move the slice markers of a finished take to zero crossings in the worker task
+// #define CONFIG_TAPE_OVERDUB            // sound-on-sound into the playing take, toggled by pressing both buttons together. Not with ADPCM takes
+// #define CONFIG_TAPE_MIPMAP             // octave-decimated copies of each take, built in the worker task, keep high pitches from aliasing
+// #define CONFIG_TAPE_PREROLL            // the idle record buffer keeps capturing the input, a record gate keeps the last TAPE_PREROLL_MS before it
+// #define CONFIG_TAPE_ANALYSIS           // levels per slice, waveform overview, DC offset and normalization gain of each take, from the worker task
+// #define CONFIG_TAPE_LOOP_SEARCH        // the worker task finds a loop end near the take end that goes on like the take start, cyclic mode wraps there
+// #define CONFIG_TAPE_TIME_STRETCH    // WSOLA playback: V/Oct sets the pitch, the pitch pot the speed, the take keeps its length. Not with overdub
+
+// Tape sample encoding. Compressed encodings trade quality for recording time in the same tape pool.
+#define TAPE_ENC_PCM16 0 // 16-bit linear
+#define TAPE_ENC_PCM8 1  // 8-bit linear, 2x length
+#define TAPE_ENC_MULAW 2 // 8-bit G.711 mu-law, 2x length
+#define TAPE_ENC_ALAW 3  // 8-bit G.711 A-law, 2x length
+#define TAPE_ENC_ADPCM 4 // 4-bit IMA-ADPCM with per-block headers, ~3.8x length. Needs CONFIG_TAPE_BUFFER_INTERLEAVED like all compressed encodings
+#define CONFIG_TAPE_ENCODING TAPE_ENC_PCM16
 #define CONFIG_ENABLE_REVERB
 #define CONFIG_ENABLE_PITCH_SLIDE_POT
 
@@ -26,8 +49,13 @@
 /* ===== Engine Parameters ===== */
 
 /* audio engine config */
-#define AUDIO_BLOCK_SIZE 128
-#define AUDIO_HALF_BLOCK_SIZE (AUDIO_BLOCK_SIZE / 2)
+// The DMA ring holds AUDIO_DMA_PERIODS periods, the audio task renders each period in DSP blocks. Each period beyond two
+// adds a period of output latency and as much slack to the deadline of the audio task. Period and block length come from
+// the profile, see audio_profile_id_t, these bound them for the buffers.
+#define AUDIO_DMA_PERIODS 2 // 2 or more
+#define AUDIO_MAX_PERIOD_FRAMES 128 // DMA ring, in the non-cacheable .dma_buffer section
+#define AUDIO_MAX_BLOCK_FRAMES 128  // scratch buffers of the DSP stages
+#define CONFIG_AUDIO_PROFILE AUDIO_PROFILE_BALANCED // profile the engine runs
 #define AUDIO_SAMPLE_RATE SAMPLERATE_48KHZ
 // #define AUDIO_SAMPLE_RATE SAMPLERATE_24KHZ
 // #define AUDIO_SAMPLE_RATE_HW SAMPLERATE_48KHZ
@@ -35,10 +63,23 @@
 #define AUDIO_BIT_DEPTH 16 // or 8 // TODO: maybe make tapebuffer use 8bit. Increase tape lenth and create nice texture?
 
 /* tape engine configs*/
-// Length of the rec/playback tape in milliseconds, if samplerate is full 48kHz.
-// this length is dynamic, dependent on the decimation factor
-#define TAPE_SECONDS_MS 2500
-// #define TAPE_SECONDS_MS 100
+// RAM pool (.sram1) shared by all takes, see tape_pool.h. A new take claims the largest free region when recording starts,
+// its length therefore depends on the encoding, the decimation factor and the memory the playing take leaves free.
+// At 48kHz PCM16 the whole pool holds ~5.3 s of stereo audio, the compressed encodings 2x (8-bit) and ~3.8x (ADPCM) that.
+#define TAPE_POOL_BYTES (1000 * 1024)
+// Upper bound of a single take in percent of the pool, so that a new take can always be recorded while the longest one plays.
+// A planar take gives back only the tail of its R array (its whole L array stays), so planar takes split the pool evenly.
+#ifdef CONFIG_TAPE_BUFFER_INTERLEAVED
+#define TAPE_MAX_TAKE_PERCENT 75
+#else
+#define TAPE_MAX_TAKE_PERCENT 50
+#endif
+// Mip levels of a take (CONFIG_TAPE_MIPMAP) live behind it in its region, as LR-packed PCM16 at 1/2, 1/4, ... of its rate.
+// A take gets as many levels as fit into the room it left unrecorded, up to TAPE_MIP_MAX_LEVELS (pitch 2^TAPE_MIP_MAX_LEVELS).
+// TAPE_MIP_RESERVE_PERCENT keeps that share of a region from recording, so that long takes get levels too:
+// all levels of a PCM16 take need 49% of its region, the first one 34%.
+#define TAPE_MIP_MAX_LEVELS 4
+#define TAPE_MIP_RESERVE_PERCENT 0
 #define NUM_CHANNELS 2 // stereo
 
 // CV Channel configuration
@@ -75,11 +116,6 @@
 #define MAGIC_NUMBER 0xDEADBEEF
 
 /* ===== Derived values (do not edit) ===== */
-// playback tape size calculations
-#define TAPE_SIZE (AUDIO_SAMPLE_RATE * (TAPE_SECONDS_MS) * NUM_CHANNELS / 1000) // number of samples
-#define TAPE_SIZE_ALIGNED ((TAPE_SIZE / AUDIO_BLOCK_SIZE) * AUDIO_BLOCK_SIZE)   // make sure tape size is multiple of audio block size
-#define TAPE_SIZE_CHANNEL (TAPE_SIZE_ALIGNED / NUM_CHANNELS)                    // number of samples per channel
-
 // we have to dimension the recording buffer to handle the playhead advancement at maximum pitch shift
 #define MAX_PITCH_SHIFT_SEMITONES 48.0f // maximum pitch shift in semitones (upwards)
 // compute number of blocks needed for max pitch shift + 10% safety margin
@@ -93,18 +129,51 @@
 #define TAPE_REC_BUF_NUM_BLOCKS ((PITCH_FACTOR_BLOCKS * 110 + 99) / 100) // ceil integer division
 
 // recording buffer size per channel, aligned to block size
-#define TAPE_REC_BUF_SIZE_CHANNEL (AUDIO_BLOCK_SIZE * TAPE_REC_BUF_NUM_BLOCKS)
+#define TAPE_REC_BUF_SIZE_CHANNEL (AUDIO_MAX_BLOCK_FRAMES * TAPE_REC_BUF_NUM_BLOCKS)
 
 #define FADE_XFADE_RETRIG_LEN 128
 #define FADE_XFADE_CYCLIC_LEN 4800
+#define FADE_XFADE_LOOP_LEN 256 // cyclic crossfade over a loop point of CONFIG_TAPE_LOOP_SEARCH
 #define FADE_IN_OUT_LEN 128 // fade in/out length when approaching start/end of buffer, to prevent clicks
+#define FADE_SNAPPED_LEN 32 // fade-in and retrigger crossfade length of notes that start on a snapped slice
+#define SLICE_SNAP_WINDOW_MS 3 // a slice marker moves at most this far to reach a zero crossing
+#define TAPE_PREROLL_MS 250    // input before the record gate a take starts with (CONFIG_TAPE_PREROLL), at most half of the take
+
+// loop point search (CONFIG_TAPE_LOOP_SEARCH). Matches are scored by their squared difference relative to their energy:
+// 0 is a perfect match, 1 uncorrelated audio.
+#define LOOP_SEARCH_MS 50    // the loop end is searched this far in front of the take end
+#define LOOP_MATCH_MS 5      // audio behind a candidate compared with the audio behind the take start
+#define LOOP_MATCH_MAX 0.25f // worse matches keep looping the whole take with the FADE_XFADE_CYCLIC_LEN crossfade
+#define LOOP_SEAMLESS 0.0005f // better ones loop without crossfade, the rest with FADE_XFADE_LOOP_LEN
+
+// take analysis (CONFIG_TAPE_ANALYSIS)
+#define TAPE_OVERVIEW_POINTS 64  // peaks of the waveform overview, one per equal stretch of the take
+#define TAPE_NORM_PEAK 29205     // normalization brings the peak without DC here (-1 dBFS)
+#define TAPE_NORM_MAX_GAIN 16.0f // quiet takes are not boosted beyond this (+24 dB), silent ones get 1
+
+// worker task (CONFIG_TAPE_SLICE_SNAPPING, CONFIG_TAPE_MIPMAP, CONFIG_TAPE_ANALYSIS, CONFIG_TAPE_LOOP_SEARCH)
+#define TAPE_WORKER_CHUNK_FRAMES 4096 // take frames the worker goes through per step, it checks for a retired take in between
+
+// WSOLA time stretch (CONFIG_TAPE_TIME_STRETCH)
+#define STRETCH_HOP 512           // output frames between two grain starts, grains are two hops long (Hann, 50% overlap)
+#define STRETCH_SEARCH_RADIUS 128 // take frames around the nominal position searched for the best continuation
+#define STRETCH_SEARCH_STEP 4     // take frames between two search candidates
+#define STRETCH_CORR_LEN 32       // mono frames (2 take frames apart) compared per candidate
 
 #define FADE_IN_OUT_STEP_Q16 (uint32_t) (((float) FADE_LUT_LEN * 65536.0f) / (float) FADE_IN_OUT_LEN)
 #define FADE_XFADE_RETRIG_STEP_Q16 (uint32_t) (((float) FADE_LUT_LEN * 65536.0f) / (float) FADE_XFADE_RETRIG_LEN)
+#define FADE_SNAPPED_STEP_Q16 (uint32_t) (((float) FADE_LUT_LEN * 65536.0f) / (float) FADE_SNAPPED_LEN)
 
 // TODO: Make cyclic crossfade parameter dynamically controlled by control/user interface
 #define FADE_XFADE_CYCLIC_STEP_Q16 (uint32_t) (((float) FADE_LUT_LEN * 65536.0f) / (float) FADE_XFADE_CYCLIC_LEN)
 
+// onset detector for CONFIG_TAPE_ONSET_SLICING, evaluated on the window energy (mean square of L and R, int16 units)
+#define ONSET_WINDOW_FRAMES 32      // analysis window, independent of the audio block length
+#define ONSET_ENERGY_FLOOR 17000.0f // ~ -48 dBFS RMS, quieter windows never count as onset
+#define ONSET_RISE_RATIO 4.0f       // window energy has to exceed the slow average by 6 dB
+#define ONSET_SLOW_ALPHA 0.05f      // slow average weight per window, ~13 ms time constant
+#define ONSET_REFRACTORY_MS 80      // no further onset within this time after one
+
 #define CV_CALIB_HOLD_MS 1000
 #define POT_CALIB_HOLD_MS 5000
 
@@ -113,4 +182,9 @@
 #define MAX_EXCITE_ON_MAX_DECIMATION 0.0f
 // #define MAX_EXCITE_ON_MAX_DECIMATION 4.0f
 
+// parameter ramps against zipper noise, see dsp/smoother.h
+#define EXCITE_GAIN_RAMP_MS 20.0f // exciter amount, steps with the grit of each new take
+#define TAPE_PITCH_GLIDE_MS 2.0f  // one-pole time constant of the playback pitch
+#define TAPE_PITCH_RAMP_FRAMES 8  // while the pitch glides, the playback increment is updated every this many frames
+
 #define MAX_DECIMATION_POW 4
\ No newline at end of file
@@ -16,3 +16,12 @@ extern float32_t iir_coeffs[BIQUAD_CASCADE_NUM_STAGES * 5];
 
 #define lp_fc2k_but_NUM_STAGES 1
 extern float32_t lp_fc2k_but_coeffs[lp_fc2k_but_NUM_STAGES * 5];
+
+// Half-band lowpass for the record decimator (Q15, Kaiser windowed sinc, beta 7).
+// Passband up to 0.17 fs, > 69 dB attenuation above 0.33 fs. Every other tap is zero, center tap is 0.5.
+#define HALFBAND_NUM_TAPS 31
+extern q15_t halfband_coeffs_q15[HALFBAND_NUM_TAPS];
+
+// Hann window for the granular engine (Q15), sampled at bin centers so that it is symmetric: w[i] == w[GRAIN_WINDOW_LEN - 1 - i].
+#define GRAIN_WINDOW_LEN 256
+extern q15_t grain_window_lut[GRAIN_WINDOW_LEN];
@@ -5,9 +5,16 @@
 #pragma once
 
 #include "audioengine.h"
+#include "cmd_ring.h"
+#include "dsp/decimator.h"
+#include "dsp/granular.h"
+#include "dsp/onset_detector.h"
+#include "dsp/smoother.h"
+#include "dsp/tape_codec.h"
 #include "envelope.h"
 #include "param_cache.h"
 #include "project_config.h"
+#include "util.h"
 
 #include <stdbool.h>
 #include <stddef.h>
@@ -15,22 +22,75 @@
 
 #define MAX_NUM_SLICES 128
 
+#if defined(CONFIG_TAPE_MIPMAP) && !defined(CONFIG_TAPE_BUFFER_INTERLEAVED)
+#error "mip levels are LR-packed frames, CONFIG_TAPE_MIPMAP needs CONFIG_TAPE_BUFFER_INTERLEAVED"
+#endif
+
+// Octave-decimated copies of a take, laid out behind it in its pool region. Level k holds the take lowpassed and decimated
+// by 2^k as LR-packed PCM16, its frame j lines up with take frame j << k. The TAPE_INTERP_HALF - 1 frames in front of it and
+// the guard frames behind the last one are silent, so the interpolator taps of any playhead inside the take stay inside the level.
+typedef struct {
+    uint32_t* level[TAPE_MIP_MAX_LEVELS + 1]; // level[0] is unused, that is the take itself
+    uint8_t num_levels;                       // levels laid out
+    uint8_t ready;                            // levels the worker has built, 0 until it is done
+    bool stale;                               // the take was overdubbed after the levels were built from it
+} tape_mip_t;
+
+// Frames of mip level k of a take with valid frames, without the silent ones around it.
+static inline uint32_t tape_mip_frames(uint32_t valid, uint32_t k) {
+    return valid ? ((valid - 1) >> k) + 1 : 0;
+}
+
+// Levels of a take, measured by the worker task. Levels are sample magnitudes of the louder channel, in 16-bit full scale.
 typedef struct {
-    int16_t* ch[2];         // ch[0]=L, ch[1]=R
-    uint32_t size;          // samples per channel
+    bool ready;                             // the worker measured the take, false until then
+    bool stale;                             // the take was overdubbed after it was measured
+    uint32_t num_slices;                    // slices the slice levels belong to
+    uint16_t slice_peak[MAX_NUM_SLICES];    // peak from each slice marker to the next
+    uint16_t slice_rms[MAX_NUM_SLICES];     // RMS from each slice marker to the next
+    uint8_t overview[TAPE_OVERVIEW_POINTS]; // peak of each of TAPE_OVERVIEW_POINTS equal stretches of the take, 255 = full scale
+    int16_t dc[NUM_CHANNELS];               // mean of each channel
+    uint16_t peak;                          // peak of the take around its DC offset
+    float norm_gain;                        // gain that brings peak to TAPE_NORM_PEAK, at most TAPE_NORM_MAX_GAIN
+} tape_analysis_t;
+
+typedef struct tape_buffer {
+    void* mem;              // tape pool region holding the take, NULL while the buffer has none
+    uint32_t mem_bytes;     // length of that region
+    tape_store_t store;     // encoded audio, see CONFIG_TAPE_ENCODING
+    uint32_t size;          // samples per channel, set when the take claims its memory
     uint32_t valid_samples; // number of valid recorded samples in the buffer (for playback), updated when recording is done
     uint8_t decimation;     // decimation factor for recording and playback
+    uint32_t take_id;       // identifies the take held in mem, 0 while there is none
 
     uint32_t slice_positions[MAX_NUM_SLICES]; // holds start position of each slice in samples.
     uint32_t num_slices;
+    bool slices_snapped; // the worker moved the slices to clean start points, notes starting on them need only a short fade
+    bool overdubbed;     // sound-on-sound went into the take, what the worker found out about it before is stale
+
+#ifdef CONFIG_TAPE_MIPMAP
+    tape_mip_t mip;
+#endif
+#ifdef CONFIG_TAPE_ANALYSIS
+    tape_analysis_t analysis;
+#endif
+#ifdef CONFIG_TAPE_LOOP_SEARCH
+    // cyclic loop from frame 1 to loop_end, which sounds like frame 1. valid_samples until the worker found one
+    uint32_t loop_end;
+    uint32_t loop_xfade_len; // crossfade over the wrap in output frames, 0 for none
+#endif
 } tape_buffer_t;
 
+// Interpolator of the playheads. Sinc needs CONFIG_TAPE_SINC_TAPS, without it playback stays with Hermite.
+typedef enum { TAPE_INTERP_HERMITE = 0, TAPE_INTERP_SINC, TAPE_NUM_INTERPS } tape_interp_t;
+
 // holds changeable parameters in the tape player engine. should actually not be accessed from outside
 struct parameters {
     float pitch_factor;
     float starting_position; // currently not used
     float env_attack;
     float env_decay;
+    envelope_t env_rates; // attack_inc and decay_inc of env_attack and env_decay, copied to a voice at note on
 
     // playback modes
     bool reverse;
@@ -41,7 +101,14 @@ struct parameters {
     // normalized slice position, set from CV. This is used to calculate the actual slice start position in samples when starting playback or retriggering.
     float slice_pos;
 
+    float overdub_feedback; // 0..1, how much of the old content survives an overdub pass
+    float stretch_speed;    // playback speed of the time stretch mode, 1 = original length
+
     float grit; // calculated from decimation factor, used for excite effect amount in audio processing task. 0..1 depending on decimation.
+    int32_t grit_hold_q14; // zero-order hold blend of the interpolator (grit * MAX_GRIT_ON_MAX_DECIMATION) in Q14, for the fixed-point path
+    tape_interp_t interp;  // interpolation quality, see tape_player_set_interp()
+
+    granular_params_t granular; // grain density and size from the XY CV, slice_pos is copied from above
 };
 
 // FSM logic
@@ -67,13 +134,95 @@ typedef struct {
     uint32_t
         base_ratio_q16; // for crossfades, this is the ratio between the xfade buffer and the fade LUT, in Q16.16 format. Calculated from xfade length and LUT size.
 
-    int16_t* buf_b_ptr_l;
-    int16_t* buf_b_ptr_r;
-    uint32_t
-        temp_buf_valid_samples; // number of valid samples in the xfade temp buffer (for retrigger xfade at end of recording, when there might be less than xfade.len samples available)
+    // outgoing audio: storage and valid length of the take that is fading out.
+    // Copied on crossfade start, so the crossfade keeps reading the old take even after a buffer swap.
+    tape_reader_t buf_b;
+    uint32_t buf_b_valid_samples; // bounds the outgoing playhead, the crossfade ends early if it runs out of samples
+    bool reverse;                 // direction of the outgoing playhead, latched on crossfade start
 
 } crossfade_t;
 
+#if defined(CONFIG_TAPE_OVERDUB) && CONFIG_TAPE_ENCODING == TAPE_ENC_ADPCM
+#error "ADPCM takes cannot be rewritten frame by frame, CONFIG_TAPE_OVERDUB needs another encoding"
+#endif
+#if defined(CONFIG_TAPE_OVERDUB) && defined(CONFIG_TAPE_TIME_STRETCH)
+#error "the overdub follows a plain playhead, CONFIG_TAPE_TIME_STRETCH needs CONFIG_TAPE_OVERDUB off"
+#endif
+
+// Sound-on-sound into the playback take, driven by the newest voice. Every frame that voice's playhead passes
+// is rewritten as input + feedback * old content, in the same pass that renders the voice.
+typedef struct {
+    bool enabled;
+    int32_t feedback_q15;  // weight of the old content
+    decimator_t decimator; // brings the input to the rate of the take
+    uint8_t decimation;    // decimation the decimator is set up for
+    tape_encoder_t encoder;
+
+    int16_t in[AUDIO_MAX_BLOCK_FRAMES * 2]; // decimated input of the current block, interleaved
+    uint32_t in_frames;                     // frames in in
+    uint32_t in_pos;                        // next frame of in to write, the last one repeats if the playhead runs faster
+
+    uint32_t note_seq;  // note the overdub follows, a new note starts over
+    uint32_t write_idx; // next take frame to rewrite, trails the playhead out of reach of the interpolator. UINT32_MAX if none
+} overdub_t;
+
+#ifdef CONFIG_TAPE_TIME_STRETCH
+#define STRETCH_SEARCH_CANDIDATES (2 * STRETCH_SEARCH_RADIUS / STRETCH_SEARCH_STEP + 1)
+
+// WSOLA state of a voice. Two grains overlap by half, they play at the pitch while their start positions advance at the speed.
+// Each grain starts at the candidate around its nominal position that continues the previous grain best. The candidates
+// are scored in the blocks before the grain starts, a bounded number per block.
+typedef struct {
+    uint32_t note_seq; // note the grains belong to, a new note starts over
+
+    uint64_t grain_pos_q48_16[2];
+    uint32_t grain_acc_q16[2]; // window phase, grain_window_lut index in the upper 16 bits
+    uint32_t grain_active;     // bit i set: grain i plays
+    uint8_t newest;            // grain started last, its playhead is the voice playhead
+    uint32_t to_next;          // output frames until the next grain starts
+    uint64_t analysis_q48_16;  // nominal take position of the next grain
+    bool ending;               // the take ran out (one-shot) or is too short for the pitch, no more grains
+
+    int32_t ref[STRETCH_CORR_LEN]; // mono take where the newest grain will be when the next one starts
+    uint32_t cand_first;           // take position of candidate 0
+    uint32_t cand_count;
+    uint32_t cand_next; // next candidate to score
+    bool cand_reverse;  // direction the candidates are compared in, latched so that a reverse toggle cannot move them out of the take
+    uint32_t best_pos;  // start of the next grain, the nominal position until a candidate scores
+    float best_score;   // see stretch_match_score()
+
+    cycle_stats_t search_cycles; // similarity search cost per audio block, the grains are in render_cycles
+} stretch_t;
+#endif
+
+// One playhead over the playback take, with its own fades and envelope. All voices read playback_buf,
+// a voice only keeps reading the previous take while it fades out after a buffer swap.
+typedef struct {
+    play_state_t play_state;
+    uint64_t pos_q48_16;    // playhead in Q48.16
+    tape_reader_t reader;   // reading end of the take, attached on note-on
+    uint32_t valid_samples; // length of that take, latched with the reader
+#ifdef CONFIG_TAPE_LOOP_SEARCH
+    uint32_t loop_end; // cyclic mode wraps here, see tape_buffer_t
+#endif
+    uint8_t decimation;     // decimation of that take, divides the phase increment
+    bool releasing;         // fading out since its take was swapped away, stops when fade_out ends
+    uint32_t note_seq;      // note-on order, the oldest voice is stolen first
+
+    crossfade_t xfade_retrig; // crossfade that is used on retrigger sample playback.
+    crossfade_t xfade_cyclic; // crossfade that is used on cyclic playback mode.
+    crossfade_t fade_in;      // simple fade in when starting playback
+    crossfade_t fade_out;     // simple fadeout when approaching end of playback buffer
+
+    envelope_t env;
+
+#ifdef CONFIG_TAPE_TIME_STRETCH
+    stretch_t stretch;
+#endif
+
+    cycle_stats_t render_cycles; // render cost of this voice per audio block
+} tape_voice_t;
+
 // main tape player structure
 struct tape_player {
     size_t dma_buf_size;         // buffer size RX/TX
@@ -81,49 +230,81 @@ struct tape_player {
     tape_buffer_t* record_buf;   // pointer to the tape buffer that is currently used for recording.
                                  // target of the tape
 
-    uint64_t pos_q48_16; // main playhead position in Q48.16 format. Fractional part is 16bits for performance reasons
+    tape_voice_t voices[CONFIG_TAPE_NUM_VOICES];
+    uint32_t note_seq; // note-on counter for voice stealing
 
-    bool cyclic_mode;
+#ifdef CONFIG_ENABLE_GRANULAR
+    granular_t granular; // grain cloud over the playback take, runs while any voice plays
+#endif
 
-    crossfade_t xfade_retrig; // crossfade that is used on retrigger sample playback.
-    crossfade_t xfade_cyclic; // crossfade that is used on cyclic playback mode.
-    crossfade_t fade_in;      // simple fade in when starting playback
-    crossfade_t fade_out;     // simple fadeout when approaching end of playback buffer
+    bool cyclic_mode;
 
     uint32_t tape_recordhead;
+#ifdef CONFIG_TAPE_PREROLL
+    uint32_t capture_frames; // frames the idle record buffer captured so far, up to its length. tape_recordhead runs round it meanwhile
+#endif
+    decimator_t rec_decimator; // anti-alias decimation of the input before it is written to the record buffer
+    tape_encoder_t rec_encoder; // encodes the decimated input into record_buf
+#ifdef CONFIG_TAPE_ONSET_SLICING
+    onset_detector_t onset_detector; // slices record_buf at the onsets of the input
+#endif
+#ifdef CONFIG_TAPE_OVERDUB
+    overdub_t overdub;
+#endif
 
     bool swap_bufs_pending;
     bool switch_bufs_done;
+    void* retired_take;        // pool region of the take that played before the last swap, freed once no crossfade reads it
+    void* worker_retired_take; // pool region of a take cut off while the worker reads it, freed with the worker job
+    uint32_t take_seq;         // last take_id handed out
+    uint32_t worker_take;      // take_id of a finished take waiting for the worker task, 0 if none
+#ifdef CONFIG_TAPE_ANALYSIS
+    // analysis of the playback take for the other tasks, see tape_player_get_analysis(). Odd analysis_seq while it is written.
+    tape_analysis_t analysis;
+    volatile uint32_t analysis_seq;
+#endif
+
+    uint32_t block_voice_cycles;                        // render cost of the voices in the current block, all voices and spans
+    uint32_t block_voice_frames;                        // frames they rendered in it, counted once per voice
+    cycle_stats_t voice_cycles[CONFIG_TAPE_NUM_VOICES]; // cost of one voice per block while [k - 1] = k voices play
+    cycle_stats_t interp_cycles[TAPE_NUM_INTERPS];      // cost of one voice per AUDIO_MAX_BLOCK_FRAMES with each interpolator
 
     uint32_t curr_phase_inc_q16_16; // The increment actually being used
+    smoother_t pitch_smooth;        // glides from the last pitch_factor to the current one, ticks every TAPE_PITCH_RAMP_FRAMES
 
     // states
-    play_state_t play_state;
     rec_state_t rec_state;
 
-    envelope_t env;
-
     struct parameters params;
 };
 
-// FREERTOS queue message structure
-typedef enum { TAPE_CMD_PLAY, TAPE_CMD_STOP, TAPE_CMD_RECORD, TAPE_CMD_SLICE } tape_cmd_t;
-typedef struct {
-    tape_cmd_t cmd;
-} tape_cmd_msg_t;
-
 // Public API
 int init_tape_player(size_t dma_buf_size);
 
 // entry point for tape player audio processing. The whole implementation is inside tape_player_dsp.c
-void tape_player_process(int16_t* in_buf, int16_t* out_buf);
+// Renders num_frames (at most AUDIO_MAX_BLOCK_FRAMES) interleaved stereo frames.
+// cmds are the gates of this block in the order they came in, each acts on its frame.
+void tape_player_process(const int16_t* in_buf, int16_t* out_buf, uint32_t num_frames, const tape_cmd_msg_t* cmds, uint32_t num_cmds);
 
 void tape_player_play();
 void tape_player_stop_play();
-void tape_player_record();
+void tape_player_stop_voice(tape_voice_t* v);
+void tape_player_record(uint32_t late_frames);
 void tape_player_stop_record(void);
-void tape_player_set_params(struct param_cache param_cache);
-void tape_player_set_slice();
+bool tape_player_claim_rec_take(void);
+void tape_player_arm_capture(void);
+void tape_player_set_params(const struct param_cache* param_cache, uint32_t changed);
+void tape_player_set_slice(uint32_t late_frames);
+void tape_player_set_overdub(bool on);
+void tape_player_set_interp(tape_interp_t interp);
+void tape_player_sync_worker(void);
+#ifdef CONFIG_TAPE_LOOP_SEARCH
+void tape_player_set_loop(tape_buffer_t* buf, uint32_t loop_end, uint32_t xfade_len);
+#endif
+#ifdef CONFIG_TAPE_ANALYSIS
+void tape_player_publish_analysis(void);
+bool tape_player_get_analysis(tape_analysis_t* out);
+#endif
 
 float tape_player_get_grit();
 float tape_player_get_pitch();
\ No newline at end of file
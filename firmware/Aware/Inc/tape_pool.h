@@ -0,0 +1,29 @@
+/**
+ * @file tape_pool.h
+ * @brief Region allocator for tape takes over the .sram1 RAM pool.
+ *
+ * Takes claim variable-length regions instead of fixed per-buffer arrays, so a new take can use
+ * all memory the playing take leaves free. Not reentrant: only called from the audio task.
+ */
+#pragma once
+
+#include <stdint.h>
+
+#define TAPE_POOL_MAX_REGIONS 16 // free + claimed regions tracked at once
+#define TAPE_POOL_ALIGN 4        // region start and length granularity in bytes
+
+void tape_pool_init(void);
+
+// Claim the largest free region, at most max_bytes long. Returns NULL if nothing is free.
+void* tape_pool_claim_largest(uint32_t max_bytes, uint32_t* out_bytes);
+
+// Claim the smallest free region that fits bytes. Returns NULL if none does.
+void* tape_pool_alloc(uint32_t bytes);
+
+// Shrink a claimed region to bytes and hand the tail back to the pool.
+void tape_pool_trim(void* region, uint32_t bytes);
+
+void tape_pool_release(void* region);
+
+uint32_t tape_pool_size(void);
+uint32_t tape_pool_largest_free(void);
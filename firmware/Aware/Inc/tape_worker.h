@@ -0,0 +1,77 @@
+/**
+ * @file tape_worker.h
+ * @brief Deferred post-processing of finished takes in a low-priority task, outside the audio deadline.
+ *
+ * The audio task hands a finished take over as a job, the worker task processes it and hands the results back.
+ * There is one job slot, its state field is the only thing both tasks touch besides the cancel flag: the audio task
+ * fills the job while it is idle and submits it, the worker owns it while pending, the audio task applies and frees
+ * it when done. The worker reads the take and writes its mip levels, so the take's pool region stays claimed until
+ * the job is released, see tape_worker_reads(). The worker goes through the take in steps of at most
+ * TAPE_WORKER_CHUNK_FRAMES, so a retired take is let go within one step, see tape_worker_cancel().
+ * Its results are dropped, see take_id.
+ */
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "FreeRTOS.h"
+#include "task.h"
+
+#include "dsp/tape_codec.h"
+#include "tape_player.h"
+
+typedef enum { TAPE_JOB_IDLE = 0, TAPE_JOB_PENDING, TAPE_JOB_DONE } tape_job_state_t;
+
+typedef struct {
+    volatile tape_job_state_t state;
+    volatile bool cancel; // set by the audio task, the worker ends the job at its next step
+
+    // input, copied from the take on submit
+    uint32_t take_id;       // take the job belongs to, results are applied only while it is still around
+    tape_reader_t reader;   // reading end of the worker, with its own decode cache
+    uint32_t valid_samples; // recorded length of the take
+    uint8_t decimation;
+
+    // input and result: slice markers, snapped to clean start points by the worker
+    uint32_t slice_positions[MAX_NUM_SLICES];
+    uint32_t num_slices;
+
+#ifdef CONFIG_TAPE_MIPMAP
+    // mip levels to build, laid out by the audio task
+    tape_mip_t mip;
+#endif
+#ifdef CONFIG_TAPE_ANALYSIS
+    // result: levels of the take, at the slice markers above
+    tape_analysis_t analysis;
+#endif
+#ifdef CONFIG_TAPE_LOOP_SEARCH
+    // result: loop point for cyclic playback
+    uint32_t loop_end;
+    uint32_t loop_xfade_len;
+#endif
+} tape_job_t;
+
+/** @brief Set the task that runs tape_worker_process(). Call before the audio task starts. */
+void tape_worker_init(TaskHandle_t worker_task);
+
+/** @brief Audio task: the job slot if it is free to fill, else NULL. */
+tape_job_t* tape_worker_acquire(void);
+
+/** @brief Audio task: hand the filled job to the worker. */
+void tape_worker_submit(tape_job_t* job);
+
+/** @brief Audio task: the job slot if the worker finished it, else NULL. Free it with tape_worker_release(). */
+tape_job_t* tape_worker_done(void);
+
+/** @brief Audio task: free the finished job slot. */
+void tape_worker_release(tape_job_t* job);
+
+/** @brief Audio task: true while the job slot holds the take in pool region mem, the worker may read and write it. */
+bool tape_worker_reads(const void* mem);
+
+/** @brief Audio task: end the job early if it reads the take in pool region mem, which was retired. */
+void tape_worker_cancel(const void* mem);
+
+/** @brief Worker task: run one step of the pending job, if any. Returns true while steps remain. */
+bool tape_worker_process(void);
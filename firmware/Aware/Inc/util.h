@@ -6,17 +6,108 @@
 
 #include <stdint.h>
 
+#include "audioengine.h"
+#include "stm32h7xx_hal.h"
+
 typedef struct {
     uint32_t audio_percent;
     uint32_t control_percent;
     uint32_t userif_percent;
+    uint32_t worker_percent;
     uint32_t idle_percent;
+    uint32_t onset_cycles;                         // onset detector, average DWT cycles per audio block while recording
+    uint32_t gate_latency_max;                     // gate edge to the output of the frame it acts on, worst case in DWT cycles
+    uint32_t gate_jitter;                          // spread of that latency, max - min in DWT cycles
+    uint32_t param_fetch_cycles;                   // param_cache_fetch(), average DWT cycles per DMA period
+    uint32_t param_apply_cycles;                   // coefficients of the changed parameters, average DWT cycles per DMA period
+    uint32_t frame_cycles[AUDIO_NUM_PROFILES];     // audio pipeline, average DWT cycles per frame in each profile, 0 until it ran
+    uint32_t voice_cycles[CONFIG_TAPE_NUM_VOICES]; // one tape voice, average DWT cycles per block while [k - 1] = k voices play
+    uint32_t hermite_frame_cycles;                 // one tape voice with Hermite, average DWT cycles per frame, 0 until it played
+    uint32_t sinc_frame_cycles;                    // the same with the windowed sinc (CONFIG_TAPE_SINC_TAPS)
+    uint32_t stretch_search_cycles;                // WSOLA search of one voice, average DWT cycles per block (CONFIG_TAPE_TIME_STRETCH)
+    uint32_t stretch_search_max;                   // and its worst block, all voices
 } cpu_stats_t;
 
 extern volatile cpu_stats_t cpu_stats;
 
+// Audio deadline monitor, kept by the audio task. The output written for a DMA period starts playing when the DMA comes round
+// to it, AUDIO_DMA_PERIODS - 1 periods after the transfer that received it: that is the deadline. Times in DWT cycles per period.
+typedef enum {
+    AUDIO_STAGE_PARAMS = 0, // parameter fetch and coefficients, before the wait for the period
+    AUDIO_STAGE_TAPE,       // tape player, all blocks of the period
+    AUDIO_STAGE_EXCITER,    // exciter and its mix
+    AUDIO_STAGE_REVERB,     // reverb, writes the output period
+    AUDIO_STAGE_TOTAL,      // end of the transfer to the last output frame, wake-up of the task included
+    AUDIO_NUM_STAGES
+} audio_stage_t;
+
+typedef struct {
+    uint32_t min;
+    uint32_t avg;         // exponential moving average, 1/16 weight per period
+    uint32_t max;
+    uint32_t avg_percent; // of the deadline, set by update_cpu_stats()
+    uint32_t max_percent;
+} audio_stage_stats_t;
+
+typedef struct {
+    uint32_t periods;          // periods processed
+    uint32_t late;             // periods finished after their output started playing, which played partly stale
+    uint32_t lost;             // periods the DMA came round to before the task got to them, their output played stale
+    uint32_t i2s_errors;       // overruns, underruns and frame errors of the I2S, transfer errors of its DMA streams
+    uint32_t wake_latency_max; // end of the transfer to the start of processing, worst case
+    uint32_t headroom_min;     // cycles left before the deadline, least so far, 0 once a period was late
+    uint32_t deadline_cycles;  // AUDIO_DMA_PERIODS - 1 periods of the current profile, as measured
+    audio_stage_stats_t stages[AUDIO_NUM_STAGES];
+} audio_deadline_stats_t;
+
+extern volatile audio_deadline_stats_t audio_deadline;
+
 void update_cpu_stats(void);
 
+// DWT cycle counts of one code section, e.g. one voice per audio block. Needs DWT_Init().
+typedef struct {
+    uint32_t last;
+    uint32_t max;
+    uint32_t avg; // exponential moving average, 1/16 weight per sample
+} cycle_stats_t;
+
+static inline uint32_t cycle_stats_begin(void) {
+    return DWT->CYCCNT;
+}
+
+static inline void cycle_stats_add(cycle_stats_t* s, uint32_t cycles) {
+    s->last = cycles;
+    if (cycles > s->max)
+        s->max = cycles;
+    s->avg += ((int32_t) (cycles - s->avg)) >> 4;
+}
+
+static inline void cycle_stats_end(cycle_stats_t* s, uint32_t start) {
+    cycle_stats_add(s, DWT->CYCCNT - start);
+}
+
+// Spread of a delay in DWT cycles, e.g. from a gate edge to the output of the frame it acts on. Jitter is max - min.
+typedef struct {
+    uint32_t count;
+    uint32_t min;
+    uint32_t max;
+    uint32_t avg; // exponential moving average, 1/16 weight per sample
+} latency_stats_t;
+
+static inline void latency_stats_add(latency_stats_t* s, uint32_t cycles) {
+    if (s->count == 0) {
+        s->min = cycles;
+        s->max = cycles;
+        s->avg = cycles;
+    }
+    if (cycles < s->min)
+        s->min = cycles;
+    if (cycles > s->max)
+        s->max = cycles;
+    s->avg += ((int32_t) (cycles - s->avg)) >> 4;
+    s->count++;
+}
+
 static inline uint32_t min_u32(uint32_t a, uint32_t b) {
     return (a < b) ? a : b;
 }
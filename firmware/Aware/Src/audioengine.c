@@ -5,13 +5,65 @@
 #include "audioengine.h"
 
 #include <stdint.h>
+
+#include "task.h"
+
+_Static_assert(AUDIO_DMA_PERIODS >= 2, "the DMA streams need two memory targets");
+
 // local DMA buffers for audio I/O - will be allocated in DMA-capable memory, not in FREERTOS task stack!
-DMA_BUFFER static int16_t tx_buf[AUDIO_BLOCK_SIZE] = {0};
-DMA_BUFFER static int16_t rx_buf[AUDIO_BLOCK_SIZE] = {0};
+DMA_BUFFER static int16_t tx_buf[AUDIO_DMA_PERIODS * AUDIO_MAX_PERIOD_FRAMES * 2] = {0};
+DMA_BUFFER static int16_t rx_buf[AUDIO_DMA_PERIODS * AUDIO_MAX_PERIOD_FRAMES * 2] = {0};
 
 // file-local pointer to the active config (not exported)
 static struct audioengine_config* active_cfg = NULL;
 
+static const audio_profile_t profiles[AUDIO_NUM_PROFILES] = {
+    [AUDIO_PROFILE_LOW_LATENCY] = {.period_frames = 16, .block_frames = 16},
+    [AUDIO_PROFILE_BALANCED] = {.period_frames = 32, .block_frames = 32},
+    [AUDIO_PROFILE_THROUGHPUT] = {.period_frames = 128, .block_frames = 128},
+    [AUDIO_PROFILE_THROUGHPUT_FINE] = {.period_frames = 128, .block_frames = 32},
+};
+static const audio_profile_id_t profile_id = CONFIG_AUDIO_PROFILE;
+
+// DWT cycle count at the end of the last period transfer and the cycles since the one before
+static volatile uint32_t block_end_cycles;
+static volatile uint32_t block_period_cycles;
+
+// Both DMA streams run in double-buffer mode over the ring, one period per memory target. When a target completes, the
+// stream moves on to the other one and the completed target is pointed at the period after that, so the stream walks
+// round all AUDIO_DMA_PERIODS periods. Each stream keeps its own position, they complete their periods in the same order.
+typedef struct {
+    int16_t* buf;
+    uint32_t next; // period the completed memory target is pointed at next
+} dma_ring_t;
+
+static dma_ring_t tx_ring = {.buf = tx_buf};
+static dma_ring_t rx_ring = {.buf = rx_buf};
+
+// Periods received since the start of the DMA and periods the audio task processed, period i is in slot i % AUDIO_DMA_PERIODS.
+static volatile uint32_t periods_done;
+static uint32_t periods_taken;
+
+// errors reported by the I2S and its DMA streams, see HAL_I2S_ErrorCallback()
+static volatile uint32_t i2s_errors;
+
+static inline uint32_t period_samples(void) {
+    return profiles[profile_id].period_frames * 2;
+}
+
+// the period the audio task processes next, in both rings
+static void point_at_oldest_period(void) {
+    uint32_t offset = (periods_taken % AUDIO_DMA_PERIODS) * period_samples();
+    active_cfg->tx_buf_ptr = &tx_buf[offset];
+    active_cfg->rx_buf_ptr = &rx_buf[offset];
+}
+
+static inline void mark_block_end(void) {
+    uint32_t now = DWT->CYCCNT;
+    block_period_cycles = now - block_end_cycles;
+    block_end_cycles = now;
+}
+
 int init_audioengine(struct audioengine_config* config) {
     if (config == NULL || config->i2s_handle == NULL)
         return AUDIOENGINE_ERROR;
@@ -19,16 +71,111 @@ int init_audioengine(struct audioengine_config* config) {
 
     active_cfg->tx_buf_ptr = &tx_buf[0];
     active_cfg->rx_buf_ptr = &rx_buf[0];
+    active_cfg->buffer_size = AUDIO_DMA_PERIODS * profiles[profile_id].period_frames * 2;
 
     return AUDIOENGINE_OK;
 }
 
+static void ring_rotate(DMA_HandleTypeDef* hdma, dma_ring_t* ring, HAL_DMA_MemoryTypeDef target) {
+    HAL_DMAEx_ChangeMemory(hdma, (uint32_t) &ring->buf[ring->next * period_samples()], target);
+    ring->next = (ring->next + 1) % AUDIO_DMA_PERIODS;
+}
+
+// A received period is complete: its input is in, its output slot played and is free until the stream comes round to it.
+static void period_received(void) {
+    mark_block_end();
+    periods_done++;
+
+    // signal task from ISR, it catches up on all pending periods
+    BaseType_t hpw = pdFALSE;
+    xTaskNotifyFromISR(active_cfg->audioTaskHandle, 0, eIncrement, &hpw);
+    portYIELD_FROM_ISR(hpw);
+}
+
+// DMA callbacks, XferCpltCallback when memory target 0 completed and XferM1CpltCallback for target 1
+static void tx_m0_done(DMA_HandleTypeDef* hdma) {
+    ring_rotate(hdma, &tx_ring, MEMORY0);
+}
+
+static void tx_m1_done(DMA_HandleTypeDef* hdma) {
+    ring_rotate(hdma, &tx_ring, MEMORY1);
+}
+
+static void rx_m0_done(DMA_HandleTypeDef* hdma) {
+    ring_rotate(hdma, &rx_ring, MEMORY0);
+    period_received();
+}
+
+static void rx_m1_done(DMA_HandleTypeDef* hdma) {
+    ring_rotate(hdma, &rx_ring, MEMORY1);
+    period_received();
+}
+
+static void ring_error(DMA_HandleTypeDef* hdma) {
+    (void) hdma;
+    HAL_I2S_ErrorCallback(active_cfg->i2s_handle);
+}
+
+// Overrun, underrun or frame error of the I2S from HAL_I2S_IRQHandler(), or a DMA stream error from ring_error().
+// The HAL turns the I2S error interrupts off and marks the I2S ready, while the ring runs on: count the error, take both back.
+void HAL_I2S_ErrorCallback(I2S_HandleTypeDef* hi2s) {
+    i2s_errors++;
+    hi2s->ErrorCode = HAL_I2S_ERROR_NONE;
+    hi2s->State = HAL_I2S_STATE_BUSY_TX_RX;
+    __HAL_I2S_ENABLE_IT(hi2s, I2S_IT_OVR | I2S_IT_UDR | I2S_IT_FRE);
+}
+
+// HAL_I2SEx_TransmitReceive_DMA() with both streams in double-buffer mode, which the HAL has no I2S call for.
+// RX first, so that no input is missed once the transmission starts.
+static HAL_StatusTypeDef start_ring_dma(I2S_HandleTypeDef* hi2s) {
+    uint32_t n = period_samples();
+    tx_ring.next = 2 % AUDIO_DMA_PERIODS;
+    rx_ring.next = 2 % AUDIO_DMA_PERIODS;
+
+    hi2s->ErrorCode = HAL_I2S_ERROR_NONE;
+    hi2s->State = HAL_I2S_STATE_BUSY_TX_RX;
+
+    hi2s->hdmarx->XferHalfCpltCallback = NULL;
+    hi2s->hdmarx->XferM1HalfCpltCallback = NULL;
+    hi2s->hdmarx->XferCpltCallback = rx_m0_done;
+    hi2s->hdmarx->XferM1CpltCallback = rx_m1_done;
+    hi2s->hdmarx->XferErrorCallback = ring_error;
+    uint32_t rxdr = (uint32_t) &hi2s->Instance->RXDR;
+    if (HAL_DMAEx_MultiBufferStart_IT(hi2s->hdmarx, rxdr, (uint32_t) &rx_buf[0], (uint32_t) &rx_buf[n], n) != HAL_OK)
+        return HAL_ERROR;
+    SET_BIT(hi2s->Instance->CFG1, SPI_CFG1_RXDMAEN);
+
+    hi2s->hdmatx->XferHalfCpltCallback = NULL;
+    hi2s->hdmatx->XferM1HalfCpltCallback = NULL;
+    hi2s->hdmatx->XferCpltCallback = tx_m0_done;
+    hi2s->hdmatx->XferM1CpltCallback = tx_m1_done;
+    hi2s->hdmatx->XferErrorCallback = ring_error;
+    uint32_t txdr = (uint32_t) &hi2s->Instance->TXDR;
+    if (HAL_DMAEx_MultiBufferStart_IT(hi2s->hdmatx, (uint32_t) &tx_buf[0], txdr, (uint32_t) &tx_buf[n], n) != HAL_OK)
+        return HAL_ERROR;
+    SET_BIT(hi2s->Instance->CFG1, SPI_CFG1_TXDMAEN);
+
+    // like the HAL call, report overruns, underruns and frame errors through the SPI1 interrupt
+    __HAL_I2S_ENABLE_IT(hi2s, I2S_IT_OVR | I2S_IT_UDR | I2S_IT_FRE);
+
+    if (HAL_IS_BIT_CLR(hi2s->Instance->CR1, SPI_CR1_SPE))
+        __HAL_I2S_ENABLE(hi2s);
+    SET_BIT(hi2s->Instance->CR1, SPI_CR1_CSTART);
+    return HAL_OK;
+}
+
 int start_audio_engine(void) {
     if (active_cfg == NULL || active_cfg->i2s_handle == NULL)
         return AUDIOENGINE_NOT_INITIALIZED;
 
-    HAL_StatusTypeDef hal_status = HAL_I2SEx_TransmitReceive_DMA(
-        active_cfg->i2s_handle, (void*) active_cfg->tx_buf_ptr, (void*) active_cfg->rx_buf_ptr, active_cfg->buffer_size);
+    // the first period is timed against the nominal length
+    block_period_cycles = (uint32_t) (((uint64_t) SystemCoreClock * profiles[profile_id].period_frames) / active_cfg->sample_rate);
+    block_end_cycles = DWT->CYCCNT;
+    periods_done = 0;
+    periods_taken = 0;
+    point_at_oldest_period();
+
+    HAL_StatusTypeDef hal_status = start_ring_dma(active_cfg->i2s_handle);
 
     if (hal_status != HAL_OK)
         return AUDIOENGINE_ERROR;
@@ -36,54 +183,72 @@ int start_audio_engine(void) {
     return AUDIOENGINE_OK;
 }
 
+audio_profile_id_t audio_profile_id(void) {
+    return profile_id;
+}
+
+const audio_profile_t* audio_profile(void) {
+    return &profiles[profile_id];
+}
+
 void audio_write_to_dma_buf(int16_t l, int16_t r, uint32_t sample_idx) {
-    if (sample_idx >= active_cfg->buffer_size / 2)
+    if (sample_idx >= period_samples())
         return; // out of bounds
 
     active_cfg->tx_buf_ptr[sample_idx] = l;
     active_cfg->tx_buf_ptr[sample_idx + 1] = r;
 }
 
-void audio_get_dma_in_buf(int16_t* buf, uint32_t buf_size) {
-    for (uint8_t n = 0; n < (buf_size) -1; n += 2) { // -1: ensures n+1 stays in bounds for stereo pairs
-        buf[n] = active_cfg->rx_buf_ptr[n];
-        buf[n + 1] = active_cfg->rx_buf_ptr[n + 1];
-    }
+uint32_t audio_i2s_errors(void) {
+    return i2s_errors;
 }
 
-void audio_write_dma_out_buf(int16_t* buf, uint32_t buf_size) {
-    for (uint8_t n = 0; n < (buf_size) -1; n += 2) {
-        active_cfg->tx_buf_ptr[n] = buf[n];
-        active_cfg->tx_buf_ptr[n + 1] = buf[n + 1];
-    }
+uint32_t audio_dma_pending(void) {
+    return periods_done - periods_taken;
 }
 
-// overload HAL I2S DMA Complete and HalfComplete callbacks to handle double buffering
-void HAL_I2SEx_TxRxHalfCpltCallback(I2S_HandleTypeDef* i2s_handle) {
-    // First half of TX and RX buffers completed
-    active_cfg->tx_buf_ptr = &tx_buf[0];
-    active_cfg->rx_buf_ptr = &rx_buf[0];
+uint32_t audio_dma_drop_overrun(void) {
+    uint32_t pending = audio_dma_pending();
+    if (pending < AUDIO_DMA_PERIODS)
+        return 0;
 
-    // signal task from ISR
-    BaseType_t hpw = pdFALSE;
-    xTaskNotifyFromISR(active_cfg->audioTaskHandle, 1, eSetValueWithOverwrite, &hpw);
-    portYIELD_FROM_ISR(hpw);
+    uint32_t dropped = pending - (AUDIO_DMA_PERIODS - 1);
+    periods_taken += dropped;
+    point_at_oldest_period();
+    return dropped;
 }
 
-void HAL_I2SEx_TxRxCpltCallback(I2S_HandleTypeDef* i2s_handle) {
-    // Second half of TX and RX buffers completed
-    active_cfg->tx_buf_ptr = &tx_buf[active_cfg->buffer_size / 2];
-    active_cfg->rx_buf_ptr = &rx_buf[active_cfg->buffer_size / 2];
+void audio_dma_period_done(void) {
+    periods_taken++;
+    point_at_oldest_period();
+}
 
-    // signal task from ISR
-    BaseType_t hpw = pdFALSE;
-    xTaskNotifyFromISR(active_cfg->audioTaskHandle, 1, eSetValueWithOverwrite, &hpw);
-    portYIELD_FROM_ISR(hpw);
+// The DMA streams stay off the period until they come round to it again, so it needs no volatile access.
+const int16_t* audio_dma_in_block(void) {
+    return (const int16_t*) active_cfg->rx_buf_ptr;
+}
+
+int16_t* audio_dma_out_block(void) {
+    return (int16_t*) active_cfg->tx_buf_ptr;
+}
+
+void audio_block_timing(uint32_t* end_cycles, uint32_t* period_cycles) {
+    // read the pair and the count of one transfer, a period may complete meanwhile
+    uint32_t end, period, done;
+    do {
+        done = periods_done;
+        end = block_end_cycles;
+        period = block_period_cycles;
+    } while (done != periods_done);
+
+    // the transfers pending after the oldest one came one period apart
+    *end_cycles = end - (done - periods_taken - 1) * period;
+    *period_cycles = period;
 }
 
 /* TESTFUNCTIONALITIES FROM HERE ON */
 void loopback_samples() {
-    for (uint8_t n = 0; n < (active_cfg->buffer_size / 2) - 1; n += 2) {
+    for (uint32_t n = 0; n < period_samples() - 1; n += 2) {
         // loopback adc data to dac
         // float gain = 1.3; // 1.3 gain corresponds to approx +3dB, which is the atteunation by the input/output stages
         float gain = 1; // unity gain
@@ -105,7 +270,7 @@ void initSineTable() {
 }
 
 void generateSineWave(uint16_t* phaseIndex, double phaseIncrement) {
-    for (uint8_t n = 0; n < (active_cfg->buffer_size / 2) - 1; n += 2) {
+    for (uint32_t n = 0; n < period_samples() - 1; n += 2) {
         // Lookup sine value from table
         // left+right
         active_cfg->tx_buf_ptr[n] = sineTable[*phaseIndex];
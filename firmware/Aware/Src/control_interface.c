@@ -58,6 +58,9 @@ void control_interface_process() {
         control_interface_cfg.cv_ins[i].val = v;
     }
 
+    // pitch, slice position and the XY parameters of this CV frame reach the audio task together
+    param_cache_begin();
+
     /* ----- V/Oct CV In ----- */
     float v_oct_normalized = control_interface_cfg.cv_ins[CV_V_OCT].val;    // 0..1
     float pitch_scale = control_interface_cfg.calib_data->voct_pitch_scale; // pitch_scale = semitones per normalized CV unit
@@ -102,6 +105,8 @@ void control_interface_process() {
     norm_y = fmaxf(-1.0f, fminf(1.0f, norm_y));
 
     xy_mapper_update(norm_x, norm_y);
+
+    param_cache_publish();
 }
 
 // 2-point V/Oct calibration routine.
@@ -23,13 +23,13 @@ int init_gpio_interface(TaskHandle_t controlIfTaskHandle,
                         TaskHandle_t userIfTaskHandle,
                         TIM_HandleTypeDef* htim_button1_debounce,
                         TIM_HandleTypeDef* htim_button2_debounce,
-                        QueueHandle_t tape_cmd_q) {
-    if (controlIfTaskHandle == NULL || userIfTaskHandle == NULL || tape_cmd_q == NULL)
+                        cmd_ring_t* tape_cmd_ring) {
+    if (controlIfTaskHandle == NULL || userIfTaskHandle == NULL || tape_cmd_ring == NULL)
         return -1;
 
     gpio_config.controlIfTaskHandle = controlIfTaskHandle;
     gpio_config.userIfTaskHandle = userIfTaskHandle;
-    gpio_config.tape_cmd_q = tape_cmd_q;
+    gpio_config.tape_cmd_ring = tape_cmd_ring;
     gpio_config.htim_button1_debounce = htim_button1_debounce;
 
     // For 20ms debounce timer
@@ -78,11 +78,14 @@ void button_debounce_timer_callback(TIM_HandleTypeDef* htim) {
 }
 
 void HAL_GPIO_EXTI_Callback(uint16_t GPIO_Pin) {
+    // first thing, the audio task places the gate in its block by this timestamp
+    uint32_t now = DWT->CYCCNT;
+
     if (gpio_config.userIfTaskHandle == NULL) {
         return;
     }
     BaseType_t hpw = pdFALSE;
-    tape_cmd_msg_t msg;
+    tape_cmd_msg_t msg = {.cycles = now};
 
     // button presses trigger notifications to interface task
     if (GPIO_Pin == BUTTON1_IN_Pin) {
@@ -105,13 +108,13 @@ void HAL_GPIO_EXTI_Callback(uint16_t GPIO_Pin) {
     }
     if (GPIO_Pin == GATE1_IN_Pin) {
         msg.cmd = TAPE_CMD_PLAY;
-        xQueueSendFromISR(gpio_config.tape_cmd_q, &msg, &hpw);
+        cmd_ring_push(gpio_config.tape_cmd_ring, &msg);
         xTaskNotifyFromISR(gpio_config.userIfTaskHandle, GPIO_NOTIFY_GATE1, eSetBits, &hpw);
         portYIELD_FROM_ISR(hpw);
     }
     if (GPIO_Pin == GATE2_IN_Pin) {
         msg.cmd = TAPE_CMD_RECORD;
-        xQueueSendFromISR(gpio_config.tape_cmd_q, &msg, &hpw);
+        cmd_ring_push(gpio_config.tape_cmd_ring, &msg);
         xTaskNotifyFromISR(gpio_config.userIfTaskHandle, GPIO_NOTIFY_GATE2, eSetBits, &hpw);
         portYIELD_FROM_ISR(hpw);
     }
@@ -127,7 +130,7 @@ void HAL_GPIO_EXTI_Callback(uint16_t GPIO_Pin) {
 
     if (GPIO_Pin == GATE4_IN_Pin) {
         msg.cmd = TAPE_CMD_SLICE;
-        xQueueSendFromISR(gpio_config.tape_cmd_q, &msg, &hpw);
+        cmd_ring_push(gpio_config.tape_cmd_ring, &msg);
         xTaskNotifyFromISR(gpio_config.userIfTaskHandle, GPIO_NOTIFY_GATE4, eSetBits, &hpw);
         portYIELD_FROM_ISR(hpw);
     }
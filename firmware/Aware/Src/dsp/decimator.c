@@ -0,0 +1,97 @@
+/**
+ * @file decimator.c
+ * @brief Half-band cascade decimator built on CMSIS-DSP arm_fir_decimate_q15.
+ */
+#include "dsp/decimator.h"
+
+#include <string.h>
+
+#include "util.h"
+
+void decimator_init(decimator_t* dec, uint8_t factor, decimator_mode_t mode) {
+    uint8_t num_stages = 0;
+    while ((1u << num_stages) < factor && num_stages < DECIMATOR_MAX_STAGES)
+        num_stages++;
+
+    dec->num_stages = num_stages;
+    dec->mode = mode;
+    dec->skip = 0;
+
+    // start from silence, so the new take does not pick up the tail of the previous recording
+    memset(dec->state, 0, sizeof(dec->state));
+
+    for (uint8_t ch = 0; ch < 2; ch++) {
+        for (uint8_t s = 0; s < num_stages; s++) {
+            arm_fir_decimate_init_q15(
+                &dec->stages[ch][s], HALFBAND_NUM_TAPS, 2, halfband_coeffs_q15, dec->state[ch][s], DECIMATOR_MAX_BLOCK >> s);
+        }
+    }
+}
+
+// Keep every Nth frame, the phase carries over so that block sizes need not be a multiple of N.
+static uint32_t decimator_process_aliased(decimator_t* dec, const int16_t* in, uint32_t num_frames, int16_t* out) {
+    uint32_t factor = 1u << dec->num_stages;
+    uint32_t n_out = 0;
+    uint32_t i = dec->skip;
+
+    for (; i < num_frames; i += factor) {
+        out[2 * n_out] = in[2 * i];
+        out[2 * n_out + 1] = in[2 * i + 1];
+        n_out++;
+    }
+    dec->skip = i - num_frames;
+
+    return n_out;
+}
+
+// One pass of the filtered cascade over at most DECIMATOR_MAX_BLOCK frames.
+static uint32_t decimator_process_chunk(decimator_t* dec, const int16_t* in, uint32_t num_frames, int16_t* out) {
+    // ping-pong buffers per channel, each stage halves the block
+    q15_t buf_a[2][DECIMATOR_MAX_BLOCK];
+    q15_t buf_b[2][DECIMATOR_MAX_BLOCK / 2];
+
+    for (uint32_t i = 0; i < num_frames; i++) {
+        buf_a[0][i] = in[2 * i];
+        buf_a[1][i] = in[2 * i + 1];
+    }
+
+    uint32_t n = num_frames;
+    for (uint8_t ch = 0; ch < 2; ch++) {
+        q15_t* src = buf_a[ch];
+        q15_t* dst = buf_b[ch];
+        n = num_frames;
+
+        for (uint8_t s = 0; s < dec->num_stages; s++) {
+            arm_fir_decimate_q15(&dec->stages[ch][s], src, dst, n);
+            n >>= 1;
+
+            q15_t* tmp = src;
+            src = dst;
+            dst = tmp;
+        }
+
+        // result of the last stage is in src
+        for (uint32_t i = 0; i < n; i++)
+            out[2 * i + ch] = src[i];
+    }
+
+    return n;
+}
+
+uint32_t decimator_process(decimator_t* dec, const int16_t* in, uint32_t num_frames, int16_t* out) {
+    if (dec->num_stages == 0) {
+        memcpy(out, in, num_frames * 2 * sizeof(int16_t));
+        return num_frames;
+    }
+
+    if (dec->mode == DECIMATOR_ALIASED)
+        return decimator_process_aliased(dec, in, num_frames, out);
+
+    // longer blocks in passes of DECIMATOR_MAX_BLOCK, the filter state carries over
+    uint32_t n_out = 0;
+    for (uint32_t pos = 0; pos < num_frames; pos += DECIMATOR_MAX_BLOCK) {
+        uint32_t n = min_u32(DECIMATOR_MAX_BLOCK, num_frames - pos);
+        n_out += decimator_process_chunk(dec, &in[2 * pos], n, &out[2 * n_out]);
+    }
+    return n_out;
+}
@@ -8,6 +8,8 @@
 #include <stdint.h>
 #include <string.h>
 
+#include "util.h"
+
 float alpha = 0.8f;
 
 // b1 = -1.3856, b2 = 0.6, a0 = 0.74641, a1 = -1.4928, a2 = 0.74641
@@ -61,31 +63,38 @@ void bitcrusher(const float* input, float* output, uint32_t len, float normfreq,
     }
 }
 
-void excite_block(excite_config_t* config, const int16_t* in_buf, int16_t* out_buf, uint32_t block_size, float freq) {
-    float work_buf[block_size];
+// The filter state carries over, so a long block is processed in chunks on a work buffer of fixed size.
+void excite_block(excite_config_t* config, const int16_t* in_buf, int16_t* out_buf, uint32_t num_frames, float freq) {
+    float work_buf[EXCITE_CHUNK_FRAMES * 2];
 
-    for (uint32_t i = 0; i < block_size; i++) {
-        work_buf[i] = (float) in_buf[i] / 32768.0f;
-    }
+    for (uint32_t pos = 0; pos < num_frames; pos += EXCITE_CHUNK_FRAMES) {
+        uint32_t frames = min_u32(EXCITE_CHUNK_FRAMES, num_frames - pos);
+        uint32_t block_size = 2 * frames;
+        const int16_t* in = &in_buf[2 * pos];
+        int16_t* out = &out_buf[2 * pos];
 
-    uint32_t frames = block_size / 2;
-    // 1. hipass signal
-    arm_biquad_cascade_stereo_df2T_f32(&config->iir_in_instance, work_buf, work_buf, frames);
+        for (uint32_t i = 0; i < block_size; i++) {
+            work_buf[i] = (float) in[i] / 32768.0f;
+        }
 
-    // bitcrush the block
-    // bitcrusher(work_buf_out, work_buf_out, block_size, 48000, 16);
+        // 1. hipass signal
+        arm_biquad_cascade_stereo_df2T_f32(&config->iir_in_instance, work_buf, work_buf, frames);
 
-    //TODO: is exciter really needed here?
-    // 2. nolinear distortion to create harmonics of decimated signal
-    // use cubic softclip, taken from https : //wiki.analog.com/resources/tools-software/sigmastudio/toolbox/nonlinearprocessors/standardcubic
-    for (uint32_t i = 0; i < block_size; i++) {
-        // work_buf[i] = softclip_sam.ple(work_buf[i], alpha);
-        // work_buf[i] = 0.3 * tanh_distortion(work_buf[i], 15.0f);
-        // work_buf[i] = fast_tanh(work_buf[i]);
-    }
+        // bitcrush the block
+        // bitcrusher(work_buf_out, work_buf_out, block_size, 48000, 16);
 
-    // arm_biquad_cascade_stereo_df2T_f32(&active_config->iir_out_instance, work_buf, work_buf, frames);
+        //TODO: is exciter really needed here?
+        // 2. nolinear distortion to create harmonics of decimated signal
+        // use cubic softclip, taken from https : //wiki.analog.com/resources/tools-software/sigmastudio/toolbox/nonlinearprocessors/standardcubic
+        for (uint32_t i = 0; i < block_size; i++) {
+            // work_buf[i] = softclip_sam.ple(work_buf[i], alpha);
+            // work_buf[i] = 0.3 * tanh_distortion(work_buf[i], 15.0f);
+            // work_buf[i] = fast_tanh(work_buf[i]);
+        }
+
+        // arm_biquad_cascade_stereo_df2T_f32(&active_config->iir_out_instance, work_buf, work_buf, frames);
 
-    for (uint32_t i = 0; i < block_size; i++)
-        out_buf[i] = (int16_t) (work_buf[i] * 32768.0f);
-}
\ No newline at end of file
+        for (uint32_t i = 0; i < block_size; i++)
+            out[i] = (int16_t) (work_buf[i] * 32768.0f);
+    }
+}
@@ -0,0 +1,134 @@
+/**
+ * @file granular.c
+ * @brief Grain scheduler and pool management. Grains are rendered by tape_render_grains() in tape_player_dsp.c.
+ */
+#include "dsp/granular.h"
+
+#include <math.h>
+#include <string.h>
+
+#include "arm_math.h"
+#include "tape_player.h"
+
+static inline uint32_t xorshift32(uint32_t* state) {
+    uint32_t x = *state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    *state = x;
+    return x;
+}
+
+void granular_init(granular_t* g) {
+    memset(g, 0, sizeof(*g));
+    tape_reader_attach(&g->reader, NULL);
+    g->decimation = 1;
+    g->rng = 0x9E3779B9u;
+    g->gain_q15 = INT16_MAX;
+}
+
+void granular_stop(granular_t* g) {
+    g->active = 0;
+    g->releasing = false;
+    tape_reader_attach(&g->reader, NULL);
+}
+
+void granular_release(granular_t* g) {
+    if (!g->active) {
+        granular_stop(g);
+        return;
+    }
+
+    g->releasing = true;
+
+    // move every grain onto the falling half of its window, mirrored so that its gain does not jump,
+    // and speed the window up so that it ends within GRANULAR_RELEASE_FRAMES
+    for (uint32_t bits = g->active; bits; bits &= bits - 1) {
+        uint32_t i = __CLZ(__RBIT(bits));
+        uint32_t acc = g->win_acc_q16[i];
+        if (acc < GRANULAR_WINDOW_END / 2)
+            acc = GRANULAR_WINDOW_END - 1 - acc;
+        g->win_acc_q16[i] = acc;
+
+        uint32_t step = (GRANULAR_WINDOW_END - acc) / GRANULAR_RELEASE_FRAMES + 1;
+        if (step > g->win_step_q16[i])
+            g->win_step_q16[i] = step;
+    }
+}
+
+// Start position of a new grain of span frames: the selected slice marker plus jitter, or UINT32_MAX if the take is too short.
+static uint32_t granular_start_pos(granular_t* g, const tape_buffer_t* take, float slice_pos, uint32_t span) {
+    // Hermite reads idx-1..idx+2, the grain must end 4 frames before the end of the take
+    if (g->valid_samples < span + 6)
+        return UINT32_MAX;
+    uint32_t max_start = g->valid_samples - span - 4;
+
+    uint32_t start = 1;
+    if (take->num_slices > 0)
+        start = take->slice_positions[(uint32_t) (slice_pos * (take->num_slices - 1))];
+
+    // jitter in [-GRANULAR_JITTER_FRAMES, GRANULAR_JITTER_FRAMES], scaled with a multiply instead of a modulo
+    int32_t jitter = (int32_t) (((uint64_t) xorshift32(&g->rng) * (2 * GRANULAR_JITTER_FRAMES + 1)) >> 32) - GRANULAR_JITTER_FRAMES;
+    int32_t pos = (int32_t) start + jitter;
+
+    if (pos < 1)
+        pos = 1;
+    if ((uint32_t) pos > max_start)
+        pos = (int32_t) max_start;
+    return (uint32_t) pos;
+}
+
+void granular_schedule(granular_t* g, const tape_buffer_t* take, const granular_params_t* params, uint32_t pitch_inc_q16,
+                       uint32_t num_frames, bool gate) {
+    // the released take is let go once its last grain is done, the next block picks up the current one
+    if (g->releasing && !g->active)
+        granular_stop(g);
+
+    if (!g->releasing && !tape_store_is_valid(&g->reader.store) && take->mem) {
+        tape_reader_attach(&g->reader, &take->store);
+        g->valid_samples = take->valid_samples;
+        g->decimation = take->decimation > 0 ? take->decimation : 1;
+    }
+
+    if (!gate || params->density <= 0.0f || g->releasing || !tape_store_is_valid(&g->reader.store)) {
+        // the first grain of the next gate starts right away
+        g->frames_to_next = 0;
+        return;
+    }
+
+    uint32_t size_frames = (uint32_t) (params->size_ms * (AUDIO_SAMPLE_RATE / 1000.0f));
+    if (size_frames < GRAIN_WINDOW_LEN)
+        size_frames = GRAIN_WINDOW_LEN; // at most one window entry per frame
+    uint32_t step = GRANULAR_WINDOW_END / size_frames;
+    uint32_t span = (uint32_t) (((uint64_t) size_frames * (pitch_inc_q16 / g->decimation)) >> 16) + 1;
+
+    uint32_t interval = (uint32_t) (AUDIO_SAMPLE_RATE / params->density);
+    if (interval < 1)
+        interval = 1;
+
+    // uncorrelated grains add up in power, scale by 1/sqrt of the expected overlap
+    float overlap = params->density * params->size_ms * 0.001f;
+    if (overlap > CONFIG_GRANULAR_MAX_GRAINS)
+        overlap = CONFIG_GRANULAR_MAX_GRAINS;
+    g->gain_q15 = overlap > 1.0f ? (int32_t) (32767.0f / sqrtf(overlap)) : INT16_MAX;
+
+    while (g->frames_to_next < num_frames) {
+        uint32_t free_slots = ~g->active;
+#if CONFIG_GRANULAR_MAX_GRAINS < 32
+        free_slots &= (1u << CONFIG_GRANULAR_MAX_GRAINS) - 1;
+#endif
+        uint32_t start = granular_start_pos(g, take, params->slice_pos, span);
+
+        // pool exhausted or take too short: the grain is dropped, the schedule keeps its pace
+        if (free_slots && start != UINT32_MAX) {
+            uint32_t i = __CLZ(__RBIT(free_slots));
+            g->pos_q48_16[i] = (uint64_t) start << 16;
+            g->win_acc_q16[i] = 0;
+            g->win_step_q16[i] = step;
+            g->delay[i] = (uint8_t) g->frames_to_next;
+            g->active |= 1u << i;
+        }
+        g->frames_to_next += interval;
+    }
+    g->frames_to_next -= num_frames;
+}
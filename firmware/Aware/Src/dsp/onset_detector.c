@@ -0,0 +1,53 @@
+/**
+ * @file onset_detector.c
+ * @brief Energy onset detector: reports an onset when the mean square of a window rises well above its slow average.
+ */
+#include "dsp/onset_detector.h"
+
+#include <string.h>
+
+#include "arm_math.h"
+
+// windows per ms
+#define ONSET_WINDOWS_PER_MS ((float) AUDIO_SAMPLE_RATE / (1000.0f * ONSET_WINDOW_FRAMES))
+
+void onset_detector_init(onset_detector_t* det) {
+    memset(det, 0, sizeof(*det));
+}
+
+bool onset_detector_process(onset_detector_t* det, const int16_t* in, uint32_t num_frames, uint32_t* late_frames) {
+    uint32_t t0 = cycle_stats_begin();
+
+    // sum of squares of both channels, one dual MAC per stereo frame
+    const uint32_t* frames = (const uint32_t*) in;
+    bool onset = false;
+    uint32_t i = 0;
+    while (i < num_frames) {
+        uint32_t n = min_u32(ONSET_WINDOW_FRAMES - det->window_pos, num_frames - i);
+        uint64_t acc = det->window_acc;
+        for (uint32_t end = i + n; i < end; i++)
+            acc = __SMLALD(frames[i], frames[i], acc);
+        det->window_pos += n;
+        if (det->window_pos < ONSET_WINDOW_FRAMES) {
+            det->window_acc = acc;
+            break;
+        }
+
+        float energy = (float) acc / (float) (2 * ONSET_WINDOW_FRAMES);
+        det->window_acc = 0;
+        det->window_pos = 0;
+
+        if (det->refractory > 0) {
+            det->refractory--;
+        } else if (energy > ONSET_ENERGY_FLOOR && energy > ONSET_RISE_RATIO * det->slow_energy) {
+            // the window started ONSET_WINDOW_FRAMES before frame i, possibly in an earlier block
+            onset = true;
+            *late_frames = num_frames - i + ONSET_WINDOW_FRAMES;
+            det->refractory = (uint32_t) (ONSET_REFRACTORY_MS * ONSET_WINDOWS_PER_MS);
+        }
+        det->slow_energy += ONSET_SLOW_ALPHA * (energy - det->slow_energy);
+    }
+
+    cycle_stats_end(&det->detect_cycles, t0);
+    return onset;
+}
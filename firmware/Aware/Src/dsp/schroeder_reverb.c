@@ -59,6 +59,11 @@ static float r_a2[MAX_AP_LEN];
 
 #define SR_MAX_FEEDBACK 0.999f /* upper clamp: keeps all-pole filters stable */
 
+// parameter ramps: the mix moves linearly, the room glides like a tape delay. Even the widest jump in size moves a
+// delay length by less than one sample per frame, instead of hundreds at once.
+#define SR_WET_RAMP_MS 20.0f
+#define SR_SIZE_GLIDE_MS 60.0f
+
 /* ---- Processing ---- */
 
 /** @brief Lowpass-comb filter: feedback with one-pole LP damping. */
@@ -96,6 +101,19 @@ static float allpass_process(sr_delay_t* d, float in) {
     return y;
 }
 
+// Active delay lengths for a room size, the base lengths are the room at size 1.0.
+static void set_lengths(schroeder_stereo_t* rev, float size) {
+    for (int i = 0; i < 4; i++) {
+        rev->left.combs[i].length = (uint16_t) (comb_base[0][i] * size);
+        rev->right.combs[i].length = (uint16_t) (comb_base[1][i] * size);
+    }
+
+    for (int i = 0; i < 2; i++) {
+        rev->left.allpasses[i].length = (uint16_t) (allpass_base[0][i] * size);
+        rev->right.allpasses[i].length = (uint16_t) (allpass_base[1][i] * size);
+    }
+}
+
 void schroeder_rev_init(schroeder_stereo_t* rev) {
     memset(l_c1, 0, sizeof(l_c1));
     memset(l_c2, 0, sizeof(l_c2));
@@ -134,6 +152,11 @@ void schroeder_rev_init(schroeder_stereo_t* rev) {
 
     rev->wet = 0.3f;
     rev->dry = 0.7f;
+    rev->size = 1.0f;
+    set_lengths(rev, rev->size);
+
+    smoother_init(&rev->wet_smooth, SMOOTHER_LINEAR, rev->wet, SR_WET_RAMP_MS, AUDIO_SAMPLE_RATE, 0.0f);
+    smoother_init(&rev->size_smooth, SMOOTHER_ONE_POLE, rev->size, SR_SIZE_GLIDE_MS, AUDIO_SAMPLE_RATE, 5e-4f);
 }
 
 /** @brief Run one sample through the parallel combs then series allpasses. */
@@ -161,6 +184,42 @@ void schroeder_rev_process(schroeder_stereo_t* rev, float in_l, float in_r, floa
     *out_r = rev->dry * in_r + rev->wet * wet_r;
 }
 
+void schroeder_rev_process_block(schroeder_stereo_t* rev, const int16_t* in, int16_t* out, uint32_t num_frames) {
+    // the ramps of a long block in passes, so that their buffers stay small
+    while (num_frames > SR_CHUNK_FRAMES) {
+        schroeder_rev_process_block(rev, in, out, SR_CHUNK_FRAMES);
+        in += 2 * SR_CHUNK_FRAMES;
+        out += 2 * SR_CHUNK_FRAMES;
+        num_frames -= SR_CHUNK_FRAMES;
+    }
+
+    float wet[SR_CHUNK_FRAMES];
+    float size[SR_CHUNK_FRAMES];
+    bool wet_ramp = smoother_process_block(&rev->wet_smooth, wet, num_frames);
+    bool size_ramp = smoother_process_block(&rev->size_smooth, size, num_frames);
+
+    // +1 because int16 range is asymmetric [-32768, 32767]: dividing by 32768 maps
+    // -32768 -> -1.0 exactly; dividing by INT16_MAX would push -32768 to -1.000030.
+    for (uint32_t i = 0; i < num_frames; i++) {
+        if (wet_ramp) {
+            rev->wet = wet[i];
+            rev->dry = 1.f - wet[i];
+        }
+        if (size_ramp)
+            set_lengths(rev, size[i]);
+
+        float in_l = (float) in[2 * i] / (INT16_MAX + 1);
+        float in_r = (float) in[2 * i + 1] / (INT16_MAX + 1);
+
+        float out_l, out_r;
+        schroeder_rev_process(rev, in_l, in_r, &out_l, &out_r);
+
+        /* back to int16 */
+        out[2 * i] = __SSAT((int32_t) (out_l * (INT16_MAX + 1)), 16);
+        out[2 * i + 1] = __SSAT((int32_t) (out_r * (INT16_MAX + 1)), 16);
+    }
+}
+
 /* ----- PUBLIC API ----- */
 
 void schroeder_rev_set_feedback(schroeder_stereo_t* rev, float feedback) {
@@ -191,8 +250,7 @@ void schroeder_rev_set_wet(schroeder_stereo_t* rev, float wet) {
     if (wet > 1.f)
         wet = 1.f;
 
-    rev->wet = wet;
-    rev->dry = 1.f - wet;
+    smoother_set_target(&rev->wet_smooth, wet);
 }
 
 // size = 1.0 -> maximum RT60 / room size based on base delay lengths
@@ -205,16 +263,8 @@ void schroeder_rev_set_size(schroeder_stereo_t* rev, float size) {
 
     rev->size = size; // Store the clamped size
 
-    // Use size directly as the scaling factor
-    for (int i = 0; i < 4; i++) {
-        rev->left.combs[i].length = (uint16_t) (comb_base[0][i] * size);
-        rev->right.combs[i].length = (uint16_t) (comb_base[1][i] * size);
-    }
-
-    for (int i = 0; i < 2; i++) {
-        rev->left.allpasses[i].length = (uint16_t) (allpass_base[0][i] * size);
-        rev->right.allpasses[i].length = (uint16_t) (allpass_base[1][i] * size);
-    }
+    // the lengths follow per frame in schroeder_rev_process_block()
+    smoother_set_target(&rev->size_smooth, size);
 }
 
 void schroeder_rev_set_lp_alpha(schroeder_stereo_t* rev, float alpha) {
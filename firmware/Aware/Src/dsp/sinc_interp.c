@@ -0,0 +1,56 @@
+/**
+ * @file sinc_interp.c
+ * @brief Coefficient table of the polyphase windowed-sinc interpolator.
+ */
+#include "dsp/sinc_interp.h"
+
+#ifdef CONFIG_TAPE_SINC_TAPS
+#include <math.h>
+
+int16_t sinc_table_q15[(SINC_PHASES + 1) * CONFIG_TAPE_SINC_TAPS];
+
+// Modified Bessel function of the first kind, order 0, for the Kaiser window. The series converges within a few dozen terms for beta <= 10.
+static float bessel_i0(float x) {
+    float sum = 1.0f;
+    float term = 1.0f;
+    for (uint32_t k = 1; k < 32; k++) {
+        float h = x / (2.0f * (float) k);
+        term *= h * h;
+        sum += term;
+    }
+    return sum;
+}
+
+void sinc_interp_init(void) {
+    const float half = (float) (CONFIG_TAPE_SINC_TAPS / 2);
+    const float norm = 1.0f / bessel_i0(SINC_BETA);
+
+    for (uint32_t p = 0; p <= SINC_PHASES; p++) {
+        float t = (float) p / (float) SINC_PHASES;
+        float w[CONFIG_TAPE_SINC_TAPS];
+        float sum = 0.0f;
+
+        for (uint32_t i = 0; i < CONFIG_TAPE_SINC_TAPS; i++) {
+            float x = (float) i - (half - 1.0f) - t; // distance of tap i from the playhead
+            float r = x / half;
+            float window = r * r < 1.0f ? bessel_i0(SINC_BETA * sqrtf(1.0f - r * r)) * norm : 0.0f;
+            float arg = (float) M_PI * SINC_CUTOFF * x;
+            float sinc = fabsf(arg) < 1e-6f ? 1.0f : sinf(arg) / arg;
+            w[i] = SINC_CUTOFF * sinc * window;
+            sum += w[i];
+        }
+
+        // unity gain at DC for every phase, the rounding error goes to the largest weight
+        int16_t* row = &sinc_table_q15[p * CONFIG_TAPE_SINC_TAPS];
+        int32_t total = 0;
+        uint32_t peak = 0;
+        for (uint32_t i = 0; i < CONFIG_TAPE_SINC_TAPS; i++) {
+            row[i] = (int16_t) lrintf(w[i] / sum * 32768.0f);
+            total += row[i];
+            if (row[i] > row[peak])
+                peak = i;
+        }
+        row[peak] = (int16_t) (row[peak] + 32768 - total);
+    }
+}
+#endif
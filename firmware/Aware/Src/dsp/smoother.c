@@ -0,0 +1,78 @@
+/**
+ * @file smoother.c
+ * @brief Linear and one-pole parameter ramps, per tick or a block at a time.
+ */
+#include "dsp/smoother.h"
+
+void smoother_init(smoother_t* s, smoother_mode_t mode, float value, float time_ms, float tick_hz, float epsilon) {
+    float ticks = time_ms * 0.001f * tick_hz;
+    if (ticks < 1.0f)
+        ticks = 1.0f;
+
+    s->mode = mode;
+    s->ramp_ticks = (uint32_t) ticks;
+    s->coeff = 1.0f - expf(-1.0f / ticks);
+    s->epsilon = epsilon;
+    smoother_reset(s, value);
+}
+
+void smoother_set_target(smoother_t* s, float target) {
+    if (target == s->target)
+        return;
+
+    s->target = target;
+    s->ramping = true;
+    if (s->mode == SMOOTHER_LINEAR) {
+        s->step = (target - s->value) / (float) s->ramp_ticks;
+        s->remaining = s->ramp_ticks;
+    }
+}
+
+void smoother_reset(smoother_t* s, float value) {
+    s->value = value;
+    s->target = value;
+    s->step = 0.0f;
+    s->remaining = 0;
+    s->ramping = false;
+}
+
+bool smoother_process_block(smoother_t* s, float* out, uint32_t num_ticks) {
+    if (!s->ramping)
+        return false;
+
+    uint32_t i = 0;
+    if (s->mode == SMOOTHER_LINEAR) {
+        // the ramp is computed from its start of the block, it does not accumulate rounding errors per tick
+        uint32_t n = s->remaining < num_ticks ? s->remaining : num_ticks;
+        float start = s->value;
+        for (; i < n; i++)
+            out[i] = start + s->step * (float) (i + 1);
+
+        s->remaining -= n;
+        if (s->remaining == 0) {
+            s->value = s->target;
+            s->ramping = false;
+        } else {
+            s->value = out[n - 1];
+        }
+    } else {
+        float v = s->value;
+        for (; i < num_ticks; i++) {
+            v += s->coeff * (s->target - v);
+            out[i] = v;
+        }
+        s->value = v;
+
+        // settled within epsilon, a step that small is inaudible
+        if (fabsf(s->target - v) <= s->epsilon) {
+            s->value = s->target;
+            s->ramping = false;
+        }
+        return true;
+    }
+
+    // the rest of the block holds the target
+    for (; i < num_ticks; i++)
+        out[i] = s->value;
+    return true;
+}
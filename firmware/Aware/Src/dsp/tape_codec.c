@@ -0,0 +1,298 @@
+/**
+ * @file tape_codec.c
+ * @brief Tape encoders (PCM16, 8-bit linear, G.711 mu-law/A-law, IMA-ADPCM) and the block decoder.
+ */
+#include "dsp/tape_codec.h"
+
+#include "arm_math.h"
+#include <string.h>
+
+#if (CONFIG_TAPE_ENCODING != TAPE_ENC_PCM16) && (CONFIG_TAPE_ENCODING != TAPE_ENC_ADPCM)
+/* ---- 8-bit encodings ---- */
+
+// code -> PCM16 for the selected encoding
+int16_t tape_decode_lut[256];
+
+#if CONFIG_TAPE_ENCODING == TAPE_ENC_MULAW
+// G.711 mu-law, after the Sun reference implementation. 14-bit magnitude, 8 segments.
+static uint8_t encode8(int16_t pcm) {
+    int32_t v = pcm >> 2;
+    uint8_t mask = 0xFF;
+    if (v < 0) {
+        v = -v;
+        mask = 0x7F;
+    }
+    if (v > 8159)
+        v = 8159;
+    v += 33; // bias
+
+    // segment = position of the highest set bit above the 6-bit mantissa range
+    uint32_t seg = 32 - __CLZ((uint32_t) v >> 6);
+    if (seg >= 8)
+        return 0x7F ^ mask;
+    return (uint8_t) (((seg << 4) | ((v >> (seg + 1)) & 0xF)) ^ mask);
+}
+
+static int16_t decode8(uint8_t code) {
+    code = ~code;
+    int32_t t = (((code & 0x0F) << 3) + 0x84) << ((code & 0x70) >> 4);
+    return (int16_t) ((code & 0x80) ? (0x84 - t) : (t - 0x84));
+}
+#elif CONFIG_TAPE_ENCODING == TAPE_ENC_ALAW
+// G.711 A-law, after the Sun reference implementation. 13-bit magnitude, 8 segments.
+static uint8_t encode8(int16_t pcm) {
+    int32_t v = pcm >> 3;
+    uint8_t mask = 0xD5;
+    if (v < 0) {
+        v = -v - 1;
+        mask = 0x55;
+    }
+
+    uint32_t seg = 32 - __CLZ((uint32_t) v >> 5);
+    if (seg >= 8)
+        return 0x7F ^ mask;
+    uint32_t aval = seg << 4;
+    aval |= (v >> (seg < 2 ? 1 : seg)) & 0xF;
+    return (uint8_t) (aval ^ mask);
+}
+
+static int16_t decode8(uint8_t code) {
+    code ^= 0x55;
+    int32_t t = (code & 0x0F) << 4;
+    uint32_t seg = (code & 0x70) >> 4;
+    if (seg == 0)
+        t += 8;
+    else
+        t = (t + 0x108) << (seg - 1);
+    return (int16_t) ((code & 0x80) ? t : -t);
+}
+#else
+// 8-bit linear, rounded
+static uint8_t encode8(int16_t pcm) {
+    return (uint8_t) __SSAT((pcm + 0x80) >> 8, 8);
+}
+
+static int16_t decode8(uint8_t code) {
+    return (int16_t) ((int8_t) code * 256);
+}
+#endif
+#endif
+
+#if CONFIG_TAPE_ENCODING == TAPE_ENC_ADPCM
+/* ---- IMA-ADPCM ---- */
+
+static const int8_t adpcm_index_table[16] = {-1, -1, -1, -1, 2, 4, 6, 8, -1, -1, -1, -1, 2, 4, 6, 8};
+
+static const int16_t adpcm_step_table[89] = {
+    7,     8,     9,     10,    11,    12,    13,    14,    16,    17,    19,    21,    23,    25,    28,    31,    34,    37,
+    41,    45,    50,    55,    60,    66,    73,    80,    88,    97,    107,   118,   130,   143,   157,   173,   190,   209,
+    230,   253,   279,   307,   337,   371,   408,   449,   494,   544,   598,   658,   724,   796,   876,   963,   1060,  1166,
+    1282,  1411,  1552,  1707,  1878,  2066,  2272,  2499,  2749,  3024,  3327,  3660,  4026,  4428,  4871,  5358,  5894,  6484,
+    7132,  7845,  8630,  9493,  10442, 11487, 12635, 13899, 15289, 16818, 18500, 20350, 22385, 24623, 27086, 29794, 32767,
+};
+
+// Apply one 4-bit code to the channel state. Shared by encoder and decoder, so both track the same predictor.
+static inline int16_t adpcm_step(int16_t* predictor, uint8_t* step_idx, uint8_t nibble) {
+    int32_t step = adpcm_step_table[*step_idx];
+
+    int32_t diff = step >> 3;
+    if (nibble & 4)
+        diff += step;
+    if (nibble & 2)
+        diff += step >> 1;
+    if (nibble & 1)
+        diff += step >> 2;
+
+    int32_t pred = (nibble & 8) ? *predictor - diff : *predictor + diff;
+    *predictor = (int16_t) __SSAT(pred, 16);
+
+    int32_t idx = *step_idx + adpcm_index_table[nibble];
+    *step_idx = (uint8_t) (idx < 0 ? 0 : (idx > 88 ? 88 : idx));
+
+    return *predictor;
+}
+
+static inline uint8_t adpcm_encode(int16_t* predictor, uint8_t* step_idx, int16_t sample) {
+    int32_t step = adpcm_step_table[*step_idx];
+    int32_t diff = sample - *predictor;
+
+    uint8_t nibble = 0;
+    if (diff < 0) {
+        nibble = 8;
+        diff = -diff;
+    }
+    if (diff >= step) {
+        nibble |= 4;
+        diff -= step;
+    }
+    step >>= 1;
+    if (diff >= step) {
+        nibble |= 2;
+        diff -= step;
+    }
+    step >>= 1;
+    if (diff >= step)
+        nibble |= 1;
+
+    adpcm_step(predictor, step_idx, nibble);
+    return nibble;
+}
+
+void tape_adpcm_decode_block(const tape_store_t* store, uint32_t block, tape_adpcm_slot_t* slot) {
+    const tape_adpcm_header_t* hdr = &store->headers[block];
+    const uint8_t* codes = &store->frames[block << TAPE_ADPCM_BLOCK_SHIFT];
+
+    int16_t pred_l = hdr->predictor[0], pred_r = hdr->predictor[1];
+    // a corrupt header must not index past the step table
+    uint8_t idx_l = hdr->step_idx[0] > 88 ? 88 : hdr->step_idx[0];
+    uint8_t idx_r = hdr->step_idx[1] > 88 ? 88 : hdr->step_idx[1];
+
+    for (uint32_t i = 0; i < TAPE_ADPCM_BLOCK_LEN; i++) {
+        uint16_t l = (uint16_t) adpcm_step(&pred_l, &idx_l, codes[i] & 0x0F);
+        uint16_t r = (uint16_t) adpcm_step(&pred_r, &idx_r, codes[i] >> 4);
+        slot->frames[i] = l | ((uint32_t) r << 16);
+    }
+    slot->block = block;
+}
+#endif
+
+void tape_codec_init(void) {
+#if (CONFIG_TAPE_ENCODING != TAPE_ENC_PCM16) && (CONFIG_TAPE_ENCODING != TAPE_ENC_ADPCM)
+    for (uint32_t i = 0; i < 256; i++)
+        tape_decode_lut[i] = decode8((uint8_t) i);
+#endif
+}
+
+void tape_encoder_reset(tape_encoder_t* enc) {
+    memset(enc, 0, sizeof(*enc));
+}
+
+// Encode n frames into the stored frames head.. of store, which do not wrap.
+static void codec_write_run(const tape_store_t* store, tape_encoder_t* enc, uint32_t head, const int16_t* frames, uint32_t n) {
+#if CONFIG_TAPE_ENCODING == TAPE_ENC_PCM16
+    (void) enc;
+#ifdef CONFIG_TAPE_BUFFER_INTERLEAVED
+    // input is already LR-interleaved
+    memcpy(&((uint32_t*) store->ch[0])[head], frames, n * sizeof(uint32_t));
+#else
+    // deinterleave into tape buffer
+    for (uint32_t i = 0; i < n; i++) {
+        store->ch[0][head + i] = frames[2 * i];
+        store->ch[1][head + i] = frames[2 * i + 1];
+    }
+#endif
+#elif CONFIG_TAPE_ENCODING == TAPE_ENC_ADPCM
+    for (uint32_t i = 0; i < n; i++) {
+        uint32_t pos = head + i;
+        if ((pos & (TAPE_ADPCM_BLOCK_LEN - 1)) == 0) {
+            // block start: save the encoder state, so the block can be decoded without its predecessors
+            tape_adpcm_header_t* hdr = &store->headers[pos >> TAPE_ADPCM_BLOCK_SHIFT];
+            hdr->predictor[0] = enc->predictor[0];
+            hdr->predictor[1] = enc->predictor[1];
+            hdr->step_idx[0] = enc->step_idx[0];
+            hdr->step_idx[1] = enc->step_idx[1];
+        }
+
+        uint8_t l = adpcm_encode(&enc->predictor[0], &enc->step_idx[0], frames[2 * i]);
+        uint8_t r = adpcm_encode(&enc->predictor[1], &enc->step_idx[1], frames[2 * i + 1]);
+        store->frames[pos] = (uint8_t) (l | (r << 4));
+    }
+#else
+    (void) enc;
+    for (uint32_t i = 0; i < n; i++)
+        store->frames[head + i] = (uint16_t) (encode8(frames[2 * i]) | (encode8(frames[2 * i + 1]) << 8));
+#endif
+}
+
+void tape_codec_write(const tape_store_t* store, tape_encoder_t* enc, uint32_t head, const int16_t* frames, uint32_t n) {
+    uint32_t pos = tape_store_phys(store, head);
+#ifdef CONFIG_TAPE_PREROLL
+    // a wrapped take is written in two runs, up to the end of the store and on from its start
+    if (pos + n > store->ring) {
+        uint32_t first = store->ring - pos;
+        codec_write_run(store, enc, pos, frames, first);
+        frames += 2 * first;
+        n -= first;
+        pos = 0;
+    }
+#endif
+    codec_write_run(store, enc, pos, frames, n);
+}
+
+#if CONFIG_TAPE_ENCODING == TAPE_ENC_ADPCM
+// header array in front of the frames, padded so that the frames stay word aligned
+static inline uint32_t adpcm_header_bytes(uint32_t blocks) {
+    return (blocks * sizeof(tape_adpcm_header_t) + 3) & ~3u;
+}
+#endif
+
+uint32_t tape_store_frames_for_bytes(uint32_t bytes) {
+#if CONFIG_TAPE_ENCODING == TAPE_ENC_PCM16
+    return bytes / (2 * sizeof(int16_t));
+#elif CONFIG_TAPE_ENCODING == TAPE_ENC_ADPCM
+    // whole blocks only, each costs its frames plus a header (and at most 3 padding bytes overall)
+    if (bytes < 3)
+        return 0;
+    return ((bytes - 3) / (TAPE_ADPCM_BLOCK_LEN + sizeof(tape_adpcm_header_t))) << TAPE_ADPCM_BLOCK_SHIFT;
+#else
+    return bytes / sizeof(uint16_t);
+#endif
+}
+
+void tape_store_assign(tape_store_t* store, void* mem, uint32_t frames) {
+    memset(store, 0, sizeof(*store));
+    if (!mem)
+        return;
+#ifdef CONFIG_TAPE_PREROLL
+    store->ring = frames;
+#endif
+
+#if CONFIG_TAPE_ENCODING == TAPE_ENC_PCM16
+#ifdef CONFIG_TAPE_BUFFER_INTERLEAVED
+    store->ch[0] = (int16_t*) mem;
+    store->ch[1] = (int16_t*) mem + 1;
+#else
+    // R channel array follows the L array
+    store->ch[0] = (int16_t*) mem;
+    store->ch[1] = (int16_t*) mem + frames;
+#endif
+#elif CONFIG_TAPE_ENCODING == TAPE_ENC_ADPCM
+    store->headers = (tape_adpcm_header_t*) mem;
+    store->frames = (uint8_t*) mem + adpcm_header_bytes(TAPE_ADPCM_NUM_BLOCKS(frames));
+#else
+    (void) frames;
+    store->frames = (uint16_t*) mem;
+#endif
+}
+
+uint32_t tape_store_bytes_needed(uint32_t frames, uint32_t valid) {
+    uint32_t keep = valid + TAPE_STORE_GUARD_FRAMES;
+    if (keep > frames)
+        keep = frames;
+
+#if CONFIG_TAPE_ENCODING == TAPE_ENC_PCM16
+#ifdef CONFIG_TAPE_BUFFER_INTERLEAVED
+    return keep * 2 * sizeof(int16_t);
+#else
+    // the R array starts behind the full L array, only its tail can be given back
+    return (frames + keep) * sizeof(int16_t);
+#endif
+#elif CONFIG_TAPE_ENCODING == TAPE_ENC_ADPCM
+    // headers stay sized for the full take, frames are kept in whole blocks
+    return adpcm_header_bytes(TAPE_ADPCM_NUM_BLOCKS(frames)) + (TAPE_ADPCM_NUM_BLOCKS(keep) << TAPE_ADPCM_BLOCK_SHIFT);
+#else
+    return keep * sizeof(uint16_t);
+#endif
+}
+
+void tape_reader_attach(tape_reader_t* rd, const tape_store_t* store) {
+    if (store)
+        rd->store = *store;
+    else
+        memset(&rd->store, 0, sizeof(rd->store));
+
+#if CONFIG_TAPE_ENCODING == TAPE_ENC_ADPCM
+    rd->cache[0].block = UINT32_MAX;
+    rd->cache[1].block = UINT32_MAX;
+#endif
+}
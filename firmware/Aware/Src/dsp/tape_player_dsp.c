@@ -7,10 +7,15 @@
 #include <arm_math.h>
 #include <stdbool.h>
 #include <stdint.h>
+#include <string.h>
 
+#include "dsp/hermite_q14.h"
+#include "dsp/sinc_interp.h"
+#include "dsp/stretch_match.h"
 #include "envelope.h"
 #include "project_config.h"
 #include "ressources.h"
+#include "util.h"
 
 #define Q32_UNITY (4294967296.0f)
 #define Q16_UNITY (65536.0f)
@@ -18,11 +23,23 @@
 // Shared tape player state, defined and owned by tape_player.c.
 extern struct tape_player tape_player;
 
+// Scratch of the render path, sized for the longest block. In .bss (DTCM), not on the audio task stack.
+static int32_t render_mix[AUDIO_MAX_BLOCK_FRAMES * 2];   // all voices and grains of the block
+static int16_t render_voice[AUDIO_MAX_BLOCK_FRAMES * 2]; // one voice of a span
+#ifdef CONFIG_TAPE_TIME_STRETCH
+static int32_t stretch_mix[AUDIO_MAX_BLOCK_FRAMES * 2]; // the grains of one voice
+#endif
+
+// Sample idx of one PCM16 tape channel, see TAPE_CH_STRIDE.
+static inline int16_t tape_sample(const int16_t* ch, uint32_t idx) {
+    return ch[idx * TAPE_CH_STRIDE];
+}
+
 // Catmull-Rom (Hermite) cubic interpolation from a Q48.16 phase position.
 // Reads four consecutive samples around pos and evaluates a cubic Hermite polynomial,
 // giving band-limited sample-rate conversion.
 // ref: https://www.musicdsp.org/en/latest/Other/93-hermite-interpollation.html
-static inline float hermite_interpolate(uint64_t pos, int16_t* buffer, bool reverse) {
+static inline float hermite_interpolate(uint64_t pos, const int16_t* buffer, bool reverse) {
     uint32_t idx = (uint32_t) (pos >> 16);
     uint32_t frac = (uint32_t) (pos & 0xFFFF);
 
@@ -31,18 +48,18 @@ static inline float hermite_interpolate(uint64_t pos, int16_t* buffer, bool reve
     if (reverse) {
         // interpolate between idx and idx-1, t runs 1->0 as pos decreases
         t = 1.0f - (frac * (1.0f / Q16_UNITY));
-        xm1 = buffer[idx + 2];
-        x0 = buffer[idx + 1];
-        x1 = buffer[idx];
-        x2 = buffer[idx - 1];
+        xm1 = tape_sample(buffer, idx + 2);
+        x0 = tape_sample(buffer, idx + 1);
+        x1 = tape_sample(buffer, idx);
+        x2 = tape_sample(buffer, idx - 1);
     } else {
         // interpolate between idx and idx+1, t runs 0->1 as pos increases
         t = frac * (1.0f / Q16_UNITY);
         int n = (int) idx - 1;
-        xm1 = buffer[n];
-        x0 = buffer[n + 1];
-        x1 = buffer[n + 2];
-        x2 = buffer[n + 3];
+        xm1 = tape_sample(buffer, n);
+        x0 = tape_sample(buffer, n + 1);
+        x1 = tape_sample(buffer, n + 2);
+        x2 = tape_sample(buffer, n + 3);
     }
 
     // estimate derivatives by finite differences
@@ -68,21 +85,125 @@ static inline float hermite_interpolate(uint64_t pos, int16_t* buffer, bool reve
     return (((a * t - b) * t + c) * t + d);
 }
 
-// Fetch one stereo sample at pos_q48_16 using Hermite interpolation,
+#if defined(CONFIG_TAPE_PLAYER_HERMITE_Q15) && !defined(CONFIG_TAPE_BUFFER_INTERLEAVED)
+// Unaligned 32-bit load of two consecutive int16 samples: p[0] in the low, p[1] in the high halfword.
+// The M7 handles unaligned LDR natively, memcpy compiles down to a single load.
+static inline uint32_t load_q15x2(const int16_t* p) {
+    uint32_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+#endif
+
+#ifdef CONFIG_TAPE_SINC_TAPS
+// Round a sum of taps times Q15 weights to a sample and blend in the zero-order hold sample (grit).
+// Unlike the Hermite weights, the hold is blended after the dot product: two multiplies instead of one per tap.
+static inline int16_t sinc_finish(int32_t acc, int32_t hold, int32_t hold_q14) {
+    int32_t s = (acc + (1 << 14)) >> 15;
+    return (int16_t) __SSAT(s + (((hold - s) * hold_q14) >> 14), 16);
+}
+
+#ifdef CONFIG_TAPE_BUFFER_INTERLEAVED
+// Windowed-sinc interpolation frac_q16 past taps[TAPE_INTERP_HALF - 1], taps being TAPE_INTERP_TAPS LR-packed frames.
+// Like hermite_dot_q14(), pairs of frames are regrouped into L and R tap pairs with halfword packs and run through the
+// dual MAC against a pair of weights. The kernel is symmetric, reverse needs no separate path.
+static inline void sinc_interpolate(const uint32_t* taps, uint32_t frac_q16, int16_t* out_l, int16_t* out_r) {
+    int16_t w[CONFIG_TAPE_SINC_TAPS] __attribute__((aligned(4)));
+    sinc_weights_q15(frac_q16, w);
+
+    int32_t acc_l = 0, acc_r = 0;
+    for (uint32_t i = 0; i < CONFIG_TAPE_SINC_TAPS; i += 2) {
+        uint32_t w_pair;
+        memcpy(&w_pair, &w[i], sizeof(w_pair)); // w[i] | w[i + 1] << 16
+        acc_l = (int32_t) __SMLAD(__PKHBT(taps[i], taps[i + 1], 16), w_pair, (uint32_t) acc_l);
+        acc_r = (int32_t) __SMLAD(__PKHTB(taps[i + 1], taps[i], 16), w_pair, (uint32_t) acc_r);
+    }
+
+    uint32_t hold = taps[TAPE_INTERP_HALF - 1];
+    *out_l = sinc_finish(acc_l, (int16_t) hold, tape_player.params.grit_hold_q14);
+    *out_r = sinc_finish(acc_r, (int16_t) (hold >> 16), tape_player.params.grit_hold_q14);
+}
+#else
+// Windowed-sinc interpolation at pos_q48_16 from the PCM16 channels, one CMSIS dot product per channel.
+// Needs idx >= TAPE_INTERP_HALF - 1.
+static inline void sinc_interpolate(const int16_t* buf_l, const int16_t* buf_r, uint64_t pos_q48_16, int16_t* out_l, int16_t* out_r) {
+    uint32_t idx = (uint32_t) (pos_q48_16 >> 16);
+    uint32_t first = idx - (TAPE_INTERP_HALF - 1);
+    q15_t w[CONFIG_TAPE_SINC_TAPS];
+    sinc_weights_q15(pos_q48_16 & 0xFFFF, w);
+
+    q63_t acc_l, acc_r; // bounded by 2^15 * sum(|w|), fits 32 bit
+    arm_dot_prod_q15(&buf_l[first], w, CONFIG_TAPE_SINC_TAPS, &acc_l);
+    arm_dot_prod_q15(&buf_r[first], w, CONFIG_TAPE_SINC_TAPS, &acc_r);
+
+    *out_l = sinc_finish((int32_t) acc_l, buf_l[idx], tape_player.params.grit_hold_q14);
+    *out_r = sinc_finish((int32_t) acc_r, buf_r[idx], tape_player.params.grit_hold_q14);
+}
+#endif
+#endif
+
+#ifdef CONFIG_TAPE_BUFFER_INTERLEAVED
+// Interpolate one stereo sample frac_q16 past taps[TAPE_INTERP_HALF - 1], taps being the LR-packed frames
+// idx - TAPE_INTERP_HALF + 1 .. idx + TAPE_INTERP_HALF, blended with a zero-order hold sample according to the current grit value.
+// High grit (heavy decimation) -> more hold -> lo-fi texture.
+static inline void tape_interpolate(const uint32_t* taps, uint32_t frac_q16, bool reverse, int16_t* out_l, int16_t* out_r) {
+#ifdef CONFIG_TAPE_SINC_TAPS
+    if (tape_player.params.interp == TAPE_INTERP_SINC) {
+        sinc_interpolate(taps, frac_q16, out_l, out_r);
+        return;
+    }
+#endif
+    // Hermite reads idx-1..idx+2, interpolation runs relative to the first of them
+    taps += TAPE_INTERP_HALF - 2;
+    const int16_t* buf_l = (const int16_t*) taps;
+    const int16_t* buf_r = buf_l + 1;
+    uint64_t pos_q48_16 = (1ULL << 16) | frac_q16;
+    uint32_t idx = 1;
+#else
+// Interpolate one stereo sample at pos_q48_16 from the PCM16 channels buf_l, buf_r,
 // blended with a zero-order hold sample according to the current grit value.
 // High grit (heavy decimation) -> more hold -> lo-fi texture.
-static inline void tape_fetch_sample(uint64_t pos_q48_16, int16_t* buf_l, int16_t* buf_r, int16_t* out_l, int16_t* out_r) {
+static inline void tape_interpolate(const int16_t* buf_l, const int16_t* buf_r, uint64_t pos_q48_16, bool reverse, int16_t* out_l, int16_t* out_r) {
     uint32_t idx = (uint32_t) (pos_q48_16 >> 16);
+#ifdef CONFIG_TAPE_SINC_TAPS
+    // the first frames of a take fall back to Hermite, their sinc taps would reach in front of it
+    if (tape_player.params.interp == TAPE_INTERP_SINC && idx >= TAPE_INTERP_HALF - 1) {
+        sinc_interpolate(buf_l, buf_r, pos_q48_16, out_l, out_r);
+        return;
+    }
+#endif
+#endif
 
+#if defined(CONFIG_TAPE_PLAYER_ENABLE_HERMITE) && defined(CONFIG_TAPE_PLAYER_HERMITE_Q15)
+    // --- Fixed-point Hermite + hold blend, weights shared by L and R ---
+    // reverse playback interpolates with t' = 1 - t over the mirrored taps, which gives the same weights
+    (void) reverse;
+    uint32_t w_lo, w_hi;
+    hermite_weights_q14(pos_q48_16 & 0xFFFF, tape_player.params.grit_hold_q14, &w_lo, &w_hi);
+
+#ifdef CONFIG_TAPE_BUFFER_INTERLEAVED
+    // one load per stereo frame, the L and R tap pairs are regrouped with halfword packs
+    (void) buf_l;
+    (void) buf_r;
+    (void) idx;
+    uint32_t f_m1 = taps[0], f_0 = taps[1], f_1 = taps[2], f_2 = taps[3];
+
+    *out_l = hermite_dot_q14(__PKHBT(f_m1, f_0, 16), __PKHBT(f_1, f_2, 16), w_lo, w_hi);
+    *out_r = hermite_dot_q14(__PKHTB(f_0, f_m1, 16), __PKHTB(f_2, f_1, 16), w_lo, w_hi);
+#else
+    *out_l = hermite_dot_q14(load_q15x2(&buf_l[idx - 1]), load_q15x2(&buf_l[idx + 1]), w_lo, w_hi);
+    *out_r = hermite_dot_q14(load_q15x2(&buf_r[idx - 1]), load_q15x2(&buf_r[idx + 1]), w_lo, w_hi);
+#endif
+#else
     // --- Hold ---
-    float hold_l = buf_l[idx];
-    float hold_r = buf_r[idx];
+    float hold_l = tape_sample(buf_l, idx);
+    float hold_r = tape_sample(buf_r, idx);
 
 #ifdef CONFIG_TAPE_PLAYER_ENABLE_HERMITE
 
     // --- Hermite ---
-    float herm_l = hermite_interpolate(pos_q48_16, buf_l, tape_player.params.reverse);
-    float herm_r = hermite_interpolate(pos_q48_16, buf_r, tape_player.params.reverse);
+    float herm_l = hermite_interpolate(pos_q48_16, buf_l, reverse);
+    float herm_r = hermite_interpolate(pos_q48_16, buf_r, reverse);
 
     float grit = tape_player_get_grit();
 
@@ -99,15 +220,42 @@ static inline void tape_fetch_sample(uint64_t pos_q48_16, int16_t* buf_l, int16_
 
     *out_l = __SSAT((int32_t) out_l_f, 16);
     *out_r = __SSAT((int32_t) out_r_f, 16);
+#endif
+}
+
+// Fetch one stereo sample at pos_q48_16 through rd.
+static inline void tape_fetch_sample(uint64_t pos_q48_16, tape_reader_t* rd, bool reverse, int16_t* out_l, int16_t* out_r) {
+#ifdef CONFIG_TAPE_BUFFER_INTERLEAVED
+    // the taps around idx as decoded LR-packed frames
+    uint32_t tap_scratch[TAPE_INTERP_TAPS];
+    uint32_t idx = (uint32_t) (pos_q48_16 >> 16);
+    const uint32_t* taps;
+    if (idx >= TAPE_INTERP_HALF - 1) {
+        taps = tape_reader_taps(rd, idx - (TAPE_INTERP_HALF - 1), tap_scratch);
+    } else {
+        // the first frames of a take: silence in front of it
+        uint32_t lead = TAPE_INTERP_HALF - 1 - idx;
+        for (uint32_t i = 0; i < TAPE_INTERP_TAPS; i++)
+            tap_scratch[i] = i < lead ? 0 : tape_reader_frame(rd, i - lead);
+        taps = tap_scratch;
+    }
+    tape_interpolate(taps, pos_q48_16 & 0xFFFF, reverse, out_l, out_r);
+#else
+    tape_interpolate(rd->store.ch[0], rd->store.ch[1], pos_q48_16, reverse, out_l, out_r);
+#endif
 }
 
-// Advance the Q48.16 playhead by one phase_inc_q16 step.
-// Forward: wraps (cyclic) or clamps + stops (one-shot) at the buffer end.
-// Reverse: wraps or clamps + stops at the buffer start (index 1, Hermite lower bound).
+// Advance the Q48.16 playhead by one phase_inc_q16 step. The loop runs from index 1 (Hermite lower bound) to loop_end,
+// the buffer end unless cyclic mode loops at a loop point.
+// Forward: wraps (cyclic) or clamps + stops (one-shot) at the loop end.
+// Reverse: wraps or clamps + stops at the buffer start.
 // Uses a subtraction loop instead of 64-bit modulo for cyclic wrap — avoids slow division on M7.
-static inline void advance_playhead_q48(uint64_t* pos_q48, uint32_t phase_inc_q16, bool reverse, bool cyclic) {
-    uint32_t valid_samples = tape_player.playback_buf->valid_samples;
-    uint64_t wrap_point = (uint64_t) valid_samples << 16;
+// Only called for the single frame at which a segment hits the buffer boundary; all other frames advance with a plain add.
+static inline void advance_playhead_q48(tape_voice_t* v, uint32_t phase_inc_q16, bool reverse, bool cyclic, uint32_t loop_end) {
+    uint64_t* pos_q48 = &v->pos_q48_16;
+    uint32_t valid_samples = v->valid_samples;
+    uint64_t wrap_point = (uint64_t) loop_end << 16;
+    uint64_t loop_len = (uint64_t) (loop_end - 1) << 16;
 
     if (reverse) {
         // pos must stay >= (1 << 16) so Hermite can always access buffer[idx-1].
@@ -115,10 +263,10 @@ static inline void advance_playhead_q48(uint64_t* pos_q48, uint32_t phase_inc_q1
         uint64_t min_pos = 1ULL << 16;
         if (*pos_q48 < (uint64_t) phase_inc_q16 + min_pos) {
             if (cyclic)
-                *pos_q48 = wrap_point + *pos_q48 - phase_inc_q16;
+                *pos_q48 = loop_len + *pos_q48 - phase_inc_q16;
             else {
                 *pos_q48 = min_pos;
-                tape_player_stop_play();
+                tape_player_stop_voice(v);
             }
         } else {
             *pos_q48 -= phase_inc_q16;
@@ -128,18 +276,12 @@ static inline void advance_playhead_q48(uint64_t* pos_q48, uint32_t phase_inc_q1
         if (*pos_q48 >= wrap_point) {
             if (cyclic) {
                 // 64bit division might be slow on M7, this is why whe use a subtraction loop for wrapping instead of mod.
-                // *pos_q48 %= wrap_point;
+                // Loop end and index 1 are the same spot of the loop, so the playhead never lands on n=0, which hermite needs as n-1 sample.
                 while (*pos_q48 >= wrap_point)
-                    *pos_q48 -= wrap_point;
-
-                // if we land on n=0 of the buffer, we force the first sample because hermite needs n-1 sample.
-                if ((*pos_q48 >> 16) == 0) {
-                    uint16_t frac = *pos_q48 & 0xFFFF; // keep fractional part
-                    *pos_q48 = (1 << 16) | frac;       // integer part = 1, fractional part unchanged
-                }
+                    *pos_q48 -= loop_len;
             } else {
                 *pos_q48 = (uint64_t) (valid_samples - 4) << 16;
-                tape_player_stop_play();
+                tape_player_stop_voice(v);
             }
         }
     }
@@ -150,8 +292,7 @@ static inline void advance_playhead_q48(uint64_t* pos_q48, uint32_t phase_inc_q1
 // Uses cross-multiplication to avoid division:
 //   (samples_left << 16) <= (fade_len_samples * active_phase_inc_q16)
 // Keeps a 4-sample Hermite guard margin at each end.
-static inline bool playhead_near_end(uint64_t pos_q48_16, uint32_t fade_len_samples, uint32_t active_phase_inc_q16) {
-    uint32_t buf_size = tape_player.playback_buf->valid_samples;
+static inline bool playhead_near_end(uint64_t pos_q48_16, uint32_t buf_size, uint32_t fade_len_samples, uint32_t active_phase_inc_q16) {
 
     // Safety margin for Hermite (n+3)
     if (buf_size < 4)
@@ -188,92 +329,308 @@ static inline bool playhead_near_end(uint64_t pos_q48_16, uint32_t fade_len_samp
     }
 }
 
-// Apply fade-in to one output sample pair via a fixed-step Q16.16 accumulator into fade_in_lut.
-// Skipped if a retrigger crossfade is active — that crossfade already handles the fade-in.
-static inline void tape_handle_fade_in(int16_t* out_l, int16_t* out_r) {
-    // --- Q16 FIXED POINT FADE IN ---
-    // dont fade when retrigger crossfade is active, since that means we are already fading in.
-    if (!tape_player.fade_in.active || tape_player.xfade_retrig.active)
-        return;
+/* ----- Segment length helpers ----- */
+// The block is rendered in segments. Each helper returns how many frames can be rendered before
+// the next event of one kind, capped at max_frames. All divisions happen at most once per segment.
+
+// Number of frames needed to cover dist_q16 at phase_inc_q16 per frame: ceil(dist / inc), capped at max_frames.
+// The cap is checked with a 64-bit multiply first, so the division itself always fits 32 bit.
+static inline uint32_t frames_for_distance(uint64_t dist_q16, uint32_t phase_inc_q16, uint32_t max_frames) {
+    if (phase_inc_q16 == 0 || dist_q16 >= (uint64_t) phase_inc_q16 * max_frames)
+        return max_frames;
+    return ((uint32_t) dist_q16 + phase_inc_q16 - 1) / phase_inc_q16;
+}
 
-    uint32_t lut_idx = tape_player.fade_in.fade_acc_q16 >> 16;
+// Frames until playhead_near_end() becomes true. Solves the near-end condition for the sample index
+// at which it flips, so the per-frame check can be replaced by one evaluation per segment.
+static inline uint32_t frames_until_near_end(uint64_t pos_q48_16, uint32_t buf_size, uint32_t fade_len_samples, uint32_t active_phase_inc_q16,
+                                             uint32_t max_frames) {
+    if (buf_size < 4)
+        return max_frames;
+
+    uint64_t lookahead = ((uint64_t) fade_len_samples * active_phase_inc_q16) >> 16; // samples covered during the fade
 
-    if (lut_idx >= FADE_LUT_LEN - 1) {
-        tape_player.fade_in.active = false;
+    if (tape_player.params.reverse) {
+        // true once idx <= 1 + lookahead, i.e. pos < (2 + lookahead) << 16
+        uint64_t trigger_pos = (2 + lookahead) << 16;
+        if (pos_q48_16 < trigger_pos)
+            return 0;
+        // first frame k with pos - k * inc < trigger_pos
+        return frames_for_distance(pos_q48_16 - trigger_pos + 1, active_phase_inc_q16, max_frames);
     } else {
-        int16_t f = fade_in_lut[lut_idx];
-        // LUT values are Q0.15 (0..32767). Multiply: int16 * Q0.15 -> Q1.15 (32-bit product).
-        // >>15 brings result back to Q0.15 range, then SSAT clamps to 16-bit signed.
-        *out_l = __SSAT(((int32_t) (*out_l) * f) >> 15, 16);
-        *out_r = __SSAT(((int32_t) (*out_r) * f) >> 15, 16);
+        // true once idx >= limit - lookahead
+        uint32_t limit = buf_size - 4;
+        uint64_t trigger_idx = lookahead >= limit ? 0 : limit - lookahead;
+        uint64_t trigger_pos = trigger_idx << 16;
+        if (pos_q48_16 >= trigger_pos)
+            return 0;
+        return frames_for_distance(trigger_pos - pos_q48_16, active_phase_inc_q16, max_frames);
+    }
+}
 
-        // fixed step, not pitch-aware, since we want a consistent fade in time regardless of pitch. If we wanted a pitch-aware fade in, we would need to calculate the step based on the current phase increment, similar to the fade out below.
-        tape_player.fade_in.fade_acc_q16 += FADE_IN_OUT_STEP_Q16;
+// Frames the main playhead can advance with a plain add/sub before advance_playhead_q48() has to
+// handle a wrap or end-of-buffer stop. 0 means the current frame is the boundary frame.
+static inline uint32_t frames_until_wrap(uint64_t pos_q48_16, uint32_t valid_samples, uint32_t active_phase_inc_q16, bool reverse, uint32_t max_frames) {
+    if (reverse) {
+        uint64_t min_pos = 1ULL << 16;
+        if (pos_q48_16 < min_pos + active_phase_inc_q16)
+            return 0;
+        if (active_phase_inc_q16 == 0)
+            return max_frames;
+        // largest k with pos - k * inc >= min_pos
+        uint64_t dist = pos_q48_16 - min_pos;
+        if (dist >= (uint64_t) active_phase_inc_q16 * max_frames)
+            return max_frames;
+        return (uint32_t) dist / active_phase_inc_q16;
+    } else {
+        uint64_t wrap_point = (uint64_t) valid_samples << 16;
+        if (pos_q48_16 + active_phase_inc_q16 >= wrap_point)
+            return 0;
+        // largest k with pos + k * inc < wrap_point
+        return frames_for_distance(wrap_point - pos_q48_16, active_phase_inc_q16, max_frames + 1) - 1;
     }
 }
 
-// Apply fade-out to one output sample pair. Skipped in cyclic mode — the loop
-// crossfade handles boundary transitions there. Stops playback when LUT is exhausted.
-static inline void tape_handle_fade_out(uint32_t active_phase_inc, int16_t* out_l, int16_t* out_r) {
-    if (!tape_player.fade_out.active || tape_player.params.cyclic_mode)
+// Frames a LUT fade can still apply before its Q16.16 accumulator reaches the last LUT entry.
+static inline uint32_t frames_until_fade_done(const crossfade_t* fade, uint32_t max_frames) {
+    uint32_t end_acc = (uint32_t) (FADE_LUT_LEN - 1) << 16;
+    if (fade->fade_acc_q16 >= end_acc)
+        return 0;
+    uint32_t n = (end_acc - fade->fade_acc_q16 + fade->step_q16 - 1) / fade->step_q16;
+    return n < max_frames ? n : max_frames;
+}
+
+// Frames a crossfade still renders, including the frame on which it finishes. A crossfade ends
+// either when its fade LUT is exhausted or when its playhead runs into the Hermite-safe bounds of buf_b.
+// Pass max_frames one larger than the frames left in the block: a result above the block remainder means
+// the crossfade keeps running into the next block.
+static inline uint32_t frames_until_xfade_done(const crossfade_t* xfade, uint32_t active_phase_inc_q16, uint32_t max_frames) {
+    uint32_t n = frames_until_fade_done(xfade, max_frames) + 1;
+
+    uint32_t n_bound;
+    if (xfade->reverse) {
+        // ends on the frame after which idx <= 1
+        uint64_t bound = 2ULL << 16;
+        n_bound = xfade->pos_q48_16 < bound ? 1 : frames_for_distance(xfade->pos_q48_16 - bound + 1, active_phase_inc_q16, max_frames);
+    } else {
+        // ends on the frame after which idx >= valid - 2, so that idx + 2 is always a valid sample
+        uint64_t bound = (uint64_t) (xfade->buf_b_valid_samples > 2 ? xfade->buf_b_valid_samples - 2 : 0) << 16;
+        n_bound = xfade->pos_q48_16 >= bound ? 1 : frames_for_distance(bound - xfade->pos_q48_16, active_phase_inc_q16, max_frames);
+    }
+
+    return n_bound < n ? n_bound : n;
+}
+
+/* ----- Segment kernels ----- */
+// Each kernel runs over one segment of n frames inside of which no event can happen,
+// so the loops carry no state checks. out is interleaved stereo.
+
+// Fetch n frames through rd, stepping the playhead by active_phase_inc per frame.
+static inline void tape_render_span(tape_reader_t* rd, int16_t* out, uint32_t n, uint64_t pos_q48_16, uint32_t active_phase_inc, bool reverse) {
+    int64_t step = reverse ? -(int64_t) active_phase_inc : (int64_t) active_phase_inc;
+
+    for (uint32_t i = 0; i < n; i++) {
+        tape_fetch_sample(pos_q48_16, rd, reverse, &out[2 * i], &out[2 * i + 1]);
+        pos_q48_16 += step;
+    }
+}
+
+#ifdef CONFIG_TAPE_MIPMAP
+// Mip levels of the take v plays, NULL if there are none to use. Only the playback take has them,
+// a voice still reading a retired take falls back to the take itself while it fades out.
+static inline const tape_mip_t* tape_voice_mip(const tape_voice_t* v) {
+    const tape_buffer_t* buf = tape_player.playback_buf;
+    if (!buf->mip.ready || buf->mip.stale || tape_store_base(&v->reader.store) != buf->mem)
+        return NULL;
+    return &buf->mip;
+}
+
+// One stereo sample of mip level k (0: the take itself, through rd) at the take position pos_q48_16.
+static inline void tape_fetch_mip_sample(uint64_t pos_q48_16, tape_reader_t* rd, const tape_mip_t* mip, uint32_t k, bool reverse, int16_t* out_l,
+                                         int16_t* out_r) {
+    if (k == 0) {
+        tape_fetch_sample(pos_q48_16, rd, reverse, out_l, out_r);
         return;
+    }
+    uint64_t pos_k = pos_q48_16 >> k;
+    tape_interpolate(mip->level[k] + (uint32_t) (pos_k >> 16) - (TAPE_INTERP_HALF - 1), pos_k & 0xFFFF, reverse, out_l, out_r);
+}
 
-    // LUT index = top 16 bits
-    uint32_t lut_idx = tape_player.fade_out.fade_acc_q16 >> 16;
+// Fetch n frames like tape_render_span(), from the two mip levels around the increment: level k steps 1 to 2 of its frames
+// per output frame, level k + 1 half that, and the two are blended by where the increment lies within the octave.
+// The output moves smoothly from level to level as the pitch sweeps, at two fetches per frame whatever the pitch.
+// Past the top level that one plays alone and aliases again.
+static inline void tape_render_span_mip(tape_reader_t* rd, const tape_mip_t* mip, int16_t* out, uint32_t n, uint64_t pos_q48_16,
+                                        uint32_t active_phase_inc, bool reverse) {
+    int64_t step = reverse ? -(int64_t) active_phase_inc : (int64_t) active_phase_inc;
+    uint32_t k = 15 - __CLZ(active_phase_inc); // floor(log2(increment)), the increment is at least one frame
+
+    if (k >= mip->ready) {
+        for (uint32_t i = 0; i < n; i++) {
+            tape_fetch_mip_sample(pos_q48_16, rd, mip, mip->ready, reverse, &out[2 * i], &out[2 * i + 1]);
+            pos_q48_16 += step;
+        }
+        return;
+    }
 
-    if (lut_idx >= FADE_LUT_LEN - 1) {
-        *out_l = 0;
-        *out_r = 0;
-        tape_player.fade_out.active = false;
-        tape_player_stop_play();
-    } else {
-        int16_t f = fade_in_lut[FADE_LUT_LEN - 1 - lut_idx];
-        *out_l = __SSAT(((int32_t) (*out_l) * f) >> 15, 16);
-        *out_r = __SSAT(((int32_t) (*out_r) * f) >> 15, 16);
+    int32_t t = (int32_t) ((active_phase_inc >> k) - (1u << 16)) >> 1; // Q15 weight of level k + 1
+    for (uint32_t i = 0; i < n; i++) {
+        int16_t l0, r0, l1, r1;
+        tape_fetch_mip_sample(pos_q48_16, rd, mip, k, reverse, &l0, &r0);
+        tape_fetch_mip_sample(pos_q48_16, rd, mip, k + 1, reverse, &l1, &r1);
+        out[2 * i] = (int16_t) (l0 + (((l1 - l0) * t) >> 15));
+        out[2 * i + 1] = (int16_t) (r0 + (((r1 - r0) * t) >> 15));
+        pos_q48_16 += step;
+    }
+}
+#endif
 
-        // advance Q16.16 position
-        tape_player.fade_out.fade_acc_q16 += FADE_IN_OUT_STEP_Q16;
+#ifdef CONFIG_TAPE_OVERDUB
+// Rewrite take frame idx as the next overdub input frame plus the attenuated old content.
+static inline void tape_overdub_frame(overdub_t* od, tape_reader_t* rd, uint32_t idx) {
+    uint32_t old = tape_reader_frame(rd, idx);
+    int32_t in_l = 0, in_r = 0;
+    if (od->in_frames > 0) {
+        in_l = od->in[2 * od->in_pos];
+        in_r = od->in[2 * od->in_pos + 1];
+        if (od->in_pos + 1 < od->in_frames)
+            od->in_pos++;
     }
+
+    int16_t frame[2];
+    frame[0] = (int16_t) __SSAT(in_l + (((int32_t) (int16_t) old * od->feedback_q15) >> 15), 16);
+    frame[1] = (int16_t) __SSAT(in_r + (((int32_t) (int16_t) (old >> 16) * od->feedback_q15) >> 15), 16);
+    tape_codec_write(&rd->store, &od->encoder, idx, frame, 1);
 }
 
-// Retrigger crossfade: buffer A (main playhead) is the new audio fading IN,
-// buffer B (xfade->buf_b) is the old audio fading OUT
-// main playhead already points to the new content.
-static inline void tape_handle_crossfade(crossfade_t* xfade, uint32_t active_phase_inc, int16_t* new_l, int16_t* new_r) {
-    int16_t old_l, old_r;
-    tape_fetch_sample(xfade->pos_q48_16, xfade->buf_b_ptr_l, xfade->buf_b_ptr_r, &old_l, &old_r);
+// tape_render_span() with the overdub fused in. Frames the playhead has passed are rewritten as soon as they are out of
+// reach of the Hermite taps (idx-1..idx+2), so every take frame is read and written within the same pass over the block.
+static inline void tape_render_span_overdub(overdub_t* od, tape_reader_t* rd, int16_t* out, uint32_t n, uint64_t pos_q48_16,
+                                            uint32_t active_phase_inc, bool reverse) {
+    int64_t step = reverse ? -(int64_t) active_phase_inc : (int64_t) active_phase_inc;
 
-    uint32_t lut_i = xfade->fade_acc_q16 >> 16;
-    if (lut_i >= FADE_LUT_LEN)
-        lut_i = FADE_LUT_LEN - 1;
+    // the playhead jumped (new note, loop wrap, direction change): start over behind it
+    uint32_t idx = (uint32_t) (pos_q48_16 >> 16);
+    if (od->write_idx == UINT32_MAX || (reverse ? od->write_idx < idx : od->write_idx > idx))
+        od->write_idx = idx;
 
-    int16_t mix_new = fade_in_lut[lut_i];
-    int16_t mix_old = INT16_MAX - mix_new;
+    for (uint32_t i = 0; i < n; i++) {
+        tape_fetch_sample(pos_q48_16, rd, reverse, &out[2 * i], &out[2 * i + 1]);
 
-    *new_l = (int16_t) ((((int32_t) (*new_l) * mix_new) + ((int32_t) old_l * mix_old)) >> 15);
-    *new_r = (int16_t) ((((int32_t) (*new_r) * mix_new) + ((int32_t) old_r * mix_old)) >> 15);
+        idx = (uint32_t) (pos_q48_16 >> 16);
+        if (reverse) {
+            while (od->write_idx > idx + 2)
+                tape_overdub_frame(od, rd, od->write_idx--);
+        } else {
+            while (od->write_idx + 1 < idx)
+                tape_overdub_frame(od, rd, od->write_idx++);
+        }
+        pos_q48_16 += step;
+    }
+}
+#endif
 
-    xfade->pos_q48_16 += active_phase_inc;
-    xfade->fade_acc_q16 += xfade->step_q16;
+// Apply n frames of fade_in_lut (fade-in) or its mirror (fade-out) via a fixed-step Q16.16 accumulator.
+// The step is not pitch-aware, so the fade time is constant regardless of pitch.
+static inline void tape_apply_fade_span(crossfade_t* fade, int16_t* out, uint32_t n, bool fade_out) {
+    uint32_t acc = fade->fade_acc_q16;
+    for (uint32_t i = 0; i < n; i++) {
+        uint32_t lut_idx = acc >> 16;
+        int16_t f = fade_out ? fade_in_lut[FADE_LUT_LEN - 1 - lut_idx] : fade_in_lut[lut_idx];
+        // LUT values are Q0.15 (0..32767). Multiply: int16 * Q0.15 -> Q1.15 (32-bit product).
+        // >>15 brings result back to Q0.15 range, then SSAT clamps to 16-bit signed.
+        out[2 * i] = __SSAT(((int32_t) out[2 * i] * f) >> 15, 16);
+        out[2 * i + 1] = __SSAT(((int32_t) out[2 * i + 1] * f) >> 15, 16);
+        acc += fade->step_q16;
+    }
+    fade->fade_acc_q16 = acc;
+}
 
-    if (lut_i >= FADE_LUT_LEN - 1 || (xfade->pos_q48_16 >> 16) >= xfade->temp_buf_valid_samples) {
-        xfade->active = false;
-        xfade->fade_acc_q16 = 0;
+// Crossfade n frames: the main playhead output in out is the new audio fading IN,
+// buffer B (xfade->buf_b) is the old audio fading OUT, played from its own playhead.
+static inline void tape_apply_crossfade_span(crossfade_t* xfade, int16_t* out, uint32_t n, uint32_t active_phase_inc) {
+    int64_t step = xfade->reverse ? -(int64_t) active_phase_inc : (int64_t) active_phase_inc;
+    uint64_t pos = xfade->pos_q48_16;
+    uint32_t acc = xfade->fade_acc_q16;
+
+    for (uint32_t i = 0; i < n; i++) {
+        int16_t old_l, old_r;
+        tape_fetch_sample(pos, &xfade->buf_b, xfade->reverse, &old_l, &old_r);
+
+        uint32_t lut_i = acc >> 16;
+        if (lut_i >= FADE_LUT_LEN)
+            lut_i = FADE_LUT_LEN - 1;
+
+        int16_t mix_new = fade_in_lut[lut_i];
+        int16_t mix_old = INT16_MAX - mix_new;
+
+        out[2 * i] = (int16_t) ((((int32_t) out[2 * i] * mix_new) + ((int32_t) old_l * mix_old)) >> 15);
+        out[2 * i + 1] = (int16_t) ((((int32_t) out[2 * i + 1] * mix_new) + ((int32_t) old_r * mix_old)) >> 15);
+
+        pos += step;
+        acc += xfade->step_q16;
     }
+
+    xfade->pos_q48_16 = pos;
+    xfade->fade_acc_q16 = acc;
 }
 
-// Convert pitch_factor to a Q16.16 phase increment, divided by the decimation factor
+// Arm the cyclic loop crossfade: the tail of the loop keeps playing from buf_b while
+// the main playhead jumps back to the loop start (the buffer end when reversed).
+static inline void tape_start_cyclic_crossfade(tape_voice_t* v, uint32_t loop_end) {
+    crossfade_t* xfade = &v->xfade_cyclic;
+
+    xfade->active = true;
+    xfade->fade_acc_q16 = 0;
+    xfade->reverse = tape_player.params.reverse;
+
+    // save current tail as outgoing (buf_b fades out)
+    tape_reader_attach(&xfade->buf_b, &v->reader.store);
+    xfade->buf_b_valid_samples = v->valid_samples;
+    xfade->pos_q48_16 = v->pos_q48_16;
+
+#ifdef CONFIG_TAPE_LOOP_SEARCH
+    if (loop_end < v->valid_samples) {
+        // a loop point sounds like the loop start, so the two playheads stay one loop apart: forward the main playhead has
+        // just wrapped and the outgoing one goes on behind the loop end, reverse the main playhead jumps in front of the loop end
+        uint64_t loop_len = (uint64_t) (loop_end - 1) << 16;
+        if (xfade->reverse)
+            v->pos_q48_16 += loop_len;
+        else
+            xfade->pos_q48_16 += loop_len;
+        return;
+    }
+#else
+    (void) loop_end;
+#endif
+
+    // jump main playhead to loop start immediately
+    if (xfade->reverse)
+        v->pos_q48_16 = ((uint64_t) (v->valid_samples - 1)) << 16;
+    else
+        v->pos_q48_16 = 1ULL << 16;
+}
+
+#ifdef CONFIG_TAPE_LOOP_SEARCH
+// A crossfade over a loop point plays the frames behind the loop end, from tail_pos on. Only start one they last for.
+static inline bool loop_tail_lasts(const tape_voice_t* v, uint64_t tail_pos_q48_16, uint32_t active_phase_inc) {
+    uint64_t end_q16 = tail_pos_q48_16 + (uint64_t) v->xfade_cyclic.len * active_phase_inc + (4ULL << 16);
+    return end_q16 < (uint64_t) v->valid_samples << 16;
+}
+#endif
+
+// Convert the gliding pitch_factor (pitch_smooth) to a Q16.16 phase increment, divided by the decimation factor of the take
 // so that playback speed is correct relative to the decimated sample rate.
-static inline uint32_t tape_compute_phase_increment() {
+static inline uint32_t tape_compute_phase_increment(uint8_t decimation) {
 #ifdef CONFIG_TAPE_PITCH_OVERRIDE
     float target_inc = CONFIG_TAPE_PITCH_OVERRIDE * 65536.0f;
 #else
-    float target_inc = tape_player.params.pitch_factor * 65536.0f;
+    float target_inc = tape_player.pitch_smooth.value * 65536.0f;
 #endif
 
     tape_player.curr_phase_inc_q16_16 = target_inc;
 
-    uint32_t dec = tape_player.playback_buf->decimation > 0 ? tape_player.playback_buf->decimation : 1;
+    uint32_t dec = decimation > 0 ? decimation : 1;
     // This result is now a Q16.16 increment
     // TODO: since decimation is always a power of 2, we could do this division via bit shift instead of actual division, which should be faster.
     // Compiler probably does NOT optimize this, since decimation is a runtime variable.
@@ -281,137 +638,798 @@ static inline uint32_t tape_compute_phase_increment() {
     return (tape_player.curr_phase_inc_q16_16 / dec);
 }
 
-// Process one stereo output frame: fetch sample, apply fade-in, trigger/process
-// fade-out (one-shot), trigger/process cyclic loop crossfade, process retrigger
-// crossfade, advance main playhead.
-static inline void tape_process_playback_frame(uint32_t active_phase_inc, int16_t* out_l, int16_t* out_r) {
-    switch (tape_player.play_state) {
-    case PLAY_STOPPED:
-        // output silence
-        break;
-    case PLAY_PLAYING: {
-        if (tape_player.pos_q48_16 < (1 << 16)) {
+#ifndef CONFIG_TAPE_TIME_STRETCH
+// Render num_frames of playback into out (interleaved stereo).
+//
+// Instead of re-evaluating every fade, crossfade and boundary condition per frame, the block is split
+// into segments. At the start of each segment all pending events are handled (fade-out / cyclic crossfade
+// triggers, finished fades, the wrap frame), then the number of frames until the next event is computed
+// once and the segment is rendered by the kernels above without any per-frame state checks.
+// Event order within a frame matches the previous per-frame renderer:
+// fetch -> fade-in -> fade-out -> cyclic crossfade -> retrigger crossfade -> advance.
+// With od set, the voice drives the overdub, see tape_render_span_overdub().
+static void tape_render_playback(tape_voice_t* v, int16_t* out, uint32_t num_frames, uint32_t active_phase_inc, overdub_t* od) {
+    uint32_t n = 0;
+    bool reverse = tape_player.params.reverse;
+    bool cyclic = tape_player.params.cyclic_mode;
+    uint32_t loop_end = v->valid_samples;
+#ifdef CONFIG_TAPE_LOOP_SEARCH
+    // cyclic mode wraps at the loop point the worker found
+    bool loop_point = cyclic && v->loop_end < v->valid_samples;
+    if (loop_point)
+        loop_end = v->loop_end;
+#endif
+#ifdef CONFIG_TAPE_MIPMAP
+    // above the original pitch the voice reads from the mip levels
+    const tape_mip_t* mip = active_phase_inc > (1u << 16) ? tape_voice_mip(v) : NULL;
+#endif
+
+    while (n < num_frames && v->play_state == PLAY_PLAYING) {
+        uint32_t remaining = num_frames - n;
+        int16_t* seg_out = &out[2 * n];
+
+        if (v->pos_q48_16 < (1 << 16)) {
             // safety check to prevent out of bounds access in tape_fetch_sample
-            *out_l = 0;
-            *out_r = 0;
-            tape_player.pos_q48_16 = 1 << 16; // move playhead to n=1 to ensure valid interpolation
-            return;
+            seg_out[0] = 0;
+            seg_out[1] = 0;
+            v->pos_q48_16 = 1 << 16; // move playhead to n=1 to ensure valid interpolation
+            n++;
+            continue;
         }
 
-        tape_fetch_sample(tape_player.pos_q48_16, tape_player.playback_buf->ch[0], tape_player.playback_buf->ch[1], out_l, out_r);
-
+        // --- events at the segment start ---
+        // the retrigger crossfade already fades the new audio in, so the plain fade-in pauses meanwhile
+        bool fade_in_on = false;
+        bool fade_out_on = false;
 #ifdef CONFIG_TAPE_PLAYER_ENABLE_FADE_IN_OUT
-        tape_handle_fade_in(out_l, out_r);
+        fade_in_on = v->fade_in.active && !v->xfade_retrig.active;
+        if (fade_in_on && frames_until_fade_done(&v->fade_in, 1) == 0) {
+            v->fade_in.active = false;
+            fade_in_on = false;
+        }
 
         // --- Q16 FIXED POINT FADE OUT TRIGGER ---
-        if (!tape_player.fade_out.active && playhead_near_end(tape_player.pos_q48_16, FADE_IN_OUT_LEN, active_phase_inc) &&
-            !tape_player.params.cyclic_mode) {
-            tape_player.fade_out.active = true;
-            tape_player.fade_out.pos_q48_16 = 0; // Reset accumulator
+        if (!v->fade_out.active && !cyclic && playhead_near_end(v->pos_q48_16, v->valid_samples, FADE_IN_OUT_LEN, active_phase_inc)) {
+            v->fade_out.active = true;
+            v->fade_out.fade_acc_q16 = 0; // Reset accumulator
+        }
+
+        // fade-out is paused in cyclic mode, the loop crossfade handles boundary transitions there. A released voice fades out anyway.
+        fade_out_on = v->fade_out.active && (!cyclic || v->releasing);
+        if (fade_out_on && frames_until_fade_done(&v->fade_out, 1) == 0) {
+            // fade-out exhausted: silence and stop
+            v->fade_out.active = false;
+            tape_player_stop_voice(v);
+            break;
         }
-        // --- Q16 FIXED POINT FADE OUT PROCESS ---
-        tape_handle_fade_out(active_phase_inc, out_l, out_r);
 #endif
 
         // --- Cyclic Loop Trigger Logic ---
-        if (!tape_player.xfade_cyclic.active && tape_player.params.cyclic_mode &&
-            playhead_near_end(tape_player.pos_q48_16, FADE_XFADE_CYCLIC_LEN, active_phase_inc)) {
-            // --- INITIALIZE CROSSFADE STATE (DO ONCE) ---
-            if (active_phase_inc < tape_player.xfade_cyclic.len << 16) {
-                tape_player.xfade_cyclic.active = true;
-                tape_player.xfade_cyclic.fade_acc_q16 = 0;
-
-                // save current tail as outgoing (buf_b fades out)
-                tape_player.xfade_cyclic.buf_b_ptr_l = &tape_player.playback_buf->ch[0][0];
-                tape_player.xfade_cyclic.buf_b_ptr_r = &tape_player.playback_buf->ch[1][0];
-                tape_player.xfade_cyclic.pos_q48_16 = tape_player.pos_q48_16;
-                // jump main playhead to loop start immediately
-                tape_player.pos_q48_16 = 1ULL << 16;
-            } else {
-                tape_player.xfade_cyclic.active = false;
+        // The crossfade only makes sense if the playhead does not skip the whole fade region in one step.
+        bool cyclic_armed = cyclic && !v->xfade_cyclic.active && active_phase_inc < v->xfade_cyclic.len << 16;
+#ifdef CONFIG_TAPE_LOOP_SEARCH
+        // over a loop point forward the crossfade starts on the wrap, see below
+        if (loop_point)
+            cyclic_armed = cyclic_armed && reverse && loop_tail_lasts(v, (uint64_t) (loop_end + 1) << 16, active_phase_inc);
+#endif
+        if (cyclic_armed && playhead_near_end(v->pos_q48_16, loop_end, v->xfade_cyclic.len, active_phase_inc)) {
+            tape_start_cyclic_crossfade(v, loop_end);
+            cyclic_armed = false;
+        }
+
+        // --- segment length: frames until the next event ---
+        uint32_t seg = remaining;
+        bool boundary = false;
+
+        uint32_t to_wrap = frames_until_wrap(v->pos_q48_16, loop_end, active_phase_inc, reverse, seg);
+        if (to_wrap == 0) {
+            // this frame's advance wraps or ends the buffer: render it alone and advance with full checks
+            seg = 1;
+            boundary = true;
+        } else {
+            seg = to_wrap;
+        }
+
+#ifdef CONFIG_TAPE_PLAYER_ENABLE_FADE_IN_OUT
+        if (!v->fade_out.active && !cyclic)
+            seg = min_u32(seg, frames_until_near_end(v->pos_q48_16, v->valid_samples, FADE_IN_OUT_LEN, active_phase_inc, seg));
+        if (fade_in_on)
+            seg = min_u32(seg, frames_until_fade_done(&v->fade_in, seg));
+        if (fade_out_on)
+            seg = min_u32(seg, frames_until_fade_done(&v->fade_out, seg));
+#endif
+        if (cyclic_armed)
+            seg = min_u32(seg, frames_until_near_end(v->pos_q48_16, loop_end, v->xfade_cyclic.len, active_phase_inc, seg));
+
+        // crossfades end on the frame they finish, so their count is only ever compared, never clamped to seg
+        uint32_t xc_frames = 0;
+        uint32_t xr_frames = 0;
+        if (v->xfade_cyclic.active) {
+            xc_frames = frames_until_xfade_done(&v->xfade_cyclic, active_phase_inc, remaining + 1);
+            seg = min_u32(seg, xc_frames);
+        }
+        if (v->xfade_retrig.active) {
+            xr_frames = frames_until_xfade_done(&v->xfade_retrig, active_phase_inc, remaining + 1);
+            seg = min_u32(seg, xr_frames);
+        }
+
+        // --- render segment ---
+#ifdef CONFIG_TAPE_OVERDUB
+        if (od)
+            tape_render_span_overdub(od, &v->reader, seg_out, seg, v->pos_q48_16, active_phase_inc, reverse);
+        else
+#endif
+#ifdef CONFIG_TAPE_MIPMAP
+        if (mip)
+            tape_render_span_mip(&v->reader, mip, seg_out, seg, v->pos_q48_16, active_phase_inc, reverse);
+        else
+#endif
+            tape_render_span(&v->reader, seg_out, seg, v->pos_q48_16, active_phase_inc, reverse);
+
+#ifdef CONFIG_TAPE_PLAYER_ENABLE_FADE_IN_OUT
+        if (fade_in_on)
+            tape_apply_fade_span(&v->fade_in, seg_out, seg, false);
+        if (fade_out_on)
+            tape_apply_fade_span(&v->fade_out, seg_out, seg, true);
+#endif
+
+        if (v->xfade_cyclic.active) {
+            tape_apply_crossfade_span(&v->xfade_cyclic, seg_out, seg, active_phase_inc);
+            if (seg == xc_frames) {
+                v->xfade_cyclic.active = false;
+                v->xfade_cyclic.fade_acc_q16 = 0;
             }
         }
 
-        // handle cyclic crossfade
-        if (tape_player.xfade_cyclic.active)
-            tape_handle_crossfade(&tape_player.xfade_cyclic, active_phase_inc, out_l, out_r);
+        if (v->xfade_retrig.active) {
+            tape_apply_crossfade_span(&v->xfade_retrig, seg_out, seg, active_phase_inc);
+            if (seg == xr_frames) {
+                v->xfade_retrig.active = false;
+                v->xfade_retrig.fade_acc_q16 = 0;
+            }
+        }
 
-        // handle retrig crossfade
-        if (tape_player.xfade_retrig.active)
-            tape_handle_crossfade(&tape_player.xfade_retrig, active_phase_inc, out_l, out_r);
+        // --- advance main playhead ---
+        if (boundary) {
+            advance_playhead_q48(v, active_phase_inc, reverse, cyclic, loop_end);
+#ifdef CONFIG_TAPE_LOOP_SEARCH
+            // forward over a loop point: the playhead has wrapped, the frames behind the loop end fade out
+            uint64_t tail_pos = v->pos_q48_16 + ((uint64_t) (loop_end - 1) << 16);
+            if (loop_point && !reverse && !v->xfade_cyclic.active && active_phase_inc < v->xfade_cyclic.len << 16 &&
+                loop_tail_lasts(v, tail_pos, active_phase_inc))
+                tape_start_cyclic_crossfade(v, loop_end);
+#endif
+        } else if (reverse) {
+            v->pos_q48_16 -= (uint64_t) active_phase_inc * seg;
+        } else {
+            v->pos_q48_16 += (uint64_t) active_phase_inc * seg;
+        }
 
-        // advance main playhead
-        advance_playhead_q48(&tape_player.pos_q48_16, active_phase_inc, tape_player.params.reverse, tape_player.params.cyclic_mode);
+        n += seg;
     }
+
+    // output silence for the rest of the block once playback stopped
+    for (; n < num_frames; n++) {
+        out[2 * n] = 0;
+        out[2 * n + 1] = 0;
     }
 }
 
-// Write one stereo frame to the record buffer, applying decimation (record every Nth frame).
-// Stops recording automatically when the buffer is full.
-static inline void tape_process_recording_frame(int16_t* in_buf, uint32_t n) {
-    if (tape_player.rec_state != REC_RECORDING)
+#endif
+
+#ifdef CONFIG_ENABLE_GRANULAR
+// Add all active grains to mix (interleaved stereo, int32). Grains run one after the other over the block,
+// each with the number of frames it can still render computed once, so the inner loop has no checks.
+static void tape_render_grains(granular_t* g, int32_t* mix, uint32_t num_frames, uint32_t phase_inc) {
+    // grains end 2 frames before the end of the take, idx + 2 is the last Hermite tap
+    uint64_t end_pos = (uint64_t) (g->valid_samples > 2 ? g->valid_samples - 2 : 0) << 16;
+    int32_t gain = g->gain_q15;
+
+    for (uint32_t bits = g->active; bits; bits &= bits - 1) {
+        uint32_t i = __CLZ(__RBIT(bits));
+        uint32_t start = g->delay[i];
+        g->delay[i] = 0;
+
+        uint64_t pos = g->pos_q48_16[i];
+        uint32_t acc = g->win_acc_q16[i];
+        uint32_t step = g->win_step_q16[i];
+
+        // frames until the window ends or the playhead runs out of take, whichever comes first
+        uint32_t n = num_frames - start;
+        uint32_t to_window_end = (GRANULAR_WINDOW_END - acc + step - 1) / step;
+        bool done = to_window_end <= n;
+        if (done)
+            n = to_window_end;
+        uint32_t to_take_end = pos < end_pos ? frames_for_distance(end_pos - pos, phase_inc, n + 1) : 0;
+        if (to_take_end <= n) {
+            n = to_take_end;
+            done = true;
+        }
+
+        int32_t* out = &mix[2 * start];
+        for (uint32_t k = 0; k < n; k++) {
+            int16_t l, r;
+            tape_fetch_sample(pos, &g->reader, false, &l, &r);
+            int32_t w = (grain_window_lut[acc >> 16] * gain) >> 15;
+            out[2 * k] += (l * w) >> 15;
+            out[2 * k + 1] += (r * w) >> 15;
+            pos += phase_inc;
+            acc += step;
+        }
+
+        g->pos_q48_16[i] = pos;
+        g->win_acc_q16[i] = acc;
+        if (done)
+            g->active &= ~(1u << i);
+    }
+}
+#endif
+
+#ifdef CONFIG_TAPE_TIME_STRETCH
+#define STRETCH_WINDOW_END ((uint32_t) GRAIN_WINDOW_LEN << 16)
+#define STRETCH_WINDOW_STEP_Q16 (STRETCH_WINDOW_END / (2 * STRETCH_HOP)) // a grain lasts two hops
+#define STRETCH_CORR_REACH (2 * (STRETCH_CORR_LEN - 1))                  // take frames a candidate compares beyond its start
+
+// Take frames a grain covers in one hop at the current pitch.
+static inline uint32_t stretch_hop_frames(uint32_t phase_inc) {
+    return (uint32_t) (((uint64_t) phase_inc * STRETCH_HOP) >> 16);
+}
+
+// Range of grain starts [lo, hi] from which a whole grain stays inside the take, false if the take is too short for the pitch.
+static inline bool stretch_start_range(uint32_t valid_samples, uint32_t phase_inc, bool reverse, uint32_t* lo, uint32_t* hi) {
+    // the grain reads from its start over two hops, idx - 1 and idx + 2 are the outermost Hermite taps
+    uint32_t span = 2 * stretch_hop_frames(phase_inc) + 1;
+    if (valid_samples < span + 4)
+        return false;
+    *lo = reverse ? 1 + span : 1;
+    *hi = reverse ? valid_samples - 3 : valid_samples - 3 - span;
+    return true;
+}
+
+static inline uint32_t clamp_u32(uint32_t x, uint32_t lo, uint32_t hi) {
+    return x < lo ? lo : (x > hi ? hi : x);
+}
+
+// Mono frame idx of the take, for the similarity search.
+static inline int32_t stretch_mono(tape_reader_t* rd, uint32_t idx) {
+    uint32_t f = tape_reader_frame(rd, idx);
+    return ((int16_t) f + (int16_t) (f >> 16)) >> 1;
+}
+
+// Move the nominal position on by one hop at the stretch speed. Cyclic mode wraps within [lo, hi], false once a one-shot take ran out.
+static bool stretch_advance(stretch_t* st, uint8_t decimation, bool reverse, bool cyclic, uint32_t lo, uint32_t hi) {
+    uint32_t dec = decimation > 0 ? decimation : 1;
+    int64_t step = (int64_t) (tape_player.params.stretch_speed * 65536.0f / dec) * STRETCH_HOP;
+    int64_t lo_q16 = (int64_t) lo << 16;
+    int64_t hi_q16 = (int64_t) hi << 16;
+    int64_t pos = (int64_t) st->analysis_q48_16 + (reverse ? -step : step);
+
+    if (pos < lo_q16 || pos > hi_q16) {
+        if (!cyclic || hi_q16 - lo_q16 < step)
+            return false;
+        pos += pos < lo_q16 ? hi_q16 - lo_q16 : lo_q16 - hi_q16;
+    }
+    st->analysis_q48_16 = (uint64_t) pos;
+    return true;
+}
+
+// Set up the search for the start of the next grain: candidates within STRETCH_SEARCH_RADIUS of the nominal position, each
+// scored by its normalized correlation with the take at ref_pos, where the newest grain will be when the next one fades in.
+static void stretch_search_begin(stretch_t* st, tape_reader_t* rd, uint32_t valid_samples, uint32_t ref_pos, bool reverse, uint32_t lo,
+                                 uint32_t hi) {
+    uint32_t nominal = clamp_u32((uint32_t) (st->analysis_q48_16 >> 16), lo, hi);
+    st->best_pos = nominal;
+    st->best_score = -INFINITY;
+    st->cand_count = 0;
+    st->cand_next = 0;
+
+    // the compared frames run in the play direction and must stay inside the take
+    uint32_t first_ok = reverse ? 1 + STRETCH_CORR_REACH : 1;
+    uint32_t last_ok = reverse ? valid_samples - 3 : valid_samples - 3 - STRETCH_CORR_REACH;
+    if (valid_samples < STRETCH_CORR_REACH + 4 || ref_pos < first_ok || ref_pos > last_ok)
+        return;
+    lo = lo > first_ok ? lo : first_ok;
+    hi = hi < last_ok ? hi : last_ok;
+    if (lo > hi)
+        return;
+
+    uint32_t first = clamp_u32(nominal > STRETCH_SEARCH_RADIUS ? nominal - STRETCH_SEARCH_RADIUS : 0, lo, hi);
+    uint32_t last = clamp_u32(nominal + STRETCH_SEARCH_RADIUS, lo, hi);
+    st->cand_first = first;
+    st->cand_count = (last - first) / STRETCH_SEARCH_STEP + 1;
+    st->cand_reverse = reverse;
+
+    int32_t dir = reverse ? -2 : 2;
+    for (uint32_t k = 0; k < STRETCH_CORR_LEN; k++)
+        st->ref[k] = stretch_mono(rd, ref_pos + dir * (int32_t) k);
+}
+
+// Score the next candidates. The remaining ones are spread over the blocks left until the grain starts,
+// so no block scores more than about STRETCH_SEARCH_CANDIDATES / (STRETCH_HOP / block length) of them.
+static void stretch_search_step(stretch_t* st, tape_reader_t* rd, uint32_t num_frames) {
+    uint32_t left = st->cand_count - st->cand_next;
+    if (left == 0)
+        return;
+
+    // this call plus one per block before the one the grain starts in
+    uint32_t calls = st->to_next / num_frames + 1;
+    uint32_t n = (left + calls - 1) / calls;
+    int32_t dir = st->cand_reverse ? -2 : 2;
+
+    for (uint32_t c = st->cand_next; c < st->cand_next + n; c++) {
+        uint32_t pos = st->cand_first + c * STRETCH_SEARCH_STEP;
+        stretch_match_t m = {0};
+        for (uint32_t k = 0; k < STRETCH_CORR_LEN; k++)
+            stretch_match_add(&m, st->ref[k], stretch_mono(rd, pos + dir * (int32_t) k));
+        float score = stretch_match_score(&m);
+        if (score > st->best_score) {
+            st->best_score = score;
+            st->best_pos = pos;
+        }
+    }
+    st->cand_next += n;
+}
+
+// Start the grain due now and set up the search for the one after it.
+static void stretch_launch(tape_voice_t* v, uint32_t phase_inc, bool reverse, bool cyclic) {
+    stretch_t* st = &v->stretch;
+    st->to_next = STRETCH_HOP;
+    st->cand_count = 0;
+    st->cand_next = 0;
+    if (st->ending)
         return;
 
-    uint8_t rec_decimation = tape_player.record_buf->decimation > 0 ? tape_player.record_buf->decimation : 1;
-    uint32_t frame_idx = n / 2;            // index of the current stereo frame (0, 1, 2, ...)
-    if ((frame_idx % rec_decimation) != 0) // record only each Nth frame, where N = decimation factor
+    uint32_t lo, hi;
+    if (!stretch_start_range(v->valid_samples, phase_inc, reverse, &lo, &hi)) {
+        st->ending = true;
         return;
+    }
+
+    // the grain that ends now has left its slot already
+    uint32_t slot = st->grain_active & 1u ? 1 : 0;
+    uint32_t start = clamp_u32(st->best_pos, lo, hi);
+    st->grain_pos_q48_16[slot] = (uint64_t) start << 16;
+    st->grain_acc_q16[slot] = 0;
+    st->grain_active |= 1u << slot;
+    st->newest = slot;
+
+    if (!stretch_advance(st, v->decimation, reverse, cyclic, lo, hi)) {
+        st->ending = true;
+        return;
+    }
+    uint32_t hop = stretch_hop_frames(phase_inc);
+    uint32_t ref_pos = reverse ? (start > hop ? start - hop : 0) : start + hop;
+    stretch_search_begin(st, &v->reader, v->valid_samples, ref_pos, reverse, lo, hi);
+}
+
+// A new note starts on the crest of a grain at the voice playhead, the voice fades shape the attack as in plain playback.
+// The second grain starts right away as its exact continuation, so the first overlap is seamless.
+static void stretch_note_on(tape_voice_t* v, uint32_t phase_inc, bool reverse, bool cyclic) {
+    stretch_t* st = &v->stretch;
+    uint32_t start = (uint32_t) (v->pos_q48_16 >> 16);
+    uint32_t hop = stretch_hop_frames(phase_inc);
+
+    st->note_seq = v->note_seq;
+    st->grain_pos_q48_16[0] = v->pos_q48_16;
+    st->grain_acc_q16[0] = STRETCH_WINDOW_END / 2;
+    st->grain_active = 1;
+    st->newest = 0;
+    st->to_next = 0;
+    st->ending = false;
+    st->cand_count = 0;
+    st->cand_next = 0;
+    st->best_pos = reverse ? (start > hop ? start - hop : 0) : start + hop;
+    st->analysis_q48_16 = v->pos_q48_16;
+
+    uint32_t lo, hi;
+    st->ending = !stretch_start_range(v->valid_samples, phase_inc, reverse, &lo, &hi) || !stretch_advance(st, v->decimation, reverse, cyclic, lo, hi);
+}
+
+// Add n frames of the active grains to mix. A grain also ends when its playhead runs out of take,
+// which a pitch raised while it plays can make happen before its window ends.
+static void tape_render_stretch_grains(stretch_t* st, tape_reader_t* rd, int32_t* mix, uint32_t n, uint32_t phase_inc, bool reverse,
+                                       uint32_t valid_samples) {
+    int64_t step = reverse ? -(int64_t) phase_inc : (int64_t) phase_inc;
+    uint64_t end_pos = (uint64_t) (valid_samples > 2 ? valid_samples - 2 : 0) << 16;
+
+    for (uint32_t bits = st->grain_active; bits; bits &= bits - 1) {
+        uint32_t i = __CLZ(__RBIT(bits));
+        uint64_t pos = st->grain_pos_q48_16[i];
+        uint32_t acc = st->grain_acc_q16[i];
+
+        uint32_t to_take_end;
+        if (reverse) {
+            // frames while idx >= 1
+            uint64_t dist = pos - (1 << 16);
+            if (pos < (1 << 16))
+                to_take_end = 0;
+            else if (phase_inc == 0 || dist >= (uint64_t) phase_inc * n)
+                to_take_end = n;
+            else
+                to_take_end = (uint32_t) dist / phase_inc + 1;
+        } else
+            to_take_end = pos < end_pos ? frames_for_distance(end_pos - pos, phase_inc, n + 1) : 0;
+        uint32_t m = to_take_end < n ? to_take_end : n;
+
+        for (uint32_t k = 0; k < m; k++) {
+            int16_t l, r;
+            tape_fetch_sample(pos, rd, reverse, &l, &r);
+            int32_t w = grain_window_lut[acc >> 16];
+            mix[2 * k] += (l * w) >> 15;
+            mix[2 * k + 1] += (r * w) >> 15;
+            pos += step;
+            acc += STRETCH_WINDOW_STEP_Q16;
+        }
 
-    // deinterleaves input buffer into tape buffer
-    tape_player.record_buf->ch[0][tape_player.tape_recordhead] = in_buf[n];
-    tape_player.record_buf->ch[1][tape_player.tape_recordhead] = in_buf[n + 1];
-    tape_player.tape_recordhead++;
+        st->grain_pos_q48_16[i] = pos;
+        st->grain_acc_q16[i] = acc;
+        if (m < n || acc >= STRETCH_WINDOW_END)
+            st->grain_active &= ~(1u << i);
+    }
+}
+
+// Render num_frames of time stretched playback into out (interleaved stereo). Grains start every STRETCH_HOP frames, the block
+// is split at the starts. The voice fades and the retrigger crossfade apply on top as in tape_render_playback(),
+// the loop crossfade does not: cyclic mode wraps the grain positions, the search smooths the seam.
+static void tape_render_stretch(tape_voice_t* v, int16_t* out, uint32_t num_frames, uint32_t phase_inc) {
+    stretch_t* st = &v->stretch;
+    bool reverse = tape_player.params.reverse;
+    bool cyclic = tape_player.params.cyclic_mode;
+    int32_t* mix = stretch_mix;
+    memset(mix, 0, 2 * num_frames * sizeof(int32_t));
+
+    v->xfade_cyclic.active = false;
+    if (st->note_seq != v->note_seq)
+        stretch_note_on(v, phase_inc, reverse, cyclic);
+
+    uint32_t n = 0;
+    while (n < num_frames) {
+        if (st->to_next == 0)
+            stretch_launch(v, phase_inc, reverse, cyclic);
+        if (!st->grain_active)
+            break;
+
+        uint32_t seg = min_u32(num_frames - n, st->to_next);
+        tape_render_stretch_grains(st, &v->reader, &mix[2 * n], seg, phase_inc, reverse, v->valid_samples);
+        st->to_next -= seg;
+        n += seg;
+    }
+    uint32_t playing = n; // the grains ran out after this many frames
+
+    for (uint32_t i = 0; i < 2 * num_frames; i++)
+        out[i] = (int16_t) __SSAT(mix[i], 16);
+    v->pos_q48_16 = st->grain_pos_q48_16[st->newest];
+
+#ifdef CONFIG_TAPE_PLAYER_ENABLE_FADE_IN_OUT
+    if (v->fade_in.active && !v->xfade_retrig.active) {
+        uint32_t m = frames_until_fade_done(&v->fade_in, num_frames);
+        tape_apply_fade_span(&v->fade_in, out, m, false);
+        if (m < num_frames)
+            v->fade_in.active = false;
+    }
+    if (v->fade_out.active) {
+        // only a released voice fades out, the grains fade at the end of a one-shot take
+        uint32_t m = frames_until_fade_done(&v->fade_out, num_frames);
+        tape_apply_fade_span(&v->fade_out, out, m, true);
+        if (m < num_frames) {
+            v->fade_out.active = false;
+            playing = min_u32(playing, m);
+        }
+    }
+#endif
+
+    if (v->xfade_retrig.active) {
+        uint32_t xr_frames = frames_until_xfade_done(&v->xfade_retrig, phase_inc, num_frames + 1);
+        uint32_t m = min_u32(xr_frames, num_frames);
+        tape_apply_crossfade_span(&v->xfade_retrig, out, m, phase_inc);
+        if (m == xr_frames) {
+            v->xfade_retrig.active = false;
+            v->xfade_retrig.fade_acc_q16 = 0;
+        }
+    }
+
+    if (playing < num_frames) {
+        tape_player_stop_voice(v);
+        memset(&out[2 * playing], 0, 2 * (num_frames - playing) * sizeof(int16_t));
+    }
+
+    uint32_t t0 = cycle_stats_begin();
+    if (v->play_state == PLAY_PLAYING)
+        stretch_search_step(st, &v->reader, num_frames);
+    cycle_stats_end(&st->search_cycles, t0);
+    cpu_stats.stretch_search_cycles = st->search_cycles.avg;
+    if (st->search_cycles.max > cpu_stats.stretch_search_max)
+        cpu_stats.stretch_search_max = st->search_cycles.max;
+}
+#endif
+
+#ifdef CONFIG_TAPE_OVERDUB
+// Voice that drives the overdub in this block, with the input already decimated to the rate of its take.
+// NULL while overdub is off or no voice plays the current take.
+static tape_voice_t* tape_overdub_prepare(const int16_t* in_buf, uint32_t num_frames) {
+    overdub_t* od = &tape_player.overdub;
+    tape_voice_t* v = NULL;
+
+    if (od->enabled) {
+        // newest note, sequence numbers wrap, compare distances to the current one
+        for (uint32_t i = 0; i < CONFIG_TAPE_NUM_VOICES; i++) {
+            tape_voice_t* c = &tape_player.voices[i];
+            if (c->play_state != PLAY_PLAYING || c->releasing)
+                continue;
+            if (!v || tape_player.note_seq - c->note_seq < tape_player.note_seq - v->note_seq)
+                v = c;
+        }
+    }
+
+    if (!v) {
+        od->write_idx = UINT32_MAX;
+        return NULL;
+    }
+
+    if (v->note_seq != od->note_seq) {
+        od->note_seq = v->note_seq;
+        od->write_idx = UINT32_MAX;
+    }
+#ifdef CONFIG_TAPE_MIPMAP
+    // the levels keep the content from before the overdub
+    tape_player.playback_buf->mip.stale = true;
+#endif
+    if (!tape_player.playback_buf->overdubbed) {
+        tape_player.playback_buf->overdubbed = true;
+#ifdef CONFIG_TAPE_LOOP_SEARCH
+        // the loop point no longer sounds like the overdubbed loop start
+        tape_player_set_loop(tape_player.playback_buf, tape_player.playback_buf->valid_samples, FADE_XFADE_CYCLIC_LEN);
+#endif
+#ifdef CONFIG_TAPE_ANALYSIS
+        tape_player.playback_buf->analysis.stale = true;
+        tape_player_publish_analysis();
+#endif
+    }
+
+    if (v->decimation != od->decimation) {
+#ifdef CONFIG_TAPE_REC_ALIASING
+        decimator_init(&od->decimator, v->decimation, DECIMATOR_ALIASED);
+#else
+        decimator_init(&od->decimator, v->decimation, DECIMATOR_FILTERED);
+#endif
+        od->decimation = v->decimation;
+    }
+    od->in_frames = decimator_process(&od->decimator, in_buf, num_frames, od->in);
+    od->in_pos = 0;
+    od->feedback_q15 = (int32_t) (tape_player.params.overdub_feedback * 32767.0f);
+    return v;
+}
+#endif
+
+// Decimate and encode one input block and append it to the record buffer.
+// Stops recording automatically when the buffer is full.
+static inline void tape_process_recording_block(const int16_t* in_buf, uint32_t num_frames) {
+    if (!tape_player_claim_rec_take())
+        return;
+
+#ifdef CONFIG_TAPE_ONSET_SLICING
+    // the slice lands on the first frame of the detector window the onset came in, once the block is written
+    uint32_t onset_late = 0;
+    bool onset = onset_detector_process(&tape_player.onset_detector, in_buf, num_frames, &onset_late);
+    cpu_stats.onset_cycles = tape_player.onset_detector.detect_cycles.avg;
+#endif
+
+    tape_buffer_t* buf = tape_player.record_buf;
+    int16_t frames[DECIMATOR_MAX_BLOCK * 2];
+
+    // in passes of DECIMATOR_MAX_BLOCK input frames, so that the stack holds one pass of a long block
+    for (uint32_t pos = 0; pos < num_frames; pos += DECIMATOR_MAX_BLOCK) {
+        uint32_t len = min_u32(DECIMATOR_MAX_BLOCK, num_frames - pos);
+        uint32_t n = decimator_process(&tape_player.rec_decimator, &in_buf[2 * pos], len, frames);
+        uint32_t head = tape_player.tape_recordhead;
+        if (n > buf->size - head)
+            n = buf->size - head;
+
+        tape_codec_write(&buf->store, &tape_player.rec_encoder, head, frames, n);
+        tape_player.tape_recordhead = head + n;
+    }
+
+#ifdef CONFIG_TAPE_ONSET_SLICING
+    if (onset)
+        tape_player_set_slice(onset_late);
+#endif
 
     // if tape has recorded all the way, stop recording for now.
-    if (tape_player.tape_recordhead >= tape_player.record_buf->size) {
+    if (tape_player.tape_recordhead >= buf->size) {
         tape_player_stop_record();
     }
 }
 
-// Main per-block entry point. Called from the audio engine on every DMA half-transfer.
-void tape_player_process(int16_t* in_buf, int16_t* out_buf) {
-    if (!tape_player.playback_buf->ch[0] || !tape_player.playback_buf->ch[1])
+#ifdef CONFIG_TAPE_PREROLL
+// Decimate and encode one input block into the idle record buffer, round and round its store, so that a record gate
+// can keep the input that came before it. A new decimation starts the capture over.
+static inline void tape_process_capture_block(const int16_t* in_buf, uint32_t num_frames) {
+#ifndef DECIMATION_FIXED
+    if (tape_player.record_buf->decimation != tape_player.params.decimation)
+        tape_player_arm_capture();
+#endif
+    if (!tape_player_claim_rec_take())
         return;
 
-    uint32_t active_phase_inc = tape_compute_phase_increment();
+    tape_buffer_t* buf = tape_player.record_buf;
+    int16_t frames[DECIMATOR_MAX_BLOCK * 2];
 
-    // n represents the sample index within the current DMA buffer (interleaved stereo, so step by 2)
-    for (uint32_t n = 0; n < AUDIO_HALF_BLOCK_SIZE; n += 2) {
-        int16_t out_l = 0;
-        int16_t out_r = 0;
+    for (uint32_t pos = 0; pos < num_frames; pos += DECIMATOR_MAX_BLOCK) {
+        uint32_t len = min_u32(DECIMATOR_MAX_BLOCK, num_frames - pos);
+        uint32_t n = decimator_process(&tape_player.rec_decimator, &in_buf[2 * pos], len, frames);
+        uint32_t head = tape_player.tape_recordhead;
 
-        switch (tape_player.play_state) {
-        case PLAY_STOPPED:
-            // output silence, but still process recording if active
-            break;
-        case PLAY_PLAYING:
-            tape_process_playback_frame(active_phase_inc, &out_l, &out_r);
-            break;
-        }
+        // the take has not started yet, frame indices are those of the store
+        tape_codec_write(&buf->store, &tape_player.rec_encoder, head, frames, n);
+        head += n;
+        if (head >= buf->store.ring)
+            head -= buf->store.ring;
+        tape_player.tape_recordhead = head;
 
-#ifdef CONFIG_ENABLE_ENVELOPE
-        float env_val = envelope_process(&tape_player.env);
-        out_buf[n] = (int16_t) (out_l * env_val);
-        out_buf[n + 1] = (int16_t) (out_r * env_val);
+        tape_player.capture_frames += n;
+        if (tape_player.capture_frames > buf->store.ring)
+            tape_player.capture_frames = buf->store.ring;
+    }
+}
+#endif
+
+// Render num_frames of every playing voice and the grains, summed into mix.
+static void tape_render_mix(int32_t* mix, uint32_t num_frames, overdub_t* od, tape_voice_t* od_voice) {
+    int16_t* voice_out = render_voice;
+
+    for (uint32_t i = 0; i < CONFIG_TAPE_NUM_VOICES; i++) {
+        tape_voice_t* v = &tape_player.voices[i];
+
+        if (v->play_state == PLAY_PLAYING) {
+            uint32_t t0 = cycle_stats_begin();
+
+#ifdef CONFIG_TAPE_TIME_STRETCH
+            (void) od;
+            (void) od_voice;
+            tape_render_stretch(v, voice_out, num_frames, tape_compute_phase_increment(v->decimation));
 #else
-        out_buf[n] = (int16_t) (out_l);
-        out_buf[n + 1] = (int16_t) (out_r);
+            tape_render_playback(v, voice_out, num_frames, tape_compute_phase_increment(v->decimation), v == od_voice ? od : NULL);
 #endif
 
-        switch (tape_player.rec_state) {
-        case REC_IDLE:
-            // do nothing
-            break;
-        case REC_RECORDING: {
-            // record tape at current recordhead position
-            // only record every second sample. Simple decimation.
-            tape_process_recording_frame(in_buf, n);
-            break;
+#ifdef CONFIG_ENABLE_ENVELOPE
+            // n represents the sample index within the span (interleaved stereo, so step by 2)
+            for (uint32_t n = 0; n < 2 * num_frames; n += 2) {
+                float env_val = envelope_process(&v->env);
+                voice_out[n] = (int16_t) (voice_out[n] * env_val);
+                voice_out[n + 1] = (int16_t) (voice_out[n + 1] * env_val);
+            }
+#endif
+            for (uint32_t n = 0; n < 2 * num_frames; n++)
+                mix[n] += voice_out[n];
+
+            cycle_stats_end(&v->render_cycles, t0);
+            tape_player.block_voice_cycles += v->render_cycles.last;
+            tape_player.block_voice_frames += num_frames;
         }
-        case REC_REREC:
-            break;
-        case REC_DONE:
-            break;
+#ifdef CONFIG_ENABLE_ENVELOPE
+        else if (v->env.state != ENV_IDLE) {
+            // a stopped voice is silent, but its envelope keeps running, the next note-on attacks from its current value
+            for (uint32_t n = 0; n < num_frames; n++)
+                envelope_process(&v->env);
+        }
+#endif
+    }
+
+#ifdef CONFIG_ENABLE_GRANULAR
+    // grains are gated by the voices: they are scheduled while any voice plays and run out after the last one stopped
+    granular_t* g = &tape_player.granular;
+    bool gate = false;
+    for (uint32_t i = 0; i < CONFIG_TAPE_NUM_VOICES; i++)
+        gate |= tape_player.voices[i].play_state == PLAY_PLAYING && !tape_player.voices[i].releasing;
+
+    granular_schedule(g, tape_player.playback_buf, &tape_player.params.granular, tape_compute_phase_increment(1), num_frames, gate);
+    if (g->active) {
+        uint32_t t0 = cycle_stats_begin();
+        tape_render_grains(g, mix, num_frames, tape_compute_phase_increment(g->decimation));
+        cycle_stats_end(&g->render_cycles, t0);
+    }
+#endif
+}
+
+// While the pitch glides, the span is rendered in pieces of TAPE_PITCH_RAMP_FRAMES, each at the next increment of the ramp.
+// A settled pitch renders it in one piece.
+static void tape_render_mix_ramped(int32_t* mix, uint32_t num_frames, overdub_t* od, tape_voice_t* od_voice) {
+    uint32_t pos = 0;
+    while (!smoother_settled(&tape_player.pitch_smooth) && pos < num_frames) {
+        uint32_t n = min_u32(TAPE_PITCH_RAMP_FRAMES, num_frames - pos);
+        smoother_next(&tape_player.pitch_smooth);
+        tape_render_mix(&mix[2 * pos], n, od, od_voice);
+        pos += n;
+    }
+    if (pos < num_frames)
+        tape_render_mix(&mix[2 * pos], num_frames - pos, od, od_voice);
+}
+
+// Per voice cost of the block that was just rendered, scaled to a whole block for a voice that played only part of it.
+// Bucketed by the number of voices, rounded to whole blocks, so that the cost of voice k can be told from that of voice 1,
+// and by interpolator per frame. Hermite is the float or the Q14 one, as built (CONFIG_TAPE_PLAYER_HERMITE_Q15).
+static void tape_record_voice_cycles(uint32_t num_frames) {
+    uint32_t frames = tape_player.block_voice_frames;
+    if (frames > 0) {
+        uint32_t voices = (frames + num_frames / 2) / num_frames;
+        voices = voices < 1 ? 1 : min_u32(voices, CONFIG_TAPE_NUM_VOICES);
+        cycle_stats_t* s = &tape_player.voice_cycles[voices - 1];
+        cycle_stats_add(s, (uint32_t) ((uint64_t) tape_player.block_voice_cycles * num_frames / frames));
+        cpu_stats.voice_cycles[voices - 1] = s->avg;
+
+        // averaged over AUDIO_MAX_BLOCK_FRAMES, a per frame average in whole cycles would lose most of the resolution
+        s = &tape_player.interp_cycles[tape_player.params.interp];
+        cycle_stats_add(s, (uint32_t) ((uint64_t) tape_player.block_voice_cycles * AUDIO_MAX_BLOCK_FRAMES / frames));
+        if (tape_player.params.interp == TAPE_INTERP_SINC)
+            cpu_stats.sinc_frame_cycles = s->avg / AUDIO_MAX_BLOCK_FRAMES;
+        else
+            cpu_stats.hermite_frame_cycles = s->avg / AUDIO_MAX_BLOCK_FRAMES;
+    }
+    tape_player.block_voice_cycles = 0;
+    tape_player.block_voice_frames = 0;
+}
+
+// Main per-block entry point. Called by the audio task for each DSP block of a DMA period.
+// Every playing voice renders into a scratch block, gets its envelope applied and is summed into the output, the grains add on top.
+// The block is rendered in spans between the play gates, so that a note starts or stops on the frame its gate came in.
+// The render_cycles of a block split by gates are those of its spans. Record gates act once the block is recorded.
+void tape_player_process(const int16_t* in_buf, int16_t* out_buf, uint32_t num_frames, const tape_cmd_msg_t* cmds, uint32_t num_cmds) {
+    int32_t* mix = render_mix;
+    memset(mix, 0, 2 * num_frames * sizeof(int32_t));
+
+    tape_player_sync_worker();
+
+    overdub_t* od = NULL;
+    tape_voice_t* od_voice = NULL;
+#ifdef CONFIG_TAPE_OVERDUB
+    od_voice = tape_overdub_prepare(in_buf, num_frames);
+    od = &tape_player.overdub;
+#endif
+
+    uint32_t pos = 0;
+    for (uint32_t c = 0; c < num_cmds; c++) {
+        if (cmds[c].cmd != TAPE_CMD_PLAY && cmds[c].cmd != TAPE_CMD_STOP)
+            continue;
+
+        uint32_t frame = cmds[c].frame < num_frames ? cmds[c].frame : num_frames;
+        if (frame > pos) {
+            tape_render_mix_ramped(&mix[2 * pos], frame - pos, od, od_voice);
+            pos = frame;
+        }
+
+        if (cmds[c].cmd == TAPE_CMD_PLAY)
+            tape_player_play();
+        else
+            tape_player_stop_play();
+#ifdef CONFIG_TAPE_OVERDUB
+        // a retriggered voice is a new note, the overdub follows the newest one from the next block on
+        if (od_voice && od_voice->note_seq != od->note_seq)
+            od_voice = NULL;
+#endif
+    }
+    if (pos < num_frames)
+        tape_render_mix_ramped(&mix[2 * pos], num_frames - pos, od, od_voice);
+
+    for (uint32_t n = 0; n < 2 * num_frames; n++)
+        out_buf[n] = (int16_t) __SSAT(mix[n], 16);
+    tape_record_voice_cycles(num_frames);
+
+    // record tape at current recordhead position
+    if (tape_player.rec_state == REC_RECORDING)
+        tape_process_recording_block(in_buf, num_frames);
+#ifdef CONFIG_TAPE_PREROLL
+    else if (tape_player.rec_state == REC_IDLE)
+        tape_process_capture_block(in_buf, num_frames);
+#endif
+
+    // the record gates are placed by the input frames recorded since
+    for (uint32_t c = 0; c < num_cmds; c++) {
+        uint32_t late = cmds[c].frame < num_frames ? num_frames - cmds[c].frame : 0;
+
+        if (cmds[c].cmd == TAPE_CMD_RECORD) {
+            tape_player_record(late);
+        } else if (cmds[c].cmd == TAPE_CMD_SLICE) {
+            tape_player_set_slice(late);
         }
     }
 }
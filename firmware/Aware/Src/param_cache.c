@@ -4,78 +4,157 @@
  */
 #include "param_cache.h"
 
+#include <string.h>
+
 #include "FreeRTOS.h"
 #include "atomic.h"
+#include "semphr.h"
+#include "stm32h7xx_hal.h"
 #include "task.h"
 
-static volatile struct param_cache cache;
+// Double-buffered snapshot. Writers fill the slot the audio task does not read and publish it by flipping the index, so
+// a fetch never waits on a writer, even one it preempted halfway through an update.
+static struct param_cache slots[2];
+static volatile uint32_t published; // slot param_cache_fetch() copies
+static volatile uint32_t seq;       // publishes so far
+
+// between the writer tasks, never taken by the audio task. Recursive, so that the setters nest into a batch.
+static SemaphoreHandle_t write_lock;
+static uint32_t write_depth; // nesting of param_cache_begin() of the task that holds the lock
+static struct param_cache* staging;
+
+void param_cache_init(void) {
+    write_lock = xSemaphoreCreateRecursiveMutex();
+    configASSERT(write_lock);
+}
+
+struct param_cache* param_cache_begin(void) {
+    xSemaphoreTakeRecursive(write_lock, portMAX_DELAY);
+    if (write_depth++ == 0) {
+        // start from the published parameters, the other slot holds an older set
+        uint32_t p = published;
+        staging = &slots[p ^ 1];
+        *staging = slots[p];
+    }
+    return staging;
+}
+
+void param_cache_publish(void) {
+    if (--write_depth == 0) {
+        __DMB(); // slot before the index
+        published = (uint32_t) (staging - slots);
+        seq = seq + 1;
+    }
+    xSemaphoreGiveRecursive(write_lock);
+}
 
 /* ===== Writers ===== */
+// A value equal to the published one leaves its generation alone, the audio task has nothing to recompute.
+#define PARAM_CACHE_SET(field, id, v)                \
+    do {                                             \
+        struct param_cache* p = param_cache_begin(); \
+        if (p->field != (v)) {                       \
+            p->field = (v);                          \
+            p->gen[id]++;                            \
+        }                                            \
+        param_cache_publish();                       \
+    } while (0)
+
 void param_cache_set_pitch_cv(float v) {
-    cache.pitch_cv = v;
+    PARAM_CACHE_SET(pitch_cv, PARAM_PITCH_CV, v);
 }
 
 void param_cache_set_pitch_ui(float v) {
-    cache.pitch_ui = v;
+    PARAM_CACHE_SET(pitch_ui, PARAM_PITCH_UI, v);
 }
 
 void param_cache_set_env_attack(float attack) {
-    cache.env_attack = attack;
+    PARAM_CACHE_SET(env_attack, PARAM_ENV_ATTACK, attack);
 }
 
 void param_cache_set_env_decay(float decay) {
-    cache.env_decay = decay;
+    PARAM_CACHE_SET(env_decay, PARAM_ENV_DECAY, decay);
 }
 
 void param_cache_set_cyclic(bool cyclic) {
-    cache.cyclic_mode = cyclic;
+    PARAM_CACHE_SET(cyclic_mode, PARAM_CYCLIC, cyclic);
 }
 
 void param_cache_set_reverse(bool reverse) {
-    cache.reverse_mode = reverse;
+    PARAM_CACHE_SET(reverse_mode, PARAM_REVERSE, reverse);
 }
 
 void param_cache_set_decimation(uint8_t decimation) {
-    cache.decimation = decimation;
+    PARAM_CACHE_SET(decimation, PARAM_DECIMATION, decimation);
 }
 
 void param_cache_set_slice_pos(float slice_pos) {
-    cache.slice_pos = slice_pos;
+    PARAM_CACHE_SET(slice_pos, PARAM_SLICE_POS, slice_pos);
 }
 
 void param_cache_set_xy_fx(float val_x, float val_y) {
-    cache.fx_x = val_x;
-    cache.fx_y = val_y;
+    struct param_cache* p = param_cache_begin();
+    if (p->fx_x != val_x || p->fx_y != val_y) {
+        p->fx_x = val_x;
+        p->fx_y = val_y;
+        p->gen[PARAM_FX_XY]++;
+    }
+    param_cache_publish();
+}
+
+void param_cache_set_grain_density(float density) {
+    PARAM_CACHE_SET(grain_density, PARAM_GRAIN_DENSITY, density);
+}
+
+void param_cache_set_grain_size_ms(float size_ms) {
+    PARAM_CACHE_SET(grain_size_ms, PARAM_GRAIN_SIZE, size_ms);
+}
+
+void param_cache_set_overdub(bool overdub) {
+    PARAM_CACHE_SET(overdub, PARAM_OVERDUB, overdub);
+}
+
+void param_cache_set_overdub_feedback(float feedback) {
+    PARAM_CACHE_SET(overdub_feedback, PARAM_OVERDUB_FEEDBACK, feedback);
 }
 
 void param_cache_set_schroeder_verb_size(float size) {
-    cache.schroeder_verb_size = size;
+    PARAM_CACHE_SET(schroeder_verb_size, PARAM_VERB_SIZE, size);
 }
 void param_cache_set_schroeder_verb_feedback(float feedback) {
-    cache.schroeder_verb_feedback = feedback;
+    PARAM_CACHE_SET(schroeder_verb_feedback, PARAM_VERB_FEEDBACK, feedback);
 }
 void param_cache_set_schroeder_verb_wet(float wet) {
-    cache.schroeder_verb_wet = wet;
+    PARAM_CACHE_SET(schroeder_verb_wet, PARAM_VERB_WET, wet);
 }
 
 void param_cache_set_schroeder_verb_lp_alpha(float alpha) {
-    cache.schroeder_verb_lp_alpha = alpha;
+    PARAM_CACHE_SET(schroeder_verb_lp_alpha, PARAM_VERB_LP_ALPHA, alpha);
 }
 
 /* ===== Reader ===== */
-void param_cache_fetch(struct param_cache* out) {
-    out->pitch_cv = cache.pitch_cv;
-    out->pitch_ui = cache.pitch_ui;
-    out->env_attack = cache.env_attack;
-    out->env_decay = cache.env_decay;
-    out->cyclic_mode = cache.cyclic_mode;
-    out->reverse_mode = cache.reverse_mode;
-    out->decimation = cache.decimation;
-    out->slice_pos = cache.slice_pos;
-    out->fx_x = cache.fx_x;
-    out->fx_y = cache.fx_y;
-    out->schroeder_verb_size = cache.schroeder_verb_size;
-    out->schroeder_verb_feedback = cache.schroeder_verb_feedback;
-    out->schroeder_verb_wet = cache.schroeder_verb_wet;
-    out->schroeder_verb_lp_alpha = cache.schroeder_verb_lp_alpha;
+// Called from the audio task, which outranks the writers: the copy is never interrupted by a publish and the loop runs once.
+// A slower reader would copy again if a publish flipped the slots under it.
+uint32_t param_cache_fetch(struct param_cache* out) {
+    uint32_t last[PARAM_GEN_WORDS];
+    memcpy(last, out->gen_words, sizeof(last));
+
+    uint32_t s;
+    do {
+        s = seq;
+        __DMB(); // sequence before the copy
+        *out = slots[published];
+        __DMB(); // copy before the sequence check
+    } while (s != seq);
+
+    // most blocks change nothing, so four counters are compared at once. Counter i is byte i % 4 of its word.
+    uint32_t changed = 0;
+    for (uint32_t w = 0; w < PARAM_GEN_WORDS; w++) {
+        uint32_t diff = out->gen_words[w] ^ last[w];
+        for (uint32_t i = 4 * w; diff != 0; i++, diff >>= 8) {
+            if (diff & 0xFF)
+                changed |= PARAM_BIT(i);
+        }
+    }
+    return changed;
 }
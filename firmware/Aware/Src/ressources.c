@@ -1,6 +1,6 @@
 /**
  * @file ressources.c
- * @brief LUT data: fade-in curve, IIR coefficients, and Butterworth lowpass coefficients.
+ * @brief LUT data: fade-in curve, grain window, IIR coefficients, and Butterworth lowpass coefficients.
  */
 #include "ressources.h"
 
@@ -45,4 +45,25 @@ float32_t lp_fc2k_but_coeffs[lp_fc2k_but_NUM_STAGES * 5] = {
     0.01440144,
     1.63299316,
     -0.69059892,
-};
\ No newline at end of file
+};
+q15_t halfband_coeffs_q15[HALFBAND_NUM_TAPS] = {
+    -4, 0, 35, 0, -124, 0, 321, 0, -708, 0, 1442, 0, -3051, 0, 10281, 16384,
+    10281, 0, -3051, 0, 1442, 0, -708, 0, 321, 0, -124, 0, 35, 0, -4,
+};
+
+q15_t grain_window_lut[GRAIN_WINDOW_LEN] = {
+    1,     11,    31,    60,    100,   149,   208,   277,   355,   443,   541,   648,   765,   891,   1027,  1171,  1325,  1488,  1660,
+    1841,  2030,  2229,  2435,  2650,  2874,  3105,  3345,  3592,  3847,  4110,  4380,  4657,  4942,  5233,  5531,  5835,  6146,  6463,
+    6786,  7115,  7449,  7789,  8134,  8484,  8838,  9197,  9561,  9929,  10300, 10675, 11054, 11436, 11820, 12208, 12598, 12990, 13385,
+    13781, 14179, 14578, 14978, 15379, 15780, 16182, 16585, 16987, 17388, 17789, 18189, 18588, 18986, 19382, 19777, 20169, 20559, 20947,
+    21331, 21713, 22092, 22467, 22838, 23206, 23570, 23929, 24283, 24633, 24978, 25318, 25652, 25981, 26304, 26621, 26932, 27236, 27534,
+    27825, 28110, 28387, 28657, 28920, 29175, 29422, 29662, 29893, 30117, 30332, 30538, 30737, 30926, 31107, 31279, 31442, 31596, 31740,
+    31876, 32002, 32119, 32226, 32324, 32412, 32490, 32559, 32618, 32667, 32707, 32736, 32756, 32766, 32766, 32756, 32736, 32707, 32667,
+    32618, 32559, 32490, 32412, 32324, 32226, 32119, 32002, 31876, 31740, 31596, 31442, 31279, 31107, 30926, 30737, 30538, 30332, 30117,
+    29893, 29662, 29422, 29175, 28920, 28657, 28387, 28110, 27825, 27534, 27236, 26932, 26621, 26304, 25981, 25652, 25318, 24978, 24633,
+    24283, 23929, 23570, 23206, 22838, 22467, 22092, 21713, 21331, 20947, 20559, 20169, 19777, 19382, 18986, 18588, 18189, 17789, 17388,
+    16987, 16585, 16182, 15780, 15379, 14978, 14578, 14179, 13781, 13385, 12990, 12598, 12208, 11820, 11436, 11054, 10675, 10300, 9929,
+    9561,  9197,  8838,  8484,  8134,  7789,  7449,  7115,  6786,  6463,  6146,  5835,  5531,  5233,  4942,  4657,  4380,  4110,  3847,
+    3592,  3345,  3105,  2874,  2650,  2435,  2229,  2030,  1841,  1660,  1488,  1325,  1171,  1027,  891,   765,   648,   541,   443,
+    355,   277,   208,   149,   100,   60,    31,    11,    1,
+};
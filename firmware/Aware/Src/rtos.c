@@ -14,6 +14,7 @@
 #include <string.h>
 
 #include "audioengine.h"
+#include "cmd_ring.h"
 #include "control_interface.h"
 #include "drivers/adc_driver.h"
 #include "drivers/gpio_driver.h"
@@ -22,9 +23,11 @@
 #include "drivers/ws2812_driver.h"
 #include "dsp/exciter.h"
 #include "dsp/schroeder_reverb.h"
+#include "dsp/smoother.h"
 #include "param_cache.h"
 #include "project_config.h"
 #include "tape_player.h"
+#include "tape_worker.h"
 #include "tim.h"
 #include "user_interface.h"
 #include "util.h"
@@ -34,9 +37,28 @@
 TaskHandle_t audioTaskHandle;
 TaskHandle_t controlIfTaskHandle;
 TaskHandle_t userIfTaskHandle;
+TaskHandle_t workerTaskHandle;
 static TaskHandle_t bootCalibTaskHandle = NULL;
 
-QueueHandle_t tape_cmd_q;
+// gates from the EXTI callback to the audio task
+static cmd_ring_t tape_cmd_ring;
+
+// gate edge to the output of the frame it acts on, see take_block_gates()
+static latency_stats_t gate_latency;
+static cycle_stats_t param_fetch_cycles;
+static cycle_stats_t param_apply_cycles;
+// audio pipeline per DMA period, from the parameter update to the last stage, for each profile
+static cycle_stats_t period_cycles[AUDIO_NUM_PROFILES];
+// stage times of the deadline monitor, published in audio_deadline
+static latency_stats_t stage_stats[AUDIO_NUM_STAGES];
+
+// Scratch arena of the audio pipeline between the input and the output period of the DMA buffers. In .bss, which is DTCM,
+// the DMA periods are in the slower non-cacheable AXI SRAM and are only read by the first stage and written by the last one.
+static struct {
+    int16_t dry[AUDIO_MAX_BLOCK_FRAMES * 2];   // output of tape player, input to exciter
+    int16_t fx[AUDIO_MAX_BLOCK_FRAMES * 2];    // output of exciter, input to reverb
+    float excite_gain[AUDIO_MAX_BLOCK_FRAMES]; // ramp of the exciter amount per frame
+} audio_arena;
 
 SemaphoreHandle_t audioReadySemaphore;
 
@@ -44,6 +66,7 @@ SemaphoreHandle_t audioReadySemaphore;
 static void AudioTask(void* argument);
 static void ControlInterfaceTask(void* argument);
 static void UserInterfaceTask(void* argument);
+static void WorkerTask(void* argument);
 
 /* ===== Global config structs =====*/
 // __attribute__((section(".sram1"))) struct SettingsData settings_data_ram;
@@ -51,9 +74,7 @@ struct SettingsData settings_data_ram;
 
 /* ===== FreeRTOS init ===== */
 void FREERTOS_Init(void) {
-    /* create command queue */
-    tape_cmd_q = xQueueCreate(8, sizeof(tape_cmd_msg_t));
-    configASSERT(tape_cmd_q);
+    param_cache_init();
 
     audioReadySemaphore = xSemaphoreCreateBinary();
     configASSERT(audioReadySemaphore);
@@ -67,11 +88,15 @@ void FREERTOS_Init(void) {
     /* create user interface task */
     xTaskCreate(UserInterfaceTask, "UserIF", 256, NULL, configMAX_PRIORITIES - 4, &userIfTaskHandle);
 
+    /* create worker task (lowest priority above idle), post-processes finished takes */
+    xTaskCreate(WorkerTask, "Worker", 256, NULL, tskIDLE_PRIORITY + 1, &workerTaskHandle);
+    tape_worker_init(workerTaskHandle);
+
     {
         init_adc_interface(controlIfTaskHandle, userIfTaskHandle, &hadc2, &hadc1);
         start_adc_interface();
 
-        init_gpio_interface(controlIfTaskHandle, userIfTaskHandle, &htim13, &htim14, tape_cmd_q);
+        init_gpio_interface(controlIfTaskHandle, userIfTaskHandle, &htim13, &htim14, &tape_cmd_ring);
 
 #ifdef CONFIG_USE_CALIB_STORAGE
         int32_t b_read = read_settings_data(&settings_data_ram);
@@ -104,6 +129,71 @@ void FREERTOS_Init(void) {
 }
 
 /* ===== Audio task ===== */
+// Take the gates that came in over the input period of the transfer that ended at end off the ring and place each on the
+// frame it came in at, from its DWT timestamp. A gate after the transfer stays in the ring for the next period, one from
+// before the period (the task ran late) acts on its first frame. Every gate is delayed by the same AUDIO_DMA_PERIODS
+// periods, up to a frame.
+static uint32_t take_period_gates(tape_cmd_msg_t* cmds, uint32_t max, uint32_t num_frames, uint32_t end, uint32_t period) {
+    uint32_t n = 0;
+    tape_cmd_msg_t msg;
+    while (n < max && cmd_ring_peek(&tape_cmd_ring, &msg)) {
+        int32_t ahead = (int32_t) (end - msg.cycles); // cycles from the gate to the end of the block
+        if (ahead <= 0)
+            break;
+        cmd_ring_pop(&tape_cmd_ring);
+
+        msg.frame = (uint32_t) ahead < period ? (uint32_t) (((uint64_t) (period - ahead) * num_frames) / period) : 0;
+
+        // frame 0 of this period plays AUDIO_DMA_PERIODS - 1 periods after the transfer
+        uint32_t to_frame = (AUDIO_DMA_PERIODS - 1) * period + (uint32_t) (((uint64_t) msg.frame * period) / num_frames);
+        latency_stats_add(&gate_latency, (uint32_t) ahead + to_frame);
+        cpu_stats.gate_latency_max = gate_latency.max;
+        cpu_stats.gate_jitter = gate_latency.max - gate_latency.min;
+        cmds[n++] = msg;
+    }
+    return n;
+}
+
+// Start the stage times and the headroom over, when the engine starts. The late and lost counts stay.
+static void deadline_monitor_reset(void) {
+    memset(stage_stats, 0, sizeof(stage_stats));
+    for (uint32_t i = 0; i < AUDIO_NUM_STAGES; i++)
+        audio_deadline.stages[i] = (audio_stage_stats_t) {0};
+    audio_deadline.wake_latency_max = 0;
+    audio_deadline.headroom_min = UINT32_MAX;
+}
+
+// Account one processed period against its deadline, AUDIO_DMA_PERIODS - 1 periods after the transfer at end. As many
+// transfers since then mean the output started playing before it was complete. dropped counts the periods skipped before
+// it, which were never processed.
+static void deadline_monitor_period(uint32_t dropped, uint32_t end, uint32_t period, uint32_t start, uint32_t* stage_cycles) {
+    uint32_t done = cycle_stats_begin();
+    uint32_t deadline = (AUDIO_DMA_PERIODS - 1) * period;
+
+    audio_deadline.periods++;
+    audio_deadline.lost += dropped;
+    audio_deadline.i2s_errors = audio_i2s_errors();
+
+    int32_t headroom = (int32_t) (end + deadline - done);
+    if (audio_dma_pending() >= AUDIO_DMA_PERIODS || headroom < 0) {
+        audio_deadline.late++;
+        headroom = 0;
+    }
+    if ((uint32_t) headroom < audio_deadline.headroom_min)
+        audio_deadline.headroom_min = (uint32_t) headroom;
+    if (start - end > audio_deadline.wake_latency_max)
+        audio_deadline.wake_latency_max = start - end;
+    audio_deadline.deadline_cycles = deadline;
+
+    stage_cycles[AUDIO_STAGE_TOTAL] = done - end;
+    for (uint32_t i = 0; i < AUDIO_NUM_STAGES; i++) {
+        latency_stats_add(&stage_stats[i], stage_cycles[i]);
+        audio_deadline.stages[i].min = stage_stats[i].min;
+        audio_deadline.stages[i].avg = stage_stats[i].avg;
+        audio_deadline.stages[i].max = stage_stats[i].max;
+    }
+}
+
 static void AudioTask(void* argument) {
     (void) argument;
 
@@ -113,9 +203,10 @@ static void AudioTask(void* argument) {
     }
 
     struct audioengine_config audioengine_cfg = {
-        .i2s_handle = &hi2s1, .sample_rate = AUDIO_SAMPLE_RATE, .buffer_size = AUDIO_BLOCK_SIZE, .audioTaskHandle = audioTaskHandle};
+        .i2s_handle = &hi2s1, .sample_rate = AUDIO_SAMPLE_RATE, .audioTaskHandle = audioTaskHandle};
 
     excite_config_t exciter;
+    smoother_t excite_gain;
     schroeder_stereo_t reverb;
 
     // wait for audio engine to be ready (signaled from uiface after calibration)
@@ -125,111 +216,138 @@ static void AudioTask(void* argument) {
         init_tape_player(audioengine_cfg.buffer_size);
 
         excite_init(&exciter);
+        smoother_init(&excite_gain, SMOOTHER_LINEAR, 0.0f, EXCITE_GAIN_RAMP_MS, AUDIO_SAMPLE_RATE, 0.0f);
         schroeder_rev_init(&reverb);
         schroeder_rev_set_wet(&reverb, 0.5f);
 
         start_audio_engine();
 
+        // the first block takes over every parameter
+        struct param_cache param_cache = {0};
+        uint32_t param_changes = PARAM_ALL;
+        deadline_monitor_reset();
+
         for (;;) {
-            // processing half audio block from half dma buffer.
+            // processing the oldest pending period of the DMA ring, in DSP blocks of the profile
 
             // fetch params
-            struct param_cache param_cache;
-            param_cache_fetch(&param_cache);
-
-            /* wait for DMA signal */
-            ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+            uint32_t t0 = cycle_stats_begin();
+            param_changes |= param_cache_fetch(&param_cache);
+            cycle_stats_end(&param_fetch_cycles, t0);
+            cpu_stats.param_fetch_cycles = param_fetch_cycles.avg;
+
+            // recompute only what depends on a changed parameter
+            t0 = cycle_stats_begin();
+            tape_player_set_params(&param_cache, param_changes);
+#ifdef CONFIG_ENABLE_REVERB
+            // the feedback scales with the size, so it follows the size
+            if (param_changes & (PARAM_BIT(PARAM_VERB_SIZE) | PARAM_BIT(PARAM_VERB_FEEDBACK))) {
+                schroeder_rev_set_size(&reverb, param_cache.schroeder_verb_size);
+                schroeder_rev_set_feedback(&reverb, param_cache.schroeder_verb_feedback);
+            }
+            if (param_changes & PARAM_BIT(PARAM_VERB_WET))
+                schroeder_rev_set_wet(&reverb, param_cache.schroeder_verb_wet);
+            if (param_changes & PARAM_BIT(PARAM_VERB_LP_ALPHA))
+                schroeder_rev_set_lp_alpha(&reverb, param_cache.schroeder_verb_lp_alpha);
+#endif
+            param_changes = 0;
+            cycle_stats_end(&param_apply_cycles, t0);
+            cpu_stats.param_apply_cycles = param_apply_cycles.avg;
+
+            /* wait for DMA signal, periods left over from the last wake-up come first */
+            while (audio_dma_pending() == 0)
+                ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+            uint32_t dropped = audio_dma_drop_overrun();
 #ifdef CONFIG_AUDIO_LOOPBACK
             // simple loopback for testing
+            (void) dropped;
             loopback_samples();
+            audio_dma_period_done();
 #else
+            t0 = cycle_stats_begin();
+            uint32_t period_end, period_len;
+            audio_block_timing(&period_end, &period_len);
+            uint32_t stage_cycles[AUDIO_NUM_STAGES] = {[AUDIO_STAGE_PARAMS] = param_fetch_cycles.last + param_apply_cycles.last};
+            const audio_profile_t* profile = audio_profile();
+            const uint32_t num_frames = profile->block_frames;
+
+            // the period of the DMA ring this pass reads and writes
+            const int16_t* in_period = audio_dma_in_block();
+            int16_t* out_period = audio_dma_out_block();
+
+            tape_cmd_msg_t cmds[CMD_RING_LEN];
+            uint32_t num_cmds = take_period_gates(cmds, CMD_RING_LEN, profile->period_frames, period_end, period_len);
+            uint32_t next_cmd = 0;
+
+            for (uint32_t pos = 0; pos < profile->period_frames; pos += num_frames) {
+                const int16_t* in = &in_period[2 * pos];
+                int16_t* out = &out_period[2 * pos];
+
+                // the gates of this block, on frames of the block
+                const tape_cmd_msg_t* block_cmds = &cmds[next_cmd];
+                uint32_t num_block_cmds = 0;
+                for (; next_cmd < num_cmds && cmds[next_cmd].frame < pos + num_frames; next_cmd++, num_block_cmds++)
+                    cmds[next_cmd].frame = cmds[next_cmd].frame > pos ? cmds[next_cmd].frame - pos : 0;
+
+                // the last stage writes the output period
+#ifdef CONFIG_ENABLE_REVERB
+                int16_t* fx = audio_arena.fx;
+#else
+                int16_t* fx = out;
+#endif
 
-            int16_t processed[AUDIO_HALF_BLOCK_SIZE]; // output of exciter, input to reverb, output of reverb (pre-dac)
-            int16_t in_buf[AUDIO_HALF_BLOCK_SIZE];    // input from codec, output of tape player (pre-exciter)
-            int16_t dry[AUDIO_HALF_BLOCK_SIZE];       // output of tape player, input to exciter (pre-reverb)
-
-            audio_get_dma_in_buf(in_buf, AUDIO_HALF_BLOCK_SIZE);
-
-            /* ----- TAPE PLAYER ----- */
-            tape_player_set_params(param_cache);
-
+                /* ----- TAPE PLAYER ----- */
 #ifdef CONFIG_ENABLE_TAPE_PLAYER
-            // tape player may be disabled to check simple dsp processing without tape player in the way, since it is currently the only source of audio input (no external input implemented yet)
-            tape_player_process(in_buf, (int16_t*) dry);
-
-            /* ----- TAPE PLAYER END ----- */
-
-            /* ------ EXCITER ------ */
-            excite_block(&exciter, dry, processed, AUDIO_HALF_BLOCK_SIZE, 1000.0f);
-
-            float excite_amount = tape_player_get_grit();
-            excite_amount = excite_amount * MAX_EXCITE_ON_MAX_DECIMATION;
-
-            // mix wet and dry with fixed ratio for now (can be made variable later)
-            for (uint32_t i = 0; i < AUDIO_HALF_BLOCK_SIZE; i++) {
-                processed[i] = 1.0f * dry[i] + excite_amount * processed[i];
-
-                // hardware saturation
-                processed[i] = __SSAT(processed[i], 16);
-            }
-            /* ------ EXCITER END ------ */
+                // tape player may be disabled to check simple dsp processing without tape player in the way, since it is currently the only source of audio input (no external input implemented yet)
+                int16_t* dry = audio_arena.dry;
+                uint32_t ts = cycle_stats_begin();
+                tape_player_process(in, dry, num_frames, block_cmds, num_block_cmds);
+                uint32_t te = cycle_stats_begin();
+                stage_cycles[AUDIO_STAGE_TAPE] += te - ts;
+
+                /* ----- TAPE PLAYER END ----- */
+
+                /* ------ EXCITER ------ */
+                ts = te;
+                excite_block(&exciter, dry, fx, num_frames, 1000.0f);
+
+                // the amount follows the grit of the playing take, ramped over a swap
+                smoother_set_target(&excite_gain, tape_player_get_grit() * MAX_EXCITE_ON_MAX_DECIMATION);
+                float* gain = audio_arena.excite_gain;
+                bool gain_ramp = smoother_process_block(&excite_gain, gain, num_frames);
+
+                // mix wet and dry with fixed ratio for now (can be made variable later)
+                for (uint32_t i = 0; i < 2 * num_frames; i++) {
+                    float excite_amount = gain_ramp ? gain[i / 2] : excite_gain.value;
+
+                    // hardware saturation
+                    fx[i] = __SSAT((int32_t) (1.0f * dry[i] + excite_amount * fx[i]), 16);
+                }
+                stage_cycles[AUDIO_STAGE_EXCITER] += cycle_stats_begin() - ts;
+                /* ------ EXCITER END ------ */
 
 #else
-            // if tape player is disabled, just pass input directly to exciter and reverb for testing
-            memcpy(processed, in_buf, sizeof(int16_t) * AUDIO_HALF_BLOCK_SIZE);
+                // if tape player is disabled, just pass input directly to exciter and reverb for testing
+                (void) block_cmds;
+                (void) num_block_cmds;
+                memcpy(fx, in, sizeof(int16_t) * 2 * num_frames);
 #endif
 
 #ifdef CONFIG_ENABLE_REVERB
-            /* ------ REVERB ------ */
-            float reverb_size = param_cache.schroeder_verb_size;
-            float reverb_feedback = param_cache.schroeder_verb_feedback;
-            float reverb_wet = param_cache.schroeder_verb_wet;
-            float reverb_lp_alpha = param_cache.schroeder_verb_lp_alpha;
-            schroeder_rev_set_feedback(&reverb, reverb_feedback);
-            schroeder_rev_set_size(&reverb, reverb_size);
-            schroeder_rev_set_wet(&reverb, reverb_wet);
-            // schroeder_rev_set_wet(&reverb, 1.0);
-            schroeder_rev_set_lp_alpha(&reverb, reverb_lp_alpha);
-
-            // +1 because int16 range is asymmetric [-32768, 32767]: dividing by 32768 maps
-            // -32768 -> -1.0 exactly; dividing by INT16_MAX would push -32768 to -1.000030.
-            for (uint32_t i = 0; i < AUDIO_HALF_BLOCK_SIZE; i += 2) {
-                float inL = (float) processed[i] / (INT16_MAX + 1);
-                float inR = (float) processed[i + 1] / (INT16_MAX + 1);
-
-                float outL, outR;
-
-                schroeder_rev_process(&reverb, inL, inR, &outL, &outR);
-
-                /* back to int16 */
-                int32_t sL = (int32_t) (outL * (INT16_MAX + 1));
-                int32_t sR = (int32_t) (outR * (INT16_MAX + 1));
-
-                processed[i] = __SSAT(sL, 16);
-                processed[i + 1] = __SSAT(sR, 16);
-            }
-            /* ------ REVERB END ------ */
+                /* ------ REVERB ------ */
+                uint32_t tr = cycle_stats_begin();
+                schroeder_rev_process_block(&reverb, fx, out, num_frames);
+                stage_cycles[AUDIO_STAGE_REVERB] += cycle_stats_begin() - tr;
+                /* ------ REVERB END ------ */
 #endif
-            audio_write_dma_out_buf(processed, AUDIO_HALF_BLOCK_SIZE);
-
-            /* handle pending commands (non-blocking) */
-            tape_cmd_msg_t msg;
-            while (xQueueReceive(tape_cmd_q, &msg, 0) == pdTRUE) {
-                switch (msg.cmd) {
-                case TAPE_CMD_PLAY:
-                    tape_player_play();
-                    break;
-                case TAPE_CMD_STOP:
-                    tape_player_stop_play();
-                    break;
-                case TAPE_CMD_RECORD:
-                    tape_player_record();
-                    break;
-                case TAPE_CMD_SLICE:
-                    tape_player_set_slice();
-                    break;
-                }
             }
+            deadline_monitor_period(dropped, period_end, period_len, t0, stage_cycles);
+            audio_dma_period_done();
+
+            // cycles per frame of the profile, the parameter update of the period included
+            audio_profile_id_t id = audio_profile_id();
+            cycle_stats_end(&period_cycles[id], t0 - param_fetch_cycles.last - param_apply_cycles.last);
+            cpu_stats.frame_cycles[id] = period_cycles[id].avg / profile->period_frames;
 #endif
         }
     }
@@ -321,6 +439,18 @@ static void ControlInterfaceTask(void* argument) {
     }
 }
 
+/* ===== Worker task ===== */
+static void WorkerTask(void* argument) {
+    (void) argument;
+
+    for (;;) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        // one bounded step at a time, tasks of the same priority get their turn in between
+        while (tape_worker_process())
+            taskYIELD();
+    }
+}
+
 /* ===== User interface task ===== */
 static void UserInterfaceTask(void* argument) {
     DWT_Init();
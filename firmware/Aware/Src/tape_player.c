@@ -9,10 +9,13 @@
 #include <stdint.h>
 #include <string.h>
 
+#include "dsp/sinc_interp.h"
 #include "envelope.h"
 #include "param_cache.h"
 #include "project_config.h"
 #include "ressources.h"
+#include "tape_pool.h"
+#include "tape_worker.h"
 #include "util.h"
 
 // #define DECIMATION_FIXED 16 // fixed decimation factor for testing, will be set from params in record state machine once working.
@@ -20,88 +23,233 @@
 static tape_buffer_t tape_buf_a;
 static tape_buffer_t tape_buf_b;
 
-static int16_t tape_play_buf_l[TAPE_SIZE_CHANNEL] __attribute__((section(".sram1"))) = {0};
-static int16_t tape_play_buf_r[TAPE_SIZE_CHANNEL] __attribute__((section(".sram1"))) = {0};
-
-static int16_t tape_rec_buf_l[TAPE_SIZE_CHANNEL] __attribute__((section(".sram1"))) = {0};
-static int16_t tape_rec_buf_r[TAPE_SIZE_CHANNEL] __attribute__((section(".sram1"))) = {0};
-
 // Shared tape player state — also accessed by tape_player_dsp.c via extern.
 struct tape_player tape_player;
 
+// Give the pool region of buf back and leave it without a take.
+static void tape_release_take(tape_buffer_t* buf) {
+    if (buf->mem)
+        tape_pool_release(buf->mem);
+    buf->mem = NULL;
+    buf->mem_bytes = 0;
+    tape_store_assign(&buf->store, NULL, 0);
+    buf->size = 0;
+    buf->valid_samples = 0;
+    buf->take_id = 0;
+    buf->overdubbed = false;
+#ifdef CONFIG_TAPE_MIPMAP
+    memset(&buf->mip, 0, sizeof(buf->mip));
+#endif
+#ifdef CONFIG_TAPE_ANALYSIS
+    memset(&buf->analysis, 0, sizeof(buf->analysis));
+#endif
+#ifdef CONFIG_TAPE_LOOP_SEARCH
+    buf->loop_end = 0;
+    buf->loop_xfade_len = FADE_XFADE_CYCLIC_LEN;
+#endif
+}
+
+// A voice pins the take it reads, and so do its crossfades as long as the voice is rendered. Running grains pin their take as well,
+// and so does the worker job until it is released, it writes the mip levels into the region.
+static bool tape_take_pinned(const void* mem) {
+    if (tape_worker_reads(mem))
+        return true;
+#ifdef CONFIG_ENABLE_GRANULAR
+    if (granular_reads(&tape_player.granular, mem))
+        return true;
+#endif
+    for (uint32_t i = 0; i < CONFIG_TAPE_NUM_VOICES; i++) {
+        tape_voice_t* v = &tape_player.voices[i];
+        if (v->play_state != PLAY_PLAYING)
+            continue;
+        if (tape_store_base(&v->reader.store) == mem)
+            return true;
+        if (v->xfade_retrig.active && tape_store_base(&v->xfade_retrig.buf_b.store) == mem)
+            return true;
+        if (v->xfade_cyclic.active && tape_store_base(&v->xfade_cyclic.buf_b.store) == mem)
+            return true;
+    }
+    return false;
+}
+
+// Free the retired take. With force, voices and crossfades still reading it are cut, otherwise returns false while it is pinned.
+// The worker cannot be cut, it lets go of a retired take at its next step. The take is freed once the job is released,
+// see tape_player_sync_worker().
+static bool tape_reclaim_retired_take(bool force) {
+    void* mem = tape_player.retired_take;
+    if (!mem)
+        return true;
+    if (!force && tape_take_pinned(mem))
+        return false;
+
+#ifdef CONFIG_ENABLE_GRANULAR
+    if (tape_store_base(&tape_player.granular.reader.store) == mem)
+        granular_stop(&tape_player.granular);
+#endif
+
+    for (uint32_t i = 0; i < CONFIG_TAPE_NUM_VOICES; i++) {
+        tape_voice_t* v = &tape_player.voices[i];
+        if (tape_store_base(&v->reader.store) == mem) {
+            v->play_state = PLAY_STOPPED;
+            tape_reader_attach(&v->reader, NULL);
+        }
+
+        crossfade_t* xfades[2] = {&v->xfade_retrig, &v->xfade_cyclic};
+        for (uint32_t j = 0; j < 2; j++) {
+            if (tape_store_base(&xfades[j]->buf_b.store) == mem) {
+                xfades[j]->active = false;
+                tape_reader_attach(&xfades[j]->buf_b, NULL);
+            }
+        }
+    }
+
+    if (tape_worker_reads(mem))
+        tape_player.worker_retired_take = mem; // the one job is on this take, nothing else waits there
+    else
+        tape_pool_release(mem);
+    tape_player.retired_take = NULL;
+    return true;
+}
+
+#ifdef CONFIG_TAPE_LOOP_SEARCH
+// Loop of buf for cyclic mode, the crossfade over its wrap included.
+static void voice_set_loop(tape_voice_t* v, const tape_buffer_t* buf) {
+    v->loop_end = buf->loop_end;
+    v->xfade_cyclic.len = buf->loop_xfade_len;
+    if (buf->loop_xfade_len) // without one a running crossfade finishes at its step
+        v->xfade_cyclic.step_q16 = (uint32_t) (((uint64_t) FADE_LUT_LEN << 16) / buf->loop_xfade_len);
+}
+#endif
+
+// Point v at the current playback take.
+static void voice_attach_take(tape_voice_t* v) {
+    tape_reader_attach(&v->reader, &tape_player.playback_buf->store);
+    v->valid_samples = tape_player.playback_buf->valid_samples;
+    v->decimation = tape_player.playback_buf->decimation;
+#ifdef CONFIG_TAPE_LOOP_SEARCH
+    voice_set_loop(v, tape_player.playback_buf);
+#endif
+}
+
+// Fade the voice out, it keeps reading its take until the fade ends.
+static void voice_release(tape_voice_t* v) {
+#ifdef CONFIG_TAPE_PLAYER_ENABLE_FADE_IN_OUT
+    v->releasing = true;
+    if (!v->fade_out.active) {
+        v->fade_out.active = true;
+        v->fade_out.fade_acc_q16 = 0;
+    }
+#else
+    v->play_state = PLAY_STOPPED;
+#endif
+}
+
+static void voice_init(tape_voice_t* v) {
+    tape_reader_attach(&v->reader, NULL);
+    v->valid_samples = 0;
+    v->decimation = 1;
+    v->releasing = false;
+    v->note_seq = 0;
+
+    // playhead init
+    v->pos_q48_16 = 1 << 16; // start at sample 1 for interpolation
+
+    tape_reader_attach(&v->xfade_retrig.buf_b, NULL);
+    v->xfade_retrig.len = FADE_XFADE_RETRIG_LEN; // crossfade length in samples TODO: make configurable via MACRO
+    v->xfade_retrig.active = false;
+    v->xfade_retrig.buf_b_valid_samples = 0;
+    v->xfade_retrig.pos_q48_16 = 1 << 16; // start at sample 1 for interpolation
+    v->xfade_retrig.step_q16 = FADE_XFADE_RETRIG_STEP_Q16;
+
+    tape_reader_attach(&v->xfade_cyclic.buf_b, NULL);
+    v->xfade_cyclic.len = FADE_XFADE_CYCLIC_LEN; // crossfade length in samples TODO: make configurable via MACRO
+    v->xfade_cyclic.active = false;
+    v->xfade_cyclic.buf_b_valid_samples = 0;
+    v->xfade_cyclic.pos_q48_16 = 1 << 16; // start at sample 1 for interpolation
+    v->xfade_cyclic.step_q16 = FADE_XFADE_CYCLIC_STEP_Q16;
+
+    tape_reader_attach(&v->fade_in.buf_b, NULL); // not used for simple fade in/out, only for crossfades
+    v->fade_in.len = FADE_IN_OUT_LEN;            // fade length in samples TODO: make configurable via MACRO
+    v->fade_in.pos_q48_16 = 1 << 16;             // start at sample 1 for interpolation
+    v->fade_in.step_q16 = FADE_IN_OUT_STEP_Q16;
+    tape_reader_attach(&v->fade_out.buf_b, NULL); // not used for simple fade in/out, only for crossfades
+    v->fade_out.len = FADE_IN_OUT_LEN;            // fade length in samples
+    v->fade_out.pos_q48_16 = 1 << 16;             // start at sample 1 for interpolation
+    v->fade_out.step_q16 = FADE_IN_OUT_STEP_Q16;
+
+    v->play_state = PLAY_STOPPED;
+
+    // envelope init
+    v->env.state = ENV_IDLE;
+    v->env.value = 0.0f;
+    v->env.attack_inc = 1 / (0.001f * AUDIO_SAMPLE_RATE);
+    v->env.decay_inc = 1 / (0.5f * AUDIO_SAMPLE_RATE);
+    v->env.sustain = 0.0f;
+
+#ifdef CONFIG_TAPE_TIME_STRETCH
+    // note_seq 0 never belongs to a note, the first render sets the grains up
+    memset(&v->stretch, 0, sizeof(v->stretch));
+#endif
+
+    memset(&v->render_cycles, 0, sizeof(v->render_cycles));
+}
+
 int init_tape_player(size_t dma_buf_size) {
     if (dma_buf_size <= 0)
         return -1;
 
-    // clear tape buffers on init
-    memset(tape_play_buf_l, 0, sizeof(tape_play_buf_l));
-    memset(tape_play_buf_r, 0, sizeof(tape_play_buf_r));
-
-    // debug addresses for reading out tape buffer via SWD
-    volatile uintptr_t tape_l_addr_dbg = (uintptr_t) tape_play_buf_l;
-    volatile uintptr_t tape_r_addr_dbg = (uintptr_t) tape_play_buf_r;
+    // takes are claimed from the pool when recording starts, see tape_player_claim_rec_take()
+    tape_pool_init();
+    tape_codec_init();
+#ifdef CONFIG_TAPE_SINC_TAPS
+    sinc_interp_init();
+#endif
 
     // buffer assignments
     tape_player.playback_buf = &tape_buf_a;
     tape_player.record_buf = &tape_buf_b;
     tape_player.dma_buf_size = dma_buf_size;
-    tape_player.playback_buf->ch[0] = tape_play_buf_l;
-    tape_player.playback_buf->ch[1] = tape_play_buf_r;
-    tape_player.playback_buf->size = TAPE_SIZE_CHANNEL;
-    tape_player.playback_buf->valid_samples = 0;
-    tape_player.record_buf->ch[0] = tape_rec_buf_l;
-    tape_player.record_buf->ch[1] = tape_rec_buf_r;
-    tape_player.record_buf->size = TAPE_SIZE_CHANNEL;
-    tape_player.record_buf->valid_samples = 0;
-
-    // playhead and reacordhead init
-    tape_player.pos_q48_16 = 1 << 16; // start at sample 1 for interpolation
-    tape_player.swap_bufs_pending = false;
+    tape_release_take(tape_player.playback_buf);
+    tape_release_take(tape_player.record_buf);
+    tape_player.retired_take = NULL;
+    tape_player.worker_retired_take = NULL;
 
-    tape_player.xfade_retrig.buf_b_ptr_l = NULL;
-    tape_player.xfade_retrig.buf_b_ptr_r = NULL;
-    tape_player.xfade_retrig.len = FADE_XFADE_RETRIG_LEN; // crossfade length in samples TODO: make configurable via MACRO
-    tape_player.xfade_retrig.active = false;
-    tape_player.xfade_retrig.temp_buf_valid_samples = 0;
-    tape_player.xfade_retrig.pos_q48_16 = 1 << 16; // start at sample 1 for interpolation
-    tape_player.xfade_retrig.step_q16 = FADE_XFADE_RETRIG_STEP_Q16;
-
-    tape_player.xfade_cyclic.buf_b_ptr_l = NULL;
-    tape_player.xfade_cyclic.buf_b_ptr_r = NULL;
-    tape_player.xfade_cyclic.len = FADE_XFADE_CYCLIC_LEN; // crossfade length in samples TODO: make configurable via MACRO
-    tape_player.xfade_cyclic.active = false;
-    tape_player.xfade_cyclic.temp_buf_valid_samples = 0;
-    tape_player.xfade_cyclic.pos_q48_16 = 1 << 16; // start at sample 1 for interpolation
-    tape_player.xfade_cyclic.step_q16 = FADE_XFADE_CYCLIC_STEP_Q16;
-
-    tape_player.fade_in.buf_b_ptr_l = NULL;     // not used for simple fade in/out, only for crossfades
-    tape_player.fade_in.buf_b_ptr_r = NULL;     // not used for simple fade in/out, only for crossfades
-    tape_player.fade_in.len = FADE_IN_OUT_LEN;  // fade length in samples TODO: make configurable via MACRO
-    tape_player.fade_in.pos_q48_16 = 1 << 16;   // start at sample 1 for interpolation
-    tape_player.fade_out.buf_b_ptr_l = NULL;    // not used for simple fade in/out, only for crossfades
-    tape_player.fade_out.buf_b_ptr_r = NULL;    // not used for simple fade in/out, only for crossfades
-    tape_player.fade_out.len = FADE_IN_OUT_LEN; // fade length in samples
-    tape_player.fade_out.pos_q48_16 = 1 << 16;  // start at sample 1 for interpolation
+    tape_player.swap_bufs_pending = false;
     tape_player.tape_recordhead = 0;
 
+    // voices
+    for (uint32_t i = 0; i < CONFIG_TAPE_NUM_VOICES; i++)
+        voice_init(&tape_player.voices[i]);
+    tape_player.note_seq = 0;
+
+#ifdef CONFIG_ENABLE_GRANULAR
+    granular_init(&tape_player.granular);
+#endif
+
     // state logic
-    tape_player.play_state = PLAY_STOPPED;
     tape_player.rec_state = REC_IDLE;
 
-    // envelope init
-    tape_player.env.state = ENV_IDLE;
-    tape_player.env.value = 0.0f;
-    tape_player.env.attack_inc = 1 / (0.001f * AUDIO_SAMPLE_RATE);
-    tape_player.env.decay_inc = 1 / (0.5f * AUDIO_SAMPLE_RATE);
-    tape_player.env.sustain = 0.0f;
-
     // parameters
     tape_player.params.pitch_factor = 1.0f;
+    smoother_init(&tape_player.pitch_smooth, SMOOTHER_ONE_POLE, 1.0f, TAPE_PITCH_GLIDE_MS, AUDIO_SAMPLE_RATE / TAPE_PITCH_RAMP_FRAMES, 1e-5f);
     tape_player.params.env_attack = 0.0f; // normalized env values
     tape_player.params.env_decay = 0.2f;  // normalized env values
+    envelope_set_attack_norm(&tape_player.params.env_rates, tape_player.params.env_attack);
+    envelope_set_decay_norm(&tape_player.params.env_rates, tape_player.params.env_decay);
 
     tape_player.params.reverse = false;     // default to forward playback
     tape_player.params.cyclic_mode = false; // default to oneshot mode
+    tape_player_set_interp(TAPE_INTERP_SINC); // the best the build has
+    tape_player.params.decimation = 1;        // until the first parameters arrive
+
+#ifdef CONFIG_TAPE_PREROLL
+    tape_player_arm_capture();
+#endif
+
+#ifdef CONFIG_TAPE_OVERDUB
+    memset(&tape_player.overdub, 0, sizeof(tape_player.overdub));
+    tape_player.overdub.write_idx = UINT32_MAX;
+#endif
 
     return 0;
 }
@@ -122,6 +270,7 @@ static void compute_grit() {
     // logarithmic curve: fast start, slow rise at the end
     // log10(1 + 9*g): +1 prevents log(0); *9 scales so log10(10)=1 at g=1; dividing by log10(10) converts natural log to base-10
     tape_player.params.grit = logf(1.0f + 9.0f * g) / logf(10.0f); // maps 0..1 -> 0..1
+    tape_player.params.grit_hold_q14 = (int32_t) (tape_player.params.grit * MAX_GRIT_ON_MAX_DECIMATION * 16384.0f);
 }
 
 // Swap record/playback buffer pointers. The just-recorded buffer becomes the
@@ -132,8 +281,27 @@ static void swap_tape_buffers() {
     tape_player.playback_buf = tape_player.record_buf;
     tape_player.record_buf = temp;
 
+    // the old take is retired instead of released, a crossfade may still read it. Only one take can be retired at a time.
+    tape_reclaim_retired_take(true);
+    tape_player.retired_take = tape_player.record_buf->mem;
+    tape_worker_cancel(tape_player.retired_take);
+    tape_player.record_buf->mem = NULL;
+    tape_release_take(tape_player.record_buf);
+
+    // voices still playing the old take fade out, the voice that triggered the swap picks up the new take
+    for (uint32_t i = 0; i < CONFIG_TAPE_NUM_VOICES; i++) {
+        if (tape_player.voices[i].play_state == PLAY_PLAYING)
+            voice_release(&tape_player.voices[i]);
+    }
+#ifdef CONFIG_ENABLE_GRANULAR
+    granular_release(&tape_player.granular);
+#endif
+
     tape_player.tape_recordhead = 0;
     tape_player.swap_bufs_pending = false;
+#ifdef CONFIG_TAPE_ANALYSIS
+    tape_player_publish_analysis();
+#endif
 
     // now that the new playback buffer holds the recorded audio at the respective decimation factor,
     // compute grit factor from this and save as parameter to be used in other dsp related functions.
@@ -148,6 +316,7 @@ static void tape_clear_slices(tape_buffer_t* buf) {
         buf->slice_positions[i] = 0;
     }
     buf->num_slices = 0;
+    buf->slices_snapped = false;
 }
 
 // Resolve the normalized slice_pos parameter (0–1) to a Q48.16 playhead position.
@@ -176,26 +345,69 @@ static int tape_buf_get_slice_start_pos_q48_16(uint64_t* out_pos) {
 
 // prototypes for FSM event handling
 static void play_fsm_event(tape_event_t evt);
-static void rec_fsm_event(tape_event_t evt);
+static void rec_fsm_event(tape_event_t evt, uint32_t late_frames);
+
+// Voice for a new note: a stopped voice, else the oldest releasing voice, else the oldest voice, which gets stolen.
+// A stolen voice is retriggered, so its old playhead crossfades into the new note.
+static tape_voice_t* tape_alloc_voice(void) {
+    tape_voice_t* oldest = &tape_player.voices[0];
+    tape_voice_t* oldest_releasing = NULL;
+
+    for (uint32_t i = 0; i < CONFIG_TAPE_NUM_VOICES; i++) {
+        tape_voice_t* v = &tape_player.voices[i];
+        if (v->play_state == PLAY_STOPPED)
+            return v;
+        // sequence numbers wrap, compare distances to the current one
+        if (v->releasing && (!oldest_releasing || tape_player.note_seq - v->note_seq > tape_player.note_seq - oldest_releasing->note_seq))
+            oldest_releasing = v;
+        if (tape_player.note_seq - v->note_seq > tape_player.note_seq - oldest->note_seq)
+            oldest = v;
+    }
+    return oldest_releasing ? oldest_releasing : oldest;
+}
 
-// Playback FSM. States: PLAY_STOPPED <-> PLAY_PLAYING
+// Playhead of a note-on: the selected slice, or the take end when reversed.
+// Returns true if the note starts on a snapped slice marker, which needs only a short fade.
+static bool voice_set_start_pos(tape_voice_t* v) {
+    if (!tape_player.params.reverse) {
+        // aquire playback starting position depending on current set slice.
+        // Takes are trimmed to their valid length, so a slice too close to the end falls back to the take start.
+        if (tape_buf_get_slice_start_pos_q48_16(&v->pos_q48_16) < 0) {
+            v->pos_q48_16 = 1 << 16;
+            return false;
+        }
+        return tape_player.playback_buf->slices_snapped;
+    } else {
+        // if reverse, start at the end of the buffer, minus 4 samples for hermite safety.
+        // TODO: for now ignore slices when reverse. This has to be implemented with thought.
+        // what to do with the slices?
+        v->pos_q48_16 = ((uint64_t) (tape_player.playback_buf->valid_samples - 1)) << 16;
+        return false;
+    }
+}
+
+// Voice FSM. States: PLAY_STOPPED <-> PLAY_PLAYING
 //
 // STOPPED + PLAY:  swap buffers if pending, position playhead at selected slice
 //                  (or buffer end for reverse), arm fade-in and envelope, go PLAYING.
-// PLAYING + PLAY:  retrigger — capture current region into crossfade temp buffer,
+// PLAYING + PLAY:  retrigger (or steal) — capture current region into crossfade temp buffer,
 //                  optionally swap buffers, reposition playhead, start retrigger xfade.
 // PLAYING + STOP:  immediately go STOPPED.
-static void play_fsm_event(tape_event_t evt) {
-    switch (tape_player.play_state) {
+static void voice_fsm_event(tape_voice_t* v, tape_event_t evt) {
+    switch (v->play_state) {
     case PLAY_STOPPED:
         if (evt == TAPE_EVT_PLAY) {
             /* ----- PLAY FROM IDLE ----- */
 
+            // crossfades are not rendered while stopped, a stale one must not pin a retired take or resume later
+            v->xfade_retrig.active = false;
+            v->xfade_cyclic.active = false;
+
             // each time a play event is triggered, switch buffers if pending.
             if (tape_player.swap_bufs_pending) {
                 swap_tape_buffers();
                 // only play can really prepare for next record.
-                rec_fsm_event(TAPE_EVT_SWAP_DONE);
+                rec_fsm_event(TAPE_EVT_SWAP_DONE, 0);
             }
 
             if (tape_player.playback_buf->valid_samples < 4) {
@@ -203,30 +415,27 @@ static void play_fsm_event(tape_event_t evt) {
                 return;
             }
 
-            if (!tape_player.params.reverse) {
-                // aquire playback starting position depending on current set slice
-                tape_buf_get_slice_start_pos_q48_16(&tape_player.pos_q48_16);
-            } else {
-                // if reverse, start at the end of the buffer, minus 4 samples for hermite safety.
-                // TODO: for now ignore slices when reverse. This has to be implemented with thought.
-                // what to do with the slices?
-                tape_player.pos_q48_16 = ((uint64_t) (tape_player.playback_buf->valid_samples - 1)) << 16;
-            }
+            voice_attach_take(v);
+            bool clean_start = voice_set_start_pos(v);
 
             // Init Fade In
-            tape_player.fade_in.pos_q48_16 = 0;
-            tape_player.fade_in.active = true;
+            v->fade_in.step_q16 = clean_start ? FADE_SNAPPED_STEP_Q16 : FADE_IN_OUT_STEP_Q16;
+            v->fade_in.pos_q48_16 = 0;
+            v->fade_in.fade_acc_q16 = 0;
+            v->fade_in.active = true;
 
             // Ensure Fade Out is clean
-            tape_player.fade_out.active = false;
-            tape_player.fade_out.pos_q48_16 = 0; // this is not needed. Set anyway.
-            tape_player.fade_out.fade_acc_q16 = 0;
+            v->releasing = false;
+            v->fade_out.active = false;
+            v->fade_out.pos_q48_16 = 0; // this is not needed. Set anyway.
+            v->fade_out.fade_acc_q16 = 0;
 
-            envelope_set_attack_norm(&tape_player.env, tape_player.params.env_attack);
-            envelope_set_decay_norm(&tape_player.env, tape_player.params.env_decay);
-            envelope_note_on(&tape_player.env);
+            v->env.attack_inc = tape_player.params.env_rates.attack_inc;
+            v->env.decay_inc = tape_player.params.env_rates.decay_inc;
+            envelope_note_on(&v->env);
 
-            tape_player.play_state = PLAY_PLAYING;
+            v->note_seq = ++tape_player.note_seq;
+            v->play_state = PLAY_PLAYING;
         }
         break;
 
@@ -234,76 +443,131 @@ static void play_fsm_event(tape_event_t evt) {
         if (evt == TAPE_EVT_PLAY) {
             /* ----- RETRIGGER PLAY ----- */
 
-            // copy upcoming xfade.len samples starting at current phase
-            // we need to start from one sample before the current phase for hermite interpolation
-            uint32_t idx_at_retrig = (uint32_t) (tape_player.pos_q48_16 >> 16);
-            uint32_t start_idx_xfade = idx_at_retrig > 0 ? idx_at_retrig - 1 : 0;
-            uint32_t max_needed_xfade = tape_player.xfade_retrig.len + 3; // +3 for hermite interpolation safety (idx-1..idx+2)
-
-            // number of samples available for crossfade starting from start_idx
-            uint32_t available = tape_player.playback_buf->valid_samples - start_idx_xfade;
-
-            // if available samples are less than max_needed, we have to adjust crossfade length and fade LUT access accordingly, otherwise we might read out of bounds of the playback buffer (if start_idx + max_needed exceeds valid_samples), or the fade LUT (if we use max_needed as xfade.len for LUT access, but there are not enough valid samples in temp buffer).
-            tape_player.xfade_retrig.temp_buf_valid_samples = min_u32(available, max_needed_xfade);
-
-            // Save a pointer into the current playback buffer at the crossfade start position.
-            // This has to happen before any buffer swap, since swap_tape_buffers() re-assigns playback_buf.
-            // After the swap the old playback buffer becomes the record buffer, but its contents remain valid for the duration of the crossfade
-            int16_t* old_buf_l = &tape_player.playback_buf->ch[0][start_idx_xfade];
-            int16_t* old_buf_r = &tape_player.playback_buf->ch[1][start_idx_xfade];
+            // The outgoing audio keeps playing from the current playhead position of the old take while the crossfade runs.
+            // The crossfade copies the voice's reader, so it keeps reading the old take even after a buffer swap.
+            crossfade_t* xfade = &v->xfade_retrig;
+            tape_reader_attach(&xfade->buf_b, &v->reader.store);
+            xfade->buf_b_valid_samples = v->valid_samples;
+            xfade->pos_q48_16 = v->pos_q48_16;
+            xfade->reverse = tape_player.params.reverse;
 
             if (tape_player.swap_bufs_pending) {
-                swap_tape_buffers();
-                rec_fsm_event(TAPE_EVT_SWAP_DONE);
-            }
+                // the loop crossfade of the old take would blend its tail into the new take, the retrigger crossfade replaces it
+                v->xfade_cyclic.active = false;
 
-            tape_player.xfade_retrig.buf_b_ptr_l = old_buf_l;
-            tape_player.xfade_retrig.buf_b_ptr_r = old_buf_r;
-
-            if (!tape_player.params.reverse) {
-                // aquire playback starting position depending on current set slice
-                tape_buf_get_slice_start_pos_q48_16(&tape_player.pos_q48_16);
-            } else {
-                // if reverse, start at the end of the buffer, minus 4 samples for hermite safety.
-                // TODO: for now ignore slices when reverse. This has to be implemented with thought.
-                // what to do with the slices?
-                tape_player.pos_q48_16 = ((uint64_t) (tape_player.playback_buf->valid_samples - 1)) << 16;
+                swap_tape_buffers();
+                rec_fsm_event(TAPE_EVT_SWAP_DONE, 0);
+
+                if (tape_player.playback_buf->valid_samples < 4) {
+                    // nothing to play in the new take
+                    xfade->active = false;
+                    v->play_state = PLAY_STOPPED;
+                    return;
+                }
             }
 
-            // ph_b holdes the phase for crossfade buffer
-            tape_player.xfade_retrig.pos_q48_16 = 1 << 16; // start at sample 1
-            tape_player.xfade_retrig.fade_acc_q16 = 0;
-            tape_player.xfade_retrig.active = true;
-            tape_player.xfade_retrig.len = FADE_XFADE_RETRIG_LEN;
+            voice_attach_take(v);
+            bool clean_start = voice_set_start_pos(v);
 
-            tape_player.fade_in.active = true;
+            // a clean start only has to hide the cut of the old playhead, which a short crossfade does
+            xfade->fade_acc_q16 = 0;
+            xfade->active = true;
+            xfade->len = clean_start ? FADE_SNAPPED_LEN : FADE_XFADE_RETRIG_LEN;
+            xfade->step_q16 = clean_start ? FADE_SNAPPED_STEP_Q16 : FADE_XFADE_RETRIG_STEP_Q16;
 
-            // uint32_t base_ratio_q16 = ((uint32_t) (FADE_LUT_LEN - 1) << 16) / (tape_player.xfade_retrig.temp_buf_valid_samples - 1);
-            // tape_player.xfade_retrig.base_ratio_q16 = base_ratio_q16;
+            // the retrigger crossfade is the fade-in of the new audio. A running fade-out belongs to the old playhead.
+            v->fade_in.active = false;
+            v->releasing = false;
+            v->fade_out.active = false;
+            v->fade_out.fade_acc_q16 = 0;
 
-            envelope_set_attack_norm(&tape_player.env, tape_player.params.env_attack);
-            envelope_set_decay_norm(&tape_player.env, tape_player.params.env_decay);
-            envelope_note_on(&tape_player.env);
+            v->env.attack_inc = tape_player.params.env_rates.attack_inc;
+            v->env.decay_inc = tape_player.params.env_rates.decay_inc;
+            envelope_note_on(&v->env);
 
+            v->note_seq = ++tape_player.note_seq;
         } else if (evt == TAPE_EVT_STOP) {
-            // envelope_note_off(&tape_player.env);
-            tape_player.play_state = PLAY_STOPPED;
+            // envelope_note_off(&v->env);
+            v->play_state = PLAY_STOPPED;
         }
         break;
     }
 }
 
+// Playback FSM: PLAY starts a note on a free or stolen voice, STOP stops all voices.
+static void play_fsm_event(tape_event_t evt) {
+    if (evt == TAPE_EVT_PLAY) {
+        voice_fsm_event(tape_alloc_voice(), evt);
+    } else {
+        for (uint32_t i = 0; i < CONFIG_TAPE_NUM_VOICES; i++)
+            voice_fsm_event(&tape_player.voices[i], evt);
+    }
+}
+
+#ifdef CONFIG_TAPE_MIPMAP
+// Lay out as many mip levels of buf's take as fit into room bytes at mem. Returns the bytes they take.
+static uint32_t tape_mip_layout(tape_buffer_t* buf, uint8_t* mem, uint32_t room) {
+    uint32_t used = 0;
+    memset(&buf->mip, 0, sizeof(buf->mip));
+
+    for (uint32_t k = 1; k <= TAPE_MIP_MAX_LEVELS; k++) {
+        // silent frames in front for the taps behind the playhead, the guard frames behind
+        uint32_t bytes = (tape_mip_frames(buf->valid_samples, k) + TAPE_INTERP_HALF - 1 + TAPE_STORE_GUARD_FRAMES) * sizeof(uint32_t);
+        if (used + bytes > room)
+            break;
+        buf->mip.level[k] = (uint32_t*) (mem + used) + TAPE_INTERP_HALF - 1;
+        buf->mip.num_levels = k;
+        used += bytes;
+    }
+    return used;
+}
+#endif
+
 // Save valid_samples and set swap_bufs_pending. Called while recording has already stopped,
 // before the buffer swap.
 static inline void finalize_rec_buf() {
     tape_player.record_buf->valid_samples = tape_player.tape_recordhead;
+    if (tape_player.record_buf->mem) {
+        tape_buffer_t* buf = tape_player.record_buf;
+
+        // the guard frames are read by the interpolator, silence them instead of leaving stale data of an older take
+        static const int16_t silence[TAPE_STORE_GUARD_FRAMES * 2] = {0};
+        tape_codec_write(&buf->store, &tape_player.rec_encoder, buf->valid_samples, silence, TAPE_STORE_GUARD_FRAMES);
+
+        // hand the unrecorded tail back to the pool, the next take can use it. The mip levels keep what they need of it.
+        uint32_t used = buf->valid_samples;
+#ifdef CONFIG_TAPE_PREROLL
+        // a take that starts further into its store keeps the frames in front of it, one that wraps around keeps all
+        used = buf->store.start + used < buf->size ? buf->store.start + used : buf->size;
+#endif
+        uint32_t bytes = tape_store_bytes_needed(buf->size + TAPE_STORE_GUARD_FRAMES, used);
+#ifdef CONFIG_TAPE_MIPMAP
+        bytes = (bytes + TAPE_POOL_ALIGN - 1) & ~(TAPE_POOL_ALIGN - 1);
+        bytes += tape_mip_layout(buf, (uint8_t*) buf->mem + bytes, buf->mem_bytes - bytes);
+#endif
+        tape_pool_trim(buf->mem, bytes);
+
+#ifdef CONFIG_TAPE_LOOP_SEARCH
+        // the whole take loops until the worker found a loop point
+        buf->loop_end = buf->valid_samples;
+        buf->loop_xfade_len = FADE_XFADE_CYCLIC_LEN;
+#endif
+#if defined(CONFIG_TAPE_SLICE_SNAPPING) || defined(CONFIG_TAPE_MIPMAP) || defined(CONFIG_TAPE_ANALYSIS) || defined(CONFIG_TAPE_LOOP_SEARCH)
+        // slices are snapped, levels measured, the loop point searched and mip levels built in the worker task,
+        // see tape_player_sync_worker()
+        tape_player.worker_take = buf->take_id;
+#endif
+    }
     tape_player.tape_recordhead = 0;
     tape_player.swap_bufs_pending = true;
 }
 
-// Set decimation, clear slices, and seed slice[0]=1 (Hermite lower bound).
-// Called after the buffer swap, while the record buffer is idle.
+// Set decimation, reset the record decimator and encoder, clear slices, and seed slice[0]=1 (Hermite lower bound).
+// Called after the buffer swap, while the record buffer is idle. Memory is claimed with the first recorded block,
+// see tape_player_claim_rec_take(), so that a take retired by the swap can be freed first.
 static inline void prepare_next_rec_buf() {
+    tape_release_take(tape_player.record_buf);
+
     // apply decimation to recording buffer. This will be reach over to playback buffer by buffer swapping
     // prepare next rec buffer
 #ifdef DECIMATION_FIXED
@@ -312,11 +576,49 @@ static inline void prepare_next_rec_buf() {
     tape_player.record_buf->decimation = tape_player.params.decimation;
 #endif
 
+#ifdef CONFIG_TAPE_REC_ALIASING
+    decimator_init(&tape_player.rec_decimator, tape_player.record_buf->decimation, DECIMATOR_ALIASED);
+#else
+    decimator_init(&tape_player.rec_decimator, tape_player.record_buf->decimation, DECIMATOR_FILTERED);
+#endif
+    tape_encoder_reset(&tape_player.rec_encoder);
+#ifdef CONFIG_TAPE_ONSET_SLICING
+    onset_detector_init(&tape_player.onset_detector);
+#endif
+
     tape_clear_slices(tape_player.record_buf);
     tape_player.record_buf->slice_positions[0] = 1; // always start at 1 for Hermite
     tape_player.record_buf->num_slices = 1;
 }
 
+#ifdef CONFIG_TAPE_PREROLL
+// Let the take start TAPE_PREROLL_MS before the record gate, as far as the capture reaches back. Only frame 0 of the take
+// moves back into the captured input, nothing is copied. Recording goes on where the capture was, the gate lies
+// late_frames input frames behind it.
+static inline void commit_preroll(uint32_t late_frames) {
+    tape_buffer_t* buf = tape_player.record_buf;
+    uint32_t dec = buf->decimation > 0 ? buf->decimation : 1;
+    uint32_t late = late_frames / dec;
+    if (late > tape_player.capture_frames)
+        late = tape_player.capture_frames;
+    uint32_t pre = (uint32_t) (TAPE_PREROLL_MS * AUDIO_SAMPLE_RATE / 1000) / dec;
+    if (pre > tape_player.capture_frames - late)
+        pre = tape_player.capture_frames - late;
+    if (pre > buf->size / 2)
+        pre = buf->size / 2;
+
+    uint32_t head = tape_player.tape_recordhead;
+    uint32_t back = pre + late;
+    buf->store.start = head >= back ? head - back : head + buf->store.ring - back;
+    tape_player.tape_recordhead = back;
+
+#ifdef CONFIG_TAPE_ONSET_SLICING
+    // onsets count from the gate on
+    onset_detector_init(&tape_player.onset_detector);
+#endif
+}
+#endif
+
 // Recording FSM. States: REC_IDLE -> REC_RECORDING -> REC_DONE -> REC_IDLE
 //                                               \-> REC_REREC -> REC_RECORDING
 //
@@ -325,13 +627,24 @@ static inline void prepare_next_rec_buf() {
 // RECORDING + RECORD_DONE: finalise buffer, wait for swap (REC_DONE).
 // DONE + SWAP_DONE:        swap complete, back to IDLE.
 // REREC + SWAP_DONE:       swap complete, prepare buffer, resume recording.
-static void rec_fsm_event(tape_event_t evt) {
+//
+// late_frames: input frames recorded since the gate of a RECORD event. With the pre-roll the take starts on the gate
+// frame, otherwise with the next block. A take ends with the block the gate came in.
+static void rec_fsm_event(tape_event_t evt, uint32_t late_frames) {
     switch (tape_player.rec_state) {
     case REC_IDLE:
         if (evt == TAPE_EVT_RECORD) {
+#ifdef CONFIG_TAPE_PREROLL
+            // the buffer was prepared when it went idle and has been capturing since
+            commit_preroll(late_frames);
+            tape_player.rec_state = REC_RECORDING;
+            tape_player_set_slice(late_frames); // a slice on the gate, behind the pre-roll
+#else
+            (void) late_frames;
             prepare_next_rec_buf();
 
             tape_player.rec_state = REC_RECORDING;
+#endif
         }
         break;
 
@@ -352,6 +665,9 @@ static void rec_fsm_event(tape_event_t evt) {
         // wait for buffer so be swapped before allowing to record again.
         if (evt == TAPE_EVT_SWAP_DONE) {
             tape_player.rec_state = REC_IDLE;
+#ifdef CONFIG_TAPE_PREROLL
+            tape_player_arm_capture();
+#endif
         }
         break;
     case REC_REREC:
@@ -365,6 +681,140 @@ static void rec_fsm_event(tape_event_t evt) {
     }
 }
 
+#ifdef CONFIG_TAPE_PREROLL
+// Prepare the idle record buffer to capture the input from now on, see commit_preroll().
+void tape_player_arm_capture(void) {
+    prepare_next_rec_buf();
+    tape_player.tape_recordhead = 0;
+    tape_player.capture_frames = 0;
+}
+#endif
+
+// Claim the largest free pool region for the take about to be recorded, at most TAPE_MAX_TAKE_PERCENT of the pool,
+// so the next take can be recorded while this one plays. Called by the recorder before it writes the first frame.
+// Returns false while the retired take is still pinned by a crossfade (the recorder drops the block then),
+// or if the pool is exhausted, which aborts the recording.
+bool tape_player_claim_rec_take(void) {
+    tape_buffer_t* buf = tape_player.record_buf;
+    if (tape_store_is_valid(&buf->store))
+        return true;
+    if (!tape_reclaim_retired_take(false))
+        return false;
+
+    uint32_t bytes;
+    void* mem = tape_pool_claim_largest(tape_pool_size() / 100 * TAPE_MAX_TAKE_PERCENT, &bytes);
+#ifdef CONFIG_TAPE_MIPMAP
+    // recording stops short of the region end, so that the mip levels fit behind the take
+    uint32_t frames = tape_store_frames_for_bytes(bytes - bytes / 100 * TAPE_MIP_RESERVE_PERCENT);
+#else
+    uint32_t frames = tape_store_frames_for_bytes(bytes);
+#endif
+    if (!mem || frames <= TAPE_STORE_GUARD_FRAMES) {
+        if (mem)
+            tape_pool_release(mem);
+        tape_player.rec_state = REC_IDLE;
+        return false;
+    }
+
+    buf->mem = mem;
+    buf->mem_bytes = bytes;
+    tape_store_assign(&buf->store, mem, frames);
+    buf->size = frames - TAPE_STORE_GUARD_FRAMES;
+    buf->take_id = ++tape_player.take_seq;
+    return true;
+}
+
+// Tape buffer holding take take_id, NULL if that take is gone.
+static tape_buffer_t* tape_find_take(uint32_t take_id) {
+    if (take_id == 0)
+        return NULL;
+    if (tape_buf_a.take_id == take_id)
+        return &tape_buf_a;
+    if (tape_buf_b.take_id == take_id)
+        return &tape_buf_b;
+    return NULL;
+}
+
+#ifdef CONFIG_TAPE_LOOP_SEARCH
+// Loop buf from frame 1 to loop_end in cyclic mode, with a crossfade of xfade_len output frames over the wrap.
+// Voices playing the take loop there from now on.
+void tape_player_set_loop(tape_buffer_t* buf, uint32_t loop_end, uint32_t xfade_len) {
+    buf->loop_end = loop_end;
+    buf->loop_xfade_len = xfade_len;
+    for (uint32_t i = 0; i < CONFIG_TAPE_NUM_VOICES; i++) {
+        tape_voice_t* v = &tape_player.voices[i];
+        if (v->play_state == PLAY_PLAYING && tape_store_base(&v->reader.store) == buf->mem)
+            voice_set_loop(v, buf);
+    }
+}
+#endif
+
+#ifdef CONFIG_TAPE_ANALYSIS
+// Hand the analysis of the playback take to the other tasks. The sequence number is odd while the copy is written,
+// readers retry then, see tape_player_get_analysis(). Audio task only, it never waits.
+void tape_player_publish_analysis(void) {
+    tape_player.analysis_seq++;
+    __DMB(); // odd sequence before the copy
+    tape_player.analysis = tape_player.playback_buf->analysis;
+    __DMB(); // copy before the even sequence
+    tape_player.analysis_seq++;
+}
+#endif
+
+// Exchange jobs with the worker task, once per audio block: apply the results of a finished job and hand over
+// the next finished take. Results of a take that was retired meanwhile are dropped, its region is freed with the job.
+void tape_player_sync_worker(void) {
+    tape_job_t* job = tape_worker_done();
+    if (job) {
+        tape_buffer_t* buf = tape_find_take(job->take_id);
+#ifdef CONFIG_TAPE_SLICE_SNAPPING
+        if (buf && buf->num_slices == job->num_slices) {
+            memcpy(buf->slice_positions, job->slice_positions, job->num_slices * sizeof(uint32_t));
+            buf->slices_snapped = true;
+        }
+#endif
+#ifdef CONFIG_TAPE_MIPMAP
+        if (buf)
+            buf->mip.ready = job->mip.ready;
+#endif
+#ifdef CONFIG_TAPE_LOOP_SEARCH
+        if (buf && !buf->overdubbed)
+            tape_player_set_loop(buf, job->loop_end, job->loop_xfade_len);
+#endif
+#ifdef CONFIG_TAPE_ANALYSIS
+        if (buf) {
+            buf->analysis = job->analysis;
+            buf->analysis.stale = buf->overdubbed;
+            if (buf == tape_player.playback_buf)
+                tape_player_publish_analysis();
+        }
+#endif
+        tape_worker_release(job);
+
+        if (tape_player.worker_retired_take) {
+            tape_pool_release(tape_player.worker_retired_take);
+            tape_player.worker_retired_take = NULL;
+        }
+    }
+
+    if (tape_player.worker_take && (job = tape_worker_acquire())) {
+        tape_buffer_t* buf = tape_find_take(tape_player.worker_take);
+        if (buf) {
+            job->take_id = buf->take_id;
+            tape_reader_attach(&job->reader, &buf->store);
+            job->valid_samples = buf->valid_samples;
+            job->decimation = buf->decimation;
+            memcpy(job->slice_positions, buf->slice_positions, buf->num_slices * sizeof(uint32_t));
+            job->num_slices = buf->num_slices;
+#ifdef CONFIG_TAPE_MIPMAP
+            job->mip = buf->mip;
+#endif
+            tape_worker_submit(job);
+        }
+        tape_player.worker_take = 0;
+    }
+}
+
 /* ----- PUBLIC API ----- */
 
 void tape_player_play(void) {
@@ -375,35 +825,110 @@ void tape_player_stop_play(void) {
     play_fsm_event(TAPE_EVT_STOP);
 }
 
-void tape_player_record(void) {
-    rec_fsm_event(TAPE_EVT_RECORD);
+void tape_player_stop_voice(tape_voice_t* v) {
+    voice_fsm_event(v, TAPE_EVT_STOP);
+}
+
+void tape_player_record(uint32_t late_frames) {
+    rec_fsm_event(TAPE_EVT_RECORD, late_frames);
 }
 
 void tape_player_stop_record(void) {
-    rec_fsm_event(TAPE_EVT_RECORD_DONE);
+    rec_fsm_event(TAPE_EVT_RECORD_DONE, 0);
 }
 
-void tape_player_set_slice() {
+// Add a slice late_frames input frames behind the record head. Called from Gate 4 and the onset detector, both append
+// in recording order, so a marker at or before the last one is a duplicate and dropped.
+void tape_player_set_slice(uint32_t late_frames) {
     if (tape_player.rec_state == REC_RECORDING) {
-        uint32_t current_rec_pos = tape_player.tape_recordhead;
+        uint32_t dec = tape_player.record_buf->decimation > 0 ? tape_player.record_buf->decimation : 1;
+        uint32_t late = late_frames / dec;
+        if (late > tape_player.tape_recordhead)
+            late = tape_player.tape_recordhead;
+        uint32_t current_rec_pos = tape_player.tape_recordhead - late;
         uint32_t num_slices = tape_player.record_buf->num_slices;
-        if (num_slices < MAX_NUM_SLICES) {
+        if (num_slices < MAX_NUM_SLICES && current_rec_pos > tape_player.record_buf->slice_positions[num_slices - 1]) {
             tape_player.record_buf->slice_positions[num_slices] = current_rec_pos;
             tape_player.record_buf->num_slices++;
         }
     }
 }
 
+// Overdub starts on the next frame the newest voice plays, see tape_overdub_prepare().
+void tape_player_set_overdub(bool on) {
+#ifdef CONFIG_TAPE_OVERDUB
+    if (tape_player.overdub.enabled == on)
+        return;
+    tape_player.overdub.enabled = on;
+    tape_player.overdub.write_idx = UINT32_MAX;
+#else
+    (void) on;
+#endif
+}
+
+// Select the interpolator of the playheads, e.g. per patch. Sinc falls back to Hermite if the build has no sinc table.
+void tape_player_set_interp(tape_interp_t interp) {
+#ifndef CONFIG_TAPE_SINC_TAPS
+    interp = TAPE_INTERP_HERMITE;
+#endif
+    tape_player.params.interp = interp;
+}
+
 // pitch_ui * pitch_cv: UI knob and V/Oct CV combine multiplicatively.
-void tape_player_set_params(struct param_cache param_cache) {
-    tape_player.params.pitch_factor = param_cache.pitch_ui * param_cache.pitch_cv;
-    tape_player.params.env_attack = param_cache.env_attack;
-    tape_player.params.env_decay = param_cache.env_decay;
-    tape_player.params.reverse = param_cache.reverse_mode;
-    tape_player.params.cyclic_mode = param_cache.cyclic_mode;
-    tape_player.params.decimation = param_cache.decimation;
-    tape_player.params.slice_pos = param_cache.slice_pos;
+// Takes over the parameters in changed, a mask of PARAM_BIT()s from param_cache_fetch(). The others keep their values.
+void tape_player_set_params(const struct param_cache* param_cache, uint32_t changed) {
+    if (changed & (PARAM_BIT(PARAM_PITCH_CV) | PARAM_BIT(PARAM_PITCH_UI))) {
+#ifdef CONFIG_TAPE_TIME_STRETCH
+        // the pitch pot sets the speed, V/Oct alone the pitch
+        tape_player.params.pitch_factor = param_cache->pitch_cv;
+        tape_player.params.stretch_speed = param_cache->pitch_ui;
+#else
+        tape_player.params.pitch_factor = param_cache->pitch_ui * param_cache->pitch_cv;
+#endif
+        smoother_set_target(&tape_player.pitch_smooth, tape_player.params.pitch_factor);
+    }
+    // the rates cost a powf() each, better here than at every note on
+    if (changed & PARAM_BIT(PARAM_ENV_ATTACK)) {
+        tape_player.params.env_attack = param_cache->env_attack;
+        envelope_set_attack_norm(&tape_player.params.env_rates, param_cache->env_attack);
+    }
+    if (changed & PARAM_BIT(PARAM_ENV_DECAY)) {
+        tape_player.params.env_decay = param_cache->env_decay;
+        envelope_set_decay_norm(&tape_player.params.env_rates, param_cache->env_decay);
+    }
+    if (changed & (PARAM_BIT(PARAM_REVERSE) | PARAM_BIT(PARAM_CYCLIC) | PARAM_BIT(PARAM_DECIMATION))) {
+        tape_player.params.reverse = param_cache->reverse_mode;
+        tape_player.params.cyclic_mode = param_cache->cyclic_mode;
+        tape_player.params.decimation = param_cache->decimation;
+    }
+    if (changed & PARAM_BIT(PARAM_SLICE_POS)) {
+        tape_player.params.slice_pos = param_cache->slice_pos;
+        tape_player.params.granular.slice_pos = param_cache->slice_pos;
+    }
+    if (changed & PARAM_BIT(PARAM_OVERDUB))
+        tape_player_set_overdub(param_cache->overdub);
+    if (changed & PARAM_BIT(PARAM_OVERDUB_FEEDBACK))
+        tape_player.params.overdub_feedback = param_cache->overdub_feedback;
+    if (changed & (PARAM_BIT(PARAM_GRAIN_DENSITY) | PARAM_BIT(PARAM_GRAIN_SIZE))) {
+        tape_player.params.granular.density = param_cache->grain_density;
+        tape_player.params.granular.size_ms = param_cache->grain_size_ms;
+    }
+}
+
+#ifdef CONFIG_TAPE_ANALYSIS
+// Levels of the playback take for any task, e.g. normalization or the LEDs. Returns false until the worker measured it.
+// Retries while the audio task publishes, which takes a copy of the struct.
+bool tape_player_get_analysis(tape_analysis_t* out) {
+    uint32_t seq;
+    do {
+        seq = tape_player.analysis_seq;
+        __DMB(); // sequence before the copy
+        *out = tape_player.analysis;
+        __DMB(); // copy before the sequence check
+    } while ((seq & 1) || seq != tape_player.analysis_seq);
+    return out->ready;
 }
+#endif
 
 float tape_player_get_pitch() {
     return tape_player.params.pitch_factor;
@@ -0,0 +1,154 @@
+/**
+ * @file tape_pool.c
+ * @brief Address-ordered region table with split on claim and merge on release.
+ */
+#include "tape_pool.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <string.h>
+
+#include "project_config.h"
+
+typedef struct {
+    uint32_t offset; // from pool start
+    uint32_t len;
+    bool used;
+} tape_region_t;
+
+static uint8_t tape_pool_mem[TAPE_POOL_BYTES] __attribute__((section(".sram1"), aligned(TAPE_POOL_ALIGN)));
+
+// sorted by offset, regions are contiguous and cover the whole pool
+static tape_region_t regions[TAPE_POOL_MAX_REGIONS];
+static uint32_t num_regions;
+
+static inline uint32_t align_down(uint32_t v) {
+    return v & ~(TAPE_POOL_ALIGN - 1);
+}
+
+static inline uint32_t align_up(uint32_t v) {
+    return align_down(v + TAPE_POOL_ALIGN - 1);
+}
+
+static void insert_region(uint32_t at, uint32_t offset, uint32_t len, bool used) {
+    memmove(&regions[at + 1], &regions[at], (num_regions - at) * sizeof(tape_region_t));
+    regions[at] = (tape_region_t) {.offset = offset, .len = len, .used = used};
+    num_regions++;
+}
+
+static void remove_region(uint32_t at) {
+    memmove(&regions[at], &regions[at + 1], (num_regions - at - 1) * sizeof(tape_region_t));
+    num_regions--;
+}
+
+// Mark the first bytes of free region i as used, the rest stays free.
+// If the table is full the whole region is handed out.
+static void* claim_region(uint32_t i, uint32_t bytes) {
+    if (bytes < regions[i].len && num_regions < TAPE_POOL_MAX_REGIONS) {
+        insert_region(i + 1, regions[i].offset + bytes, regions[i].len - bytes, false);
+        regions[i].len = bytes;
+    }
+    regions[i].used = true;
+    return &tape_pool_mem[regions[i].offset];
+}
+
+static int find_region(void* region) {
+    uint32_t offset = (uint32_t) ((uint8_t*) region - tape_pool_mem);
+    for (uint32_t i = 0; i < num_regions; i++) {
+        if (regions[i].offset == offset && regions[i].used)
+            return (int) i;
+    }
+    return -1;
+}
+
+void tape_pool_init(void) {
+    num_regions = 0;
+    insert_region(0, 0, align_down(TAPE_POOL_BYTES), false);
+}
+
+void* tape_pool_claim_largest(uint32_t max_bytes, uint32_t* out_bytes) {
+    int best = -1;
+    for (uint32_t i = 0; i < num_regions; i++) {
+        if (!regions[i].used && (best < 0 || regions[i].len > regions[best].len))
+            best = (int) i;
+    }
+
+    *out_bytes = 0;
+    if (best < 0)
+        return NULL;
+
+    uint32_t bytes = align_down(regions[best].len < max_bytes ? regions[best].len : max_bytes);
+    if (bytes == 0)
+        return NULL;
+
+    void* p = claim_region((uint32_t) best, bytes);
+    *out_bytes = regions[best].len;
+    return p;
+}
+
+void* tape_pool_alloc(uint32_t bytes) {
+    bytes = align_up(bytes);
+
+    int best = -1;
+    for (uint32_t i = 0; i < num_regions; i++) {
+        if (!regions[i].used && regions[i].len >= bytes && (best < 0 || regions[i].len < regions[best].len))
+            best = (int) i;
+    }
+    if (best < 0 || bytes == 0)
+        return NULL;
+
+    return claim_region((uint32_t) best, bytes);
+}
+
+void tape_pool_trim(void* region, uint32_t bytes) {
+    int i = find_region(region);
+    if (i < 0)
+        return;
+
+    bytes = align_up(bytes);
+    if (bytes >= regions[i].len)
+        return;
+
+    uint32_t tail = regions[i].len - bytes;
+    if ((uint32_t) i + 1 < num_regions && !regions[i + 1].used) {
+        // grow the free neighbour backwards
+        regions[i + 1].offset -= tail;
+        regions[i + 1].len += tail;
+    } else if (num_regions < TAPE_POOL_MAX_REGIONS) {
+        insert_region((uint32_t) i + 1, regions[i].offset + bytes, tail, false);
+    } else {
+        return; // table full, keep the region as it is
+    }
+    regions[i].len = bytes;
+}
+
+void tape_pool_release(void* region) {
+    int i = find_region(region);
+    if (i < 0)
+        return;
+
+    regions[i].used = false;
+
+    // merge with free neighbours, so free space never fragments into adjacent pieces
+    if ((uint32_t) i + 1 < num_regions && !regions[i + 1].used) {
+        regions[i].len += regions[i + 1].len;
+        remove_region((uint32_t) i + 1);
+    }
+    if (i > 0 && !regions[i - 1].used) {
+        regions[i - 1].len += regions[i].len;
+        remove_region((uint32_t) i);
+    }
+}
+
+uint32_t tape_pool_size(void) {
+    return align_down(TAPE_POOL_BYTES);
+}
+
+uint32_t tape_pool_largest_free(void) {
+    uint32_t largest = 0;
+    for (uint32_t i = 0; i < num_regions; i++) {
+        if (!regions[i].used && regions[i].len > largest)
+            largest = regions[i].len;
+    }
+    return largest;
+}
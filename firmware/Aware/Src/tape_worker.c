@@ -0,0 +1,423 @@
+/**
+ * @file tape_worker.c
+ * @brief Take post-processing in the worker task: snaps slice markers to zero crossings or energy minima,
+ *        measures the levels of the take, searches its loop point and builds its mip levels.
+ */
+#include "tape_worker.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "arm_math.h"
+#include "project_config.h"
+#include "ressources.h"
+
+typedef enum { STEP_SNAP = 0, STEP_ANALYSE, STEP_LOOP, STEP_MIP, STEP_DONE } worker_step_t;
+
+static tape_job_t job;
+static TaskHandle_t worker;
+
+// Where the worker stands in the pending job, kept from one step to the next.
+static struct {
+    worker_step_t step;
+    uint32_t pos; // next slice, frame or candidate of the step
+#ifdef CONFIG_TAPE_SLICE_SNAPPING
+    uint32_t snap_prev; // last snapped marker, the next one stays behind it
+#endif
+#ifdef CONFIG_TAPE_ANALYSIS
+    int64_t sum[NUM_CHANNELS];
+    int32_t max[NUM_CHANNELS];
+    int32_t min[NUM_CHANNELS];
+    uint32_t slice; // slice the frame at pos belongs to
+#endif
+#ifdef CONFIG_TAPE_LOOP_SEARCH
+    uint32_t loop_first, loop_len, loop_range;
+    q63_t ref_energy, cand_energy;
+    float best_score;
+#endif
+#ifdef CONFIG_TAPE_MIPMAP
+    uint32_t level; // mip level being built
+#endif
+} pass;
+
+void tape_worker_init(TaskHandle_t worker_task) {
+    worker = worker_task;
+    job.state = TAPE_JOB_IDLE;
+}
+
+tape_job_t* tape_worker_acquire(void) {
+    return job.state == TAPE_JOB_IDLE ? &job : NULL;
+}
+
+void tape_worker_submit(tape_job_t* j) {
+    j->cancel = false;
+    __DMB(); // job contents before the state change
+    j->state = TAPE_JOB_PENDING;
+    if (worker)
+        xTaskNotifyGive(worker);
+}
+
+tape_job_t* tape_worker_done(void) {
+    if (job.state != TAPE_JOB_DONE)
+        return NULL;
+    __DMB(); // state before the results
+    return &job;
+}
+
+void tape_worker_release(tape_job_t* j) {
+    j->state = TAPE_JOB_IDLE;
+}
+
+bool tape_worker_reads(const void* mem) {
+    return job.state != TAPE_JOB_IDLE && tape_store_base(&job.reader.store) == mem;
+}
+
+void tape_worker_cancel(const void* mem) {
+    if (tape_worker_reads(mem))
+        job.cancel = true;
+}
+
+#if defined(CONFIG_TAPE_SLICE_SNAPPING) || defined(CONFIG_TAPE_LOOP_SEARCH)
+// Mono sample (L + R) of frame idx.
+static inline int32_t take_mono(tape_reader_t* rd, uint32_t idx) {
+    uint32_t f = tape_reader_frame(rd, idx);
+    return (int32_t) (int16_t) f + (int32_t) (int16_t) (f >> 16);
+}
+#endif
+
+#ifdef CONFIG_TAPE_SLICE_SNAPPING
+/* ----- slice snapping ----- */
+
+// Move the marker at pos to the nearest zero crossing within [lo, hi], else to the quietest frame there.
+// Crossings after pos count double distance, so an onset marker rather moves in front of its transient than into it.
+static uint32_t snap_slice(tape_reader_t* rd, uint32_t pos, uint32_t lo, uint32_t hi) {
+    uint32_t best_zc = UINT32_MAX, best_zc_dist = UINT32_MAX;
+    uint32_t best_min = pos;
+    int32_t best_min_level = INT32_MAX;
+
+    int32_t prev = take_mono(rd, lo - 1);
+    for (uint32_t i = lo; i <= hi; i++) {
+        int32_t cur = take_mono(rd, i);
+
+        if ((prev < 0) != (cur < 0)) {
+            // crossing between i - 1 and i, start on the sample closer to zero
+            uint32_t zc = abs(prev) < abs(cur) ? i - 1 : i;
+            if (zc < lo)
+                zc = lo;
+            uint32_t dist = zc < pos ? pos - zc : 2 * (zc - pos);
+            if (dist < best_zc_dist) {
+                best_zc_dist = dist;
+                best_zc = zc;
+            }
+        }
+
+        if (abs(cur) < best_min_level) {
+            best_min_level = abs(cur);
+            best_min = i;
+        }
+        prev = cur;
+    }
+
+    return best_zc != UINT32_MAX ? best_zc : best_min;
+}
+
+// Snap the markers from pass.pos on, until about budget frames are searched. Returns true once all are snapped.
+static bool snap_slices(tape_job_t* j, uint32_t budget) {
+    if (j->valid_samples < 8)
+        return true;
+
+    uint32_t window = (uint32_t) (SLICE_SNAP_WINDOW_MS * AUDIO_SAMPLE_RATE / 1000) / (j->decimation > 0 ? j->decimation : 1);
+    if (window < 2)
+        window = 2;
+    // playback starts at frame 1 at the earliest and needs 4 frames of take behind the start, see tape_buf_get_slice_start_pos_q48_16()
+    uint32_t last = j->valid_samples - 5;
+
+    uint32_t searched = 0;
+    for (; pass.pos < j->num_slices && searched < budget; pass.pos++) {
+        uint32_t pos = j->slice_positions[pass.pos];
+        if (pos < 1 || pos > last)
+            continue;
+
+        // markers stay in order: the window never reaches back to the previous marker
+        uint32_t lo = pos > window + 1 ? pos - window : 1;
+        if (lo <= pass.snap_prev)
+            lo = pass.snap_prev + 1;
+        uint32_t hi = pos + window < last ? pos + window : last;
+        if (lo > hi)
+            continue;
+
+        j->slice_positions[pass.pos] = snap_slice(&j->reader, pos, lo, hi);
+        pass.snap_prev = j->slice_positions[pass.pos];
+        searched += hi - lo + 1;
+    }
+    return pass.pos >= j->num_slices;
+}
+#endif
+
+#ifdef CONFIG_TAPE_MIPMAP
+/* ----- mip levels ----- */
+
+// Frame idx of mip level k (0: the take itself), silence outside of it.
+static inline uint32_t mip_frame(tape_job_t* j, uint32_t k, int32_t idx) {
+    if (idx < 0 || (uint32_t) idx >= tape_mip_frames(j->valid_samples, k))
+        return 0;
+    return k == 0 ? tape_reader_frame(&j->reader, (uint32_t) idx) : j->mip.level[k][idx];
+}
+
+// Frames [from, to) of level k from level k - 1: the record decimator's half-band, centered on every other frame so that
+// the level does not lag the take. Only the center tap and the odd ones are non-zero.
+static void build_mip_frames(tape_job_t* j, uint32_t k, uint32_t from, uint32_t to) {
+    const int32_t center = HALFBAND_NUM_TAPS / 2;
+    uint32_t* level = j->mip.level[k];
+
+    for (uint32_t n = from; n < to; n++) {
+        int32_t src = 2 * (int32_t) n;
+        uint32_t f = mip_frame(j, k - 1, src);
+        int32_t acc_l = (int16_t) f * halfband_coeffs_q15[center];
+        int32_t acc_r = (int16_t) (f >> 16) * halfband_coeffs_q15[center];
+        for (int32_t i = 1; i <= center; i += 2) {
+            uint32_t a = mip_frame(j, k - 1, src - i);
+            uint32_t b = mip_frame(j, k - 1, src + i);
+            acc_l += ((int16_t) a + (int16_t) b) * halfband_coeffs_q15[center + i];
+            acc_r += ((int16_t) (a >> 16) + (int16_t) (b >> 16)) * halfband_coeffs_q15[center + i];
+        }
+        level[n] = (uint16_t) __SSAT((acc_l + (1 << 14)) >> 15, 16) | ((uint32_t) (uint16_t) __SSAT((acc_r + (1 << 14)) >> 15, 16) << 16);
+    }
+}
+
+// Build up to budget frames of the levels from pass.level on, each from the one below, the first from the take.
+// Returns true once all levels are built.
+static bool build_mip_levels(tape_job_t* j, uint32_t budget) {
+    if (pass.level == 0)
+        pass.level = 1;
+
+    while (pass.level <= j->mip.num_levels && budget > 0) {
+        uint32_t k = pass.level;
+        uint32_t frames = tape_mip_frames(j->valid_samples, k);
+        uint32_t to = frames - pass.pos > budget ? pass.pos + budget : frames;
+        build_mip_frames(j, k, pass.pos, to);
+        budget -= to - pass.pos;
+        pass.pos = to;
+        if (pass.pos < frames)
+            break;
+
+        // silent frames around the level for the interpolator taps
+        uint32_t* level = j->mip.level[k];
+        for (int32_t n = 1; n < TAPE_INTERP_HALF; n++)
+            level[-n] = 0;
+        for (uint32_t n = 0; n < TAPE_STORE_GUARD_FRAMES; n++)
+            level[frames + n] = 0;
+        j->mip.ready = k;
+        pass.level++;
+        pass.pos = 0;
+    }
+    return pass.level > j->mip.num_levels;
+}
+#endif
+
+#ifdef CONFIG_TAPE_ANALYSIS
+/* ----- take analysis ----- */
+
+typedef struct {
+    uint64_t sq[NUM_CHANNELS];
+    uint32_t frames;
+    uint32_t peak;
+} slice_levels_t;
+
+static slice_levels_t slice_acc; // levels of the slice the analysis is in, kept from one step to the next
+
+// Store the levels of slice s and start over for the next one.
+static void close_slice(tape_analysis_t* a, uint32_t s, slice_levels_t* acc) {
+    if (s < MAX_NUM_SLICES) {
+        uint64_t sq = acc->sq[0] > acc->sq[1] ? acc->sq[0] : acc->sq[1];
+        a->slice_peak[s] = (uint16_t) (acc->peak > 32767 ? 32767 : acc->peak);
+        a->slice_rms[s] = acc->frames ? (uint16_t) sqrtf((float) sq / (float) acc->frames) : 0;
+    }
+    memset(acc, 0, sizeof(*acc));
+}
+
+// Start of the slice behind slice s, the end of the take behind the last one.
+static inline uint32_t slice_end(const tape_job_t* j, uint32_t s) {
+    return s + 1 < j->num_slices ? j->slice_positions[s + 1] : j->valid_samples;
+}
+
+// One pass over the take: peak and RMS of every slice, the overview, and the DC offset and the peak around it for the
+// normalization gain. Runs after snapping, the slice levels are those of the snapped markers. Goes on from frame
+// pass.pos for at most budget frames, returns true once the take is through.
+static bool analyse_take(tape_job_t* j, uint32_t budget) {
+    tape_analysis_t* a = &j->analysis;
+    if (pass.pos == 0) {
+        memset(a, 0, sizeof(*a));
+        a->num_slices = j->num_slices;
+        a->norm_gain = 1.0f;
+        for (uint32_t c = 0; c < NUM_CHANNELS; c++) {
+            pass.sum[c] = 0;
+            pass.max[c] = INT16_MIN;
+            pass.min[c] = INT16_MAX;
+        }
+        pass.slice = 0;
+        memset(&slice_acc, 0, sizeof(slice_acc));
+    }
+    if (j->valid_samples == 0)
+        return true;
+
+    uint32_t end = j->valid_samples - pass.pos > budget ? pass.pos + budget : j->valid_samples;
+    for (uint32_t i = pass.pos; i < end; i++) {
+        // the frames in front of the second marker belong to the first slice
+        while (pass.slice < j->num_slices && i >= slice_end(j, pass.slice))
+            close_slice(a, pass.slice++, &slice_acc);
+
+        uint32_t f = tape_reader_frame(&j->reader, i);
+        int32_t ch[NUM_CHANNELS] = {(int16_t) f, (int16_t) (f >> 16)};
+        uint32_t level = 0;
+        for (uint32_t c = 0; c < NUM_CHANNELS; c++) {
+            pass.sum[c] += ch[c];
+            pass.max[c] = ch[c] > pass.max[c] ? ch[c] : pass.max[c];
+            pass.min[c] = ch[c] < pass.min[c] ? ch[c] : pass.min[c];
+            slice_acc.sq[c] += (uint64_t) (ch[c] * ch[c]);
+            uint32_t m = (uint32_t) abs(ch[c]);
+            level = m > level ? m : level;
+        }
+        slice_acc.frames++;
+        slice_acc.peak = level > slice_acc.peak ? level : slice_acc.peak;
+
+        uint32_t bin = (uint32_t) ((uint64_t) i * TAPE_OVERVIEW_POINTS / j->valid_samples);
+        uint8_t o = (uint8_t) (level > 32767 ? 255 : level >> 7);
+        a->overview[bin] = o > a->overview[bin] ? o : a->overview[bin];
+    }
+    pass.pos = end;
+    if (pass.pos < j->valid_samples)
+        return false;
+
+    for (; pass.slice < j->num_slices; pass.slice++)
+        close_slice(a, pass.slice, &slice_acc);
+
+    for (uint32_t c = 0; c < NUM_CHANNELS; c++) {
+        a->dc[c] = (int16_t) (pass.sum[c] / (int64_t) j->valid_samples);
+        int32_t p = pass.max[c] - a->dc[c] > a->dc[c] - pass.min[c] ? pass.max[c] - a->dc[c] : a->dc[c] - pass.min[c];
+        p = p > 32767 ? 32767 : p;
+        a->peak = (uint16_t) p > a->peak ? (uint16_t) p : a->peak;
+    }
+    if (a->peak > 0) {
+        float gain = (float) TAPE_NORM_PEAK / (float) a->peak;
+        a->norm_gain = gain < TAPE_NORM_MAX_GAIN ? gain : TAPE_NORM_MAX_GAIN;
+    }
+    a->ready = true;
+    return true;
+}
+#endif
+
+#ifdef CONFIG_TAPE_LOOP_SEARCH
+/* ----- loop point ----- */
+
+#define LOOP_MATCH_FRAMES (LOOP_MATCH_MS * AUDIO_SAMPLE_RATE / 1000)
+#define LOOP_SEARCH_FRAMES (LOOP_SEARCH_MS * AUDIO_SAMPLE_RATE / 1000)
+
+// mono halves of the frames behind the take start and of the candidates with the frames behind them
+static q15_t loop_ref[LOOP_MATCH_FRAMES];
+static q15_t loop_cand[LOOP_SEARCH_FRAMES + LOOP_MATCH_FRAMES];
+
+// Loop point for cyclic playback: the frame near the take end behind which the take sounds most like behind frame 1,
+// so that the loop can wrap from there to frame 1. Each candidate is scored by the squared difference of the
+// LOOP_MATCH_MS behind it and behind frame 1 relative to their energy, which weighs waveform and slope alike.
+// The cross term is a q15 dot product per candidate, the candidate energy slides along. The better the match,
+// the shorter the crossfade over the wrap. The first step reads the compared frames, each further one scores about
+// budget frames worth of candidates from pass.pos on. Returns true once all are scored.
+static bool find_loop_point(tape_job_t* j, uint32_t budget) {
+    if (pass.loop_range == 0) {
+        uint32_t dec = j->decimation > 0 ? j->decimation : 1;
+        uint32_t len = LOOP_MATCH_FRAMES / dec;
+        uint32_t range = LOOP_SEARCH_FRAMES / dec;
+        // the compared frames and those the crossfade plays stay inside the take
+        uint32_t tail = (LOOP_MATCH_FRAMES > FADE_XFADE_LOOP_LEN ? LOOP_MATCH_FRAMES : FADE_XFADE_LOOP_LEN) / dec + 4;
+
+        j->loop_end = j->valid_samples;
+        j->loop_xfade_len = FADE_XFADE_CYCLIC_LEN;
+        // the loop keeps at least half of the take
+        if (len < 4 || j->valid_samples < 2 * (range + tail))
+            return true;
+
+        uint32_t first = j->valid_samples - tail - range;
+        for (uint32_t k = 0; k < len; k++)
+            loop_ref[k] = (q15_t) (take_mono(&j->reader, 1 + k) >> 1);
+        for (uint32_t k = 0; k < range + len; k++)
+            loop_cand[k] = (q15_t) (take_mono(&j->reader, first + k) >> 1);
+
+        arm_power_q15(loop_ref, len, &pass.ref_energy);
+        arm_power_q15(loop_cand, len, &pass.cand_energy);
+        pass.best_score = LOOP_MATCH_MAX;
+        pass.loop_first = first;
+        pass.loop_len = len;
+        pass.loop_range = range;
+        return false;
+    }
+
+    uint32_t len = pass.loop_len;
+    uint32_t end = pass.pos + (budget / len > 0 ? budget / len : 1);
+    if (end > pass.loop_range)
+        end = pass.loop_range;
+    for (uint32_t c = pass.pos; c < end; c++) {
+        q63_t cross;
+        arm_dot_prod_q15(loop_ref, &loop_cand[c], len, &cross);
+
+        int64_t energy = pass.ref_energy + pass.cand_energy;
+        float score = energy > 0 ? (float) (energy - 2 * cross) / (float) energy : 0.0f;
+        if (score < pass.best_score) {
+            pass.best_score = score;
+            j->loop_end = pass.loop_first + c;
+        }
+        pass.cand_energy += (int32_t) loop_cand[c + len] * loop_cand[c + len] - (int32_t) loop_cand[c] * loop_cand[c];
+    }
+    pass.pos = end;
+    if (pass.pos < pass.loop_range)
+        return false;
+
+    if (j->loop_end < j->valid_samples)
+        j->loop_xfade_len = pass.best_score < LOOP_SEAMLESS ? 0 : FADE_XFADE_LOOP_LEN;
+    return true;
+}
+#endif
+
+// Run the step the worker stands at in the job, return true once it is done with it.
+static bool run_step(tape_job_t* j, worker_step_t step) {
+    switch (step) {
+#ifdef CONFIG_TAPE_SLICE_SNAPPING
+    case STEP_SNAP:
+        return snap_slices(j, TAPE_WORKER_CHUNK_FRAMES);
+#endif
+#ifdef CONFIG_TAPE_ANALYSIS
+    case STEP_ANALYSE:
+        return analyse_take(j, TAPE_WORKER_CHUNK_FRAMES);
+#endif
+#ifdef CONFIG_TAPE_LOOP_SEARCH
+    case STEP_LOOP:
+        return find_loop_point(j, TAPE_WORKER_CHUNK_FRAMES);
+#endif
+#ifdef CONFIG_TAPE_MIPMAP
+    case STEP_MIP:
+        return build_mip_levels(j, TAPE_WORKER_CHUNK_FRAMES);
+#endif
+    default:
+        return true;
+    }
+}
+
+bool tape_worker_process(void) {
+    if (job.state != TAPE_JOB_PENDING)
+        return false;
+    __DMB(); // state before the job contents
+
+    // a cancelled job ends at the next step, its results are dropped anyway
+    if (!job.cancel && run_step(&job, pass.step)) {
+        pass.step++;
+        pass.pos = 0;
+    }
+    if (!job.cancel && pass.step < STEP_DONE)
+        return true;
+
+    memset(&pass, 0, sizeof(pass));
+    __DMB(); // results before the state change
+    job.state = TAPE_JOB_DONE;
+    return false;
+}
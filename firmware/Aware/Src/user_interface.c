@@ -35,8 +35,10 @@ struct user_interface_config {
 
     bool cyclic_mode;
     bool reverse_mode;
+    bool overdub;
     bool last_cyclic_state;
     bool last_reverse_state;
+    bool last_overdub_state;
 };
 
 struct pot_pitch_calibration {
@@ -66,6 +68,7 @@ int user_iface_init(struct calibration_data* calibration,
 
     user_interface_cfg.cyclic_mode = false;
     user_interface_cfg.reverse_mode = false;
+    user_interface_cfg.overdub = false;
 
     return 0;
 }
@@ -125,6 +128,9 @@ void user_iface_process_pots(void) {
         user_interface_cfg.pots[i].val = smooth_filter(user_interface_cfg.pots[i].val, v, 0.1f);
     }
 
+    // the pot parameters reach the audio task together
+    param_cache_begin();
+
     // Base Pitch potentiometer
     float norm_pitch = user_interface_cfg.pots[POT_PITCH].val;
     struct calibration_data* cal = user_interface_cfg.calibration_data;
@@ -166,12 +172,31 @@ void user_iface_process_pots(void) {
     if (pow > MAX_DECIMATION_POW)
         pow = MAX_DECIMATION_POW;
     param_cache_set_decimation(1u << pow);
+    param_cache_publish();
 
     // TODO: single LED animation that flickers and glitches the more decimation is set.
     // Maybe reacting on current playback sample values as well. Lots of options here to explore!
 }
 
 void user_iface_process_buttons(uint32_t notified) {
+#ifdef CONFIG_TAPE_OVERDUB
+    // Pressing one button while holding the other toggles overdub. The press of the held button toggled its mode, take that back
+    if (are_both_buttons_pushed()) {
+        param_cache_begin();
+        if (!(notified & GPIO_NOTIFY_BUTTON1)) {
+            user_interface_cfg.cyclic_mode = !user_interface_cfg.cyclic_mode;
+            param_cache_set_cyclic(user_interface_cfg.cyclic_mode);
+        }
+        if (!(notified & GPIO_NOTIFY_BUTTON2)) {
+            user_interface_cfg.reverse_mode = !user_interface_cfg.reverse_mode;
+            param_cache_set_reverse(user_interface_cfg.reverse_mode);
+        }
+        user_interface_cfg.overdub = !user_interface_cfg.overdub;
+        param_cache_set_overdub(user_interface_cfg.overdub);
+        param_cache_publish();
+        notified &= ~(GPIO_NOTIFY_BUTTON1 | GPIO_NOTIFY_BUTTON2);
+    }
+#endif
     if (notified & GPIO_NOTIFY_BUTTON1) {
         user_interface_cfg.cyclic_mode = !user_interface_cfg.cyclic_mode;
         param_cache_set_cyclic(user_interface_cfg.cyclic_mode);
@@ -183,9 +208,13 @@ void user_iface_process_buttons(uint32_t notified) {
 
     bool cyclic_mode = user_interface_cfg.cyclic_mode;
     bool reverse_mode = user_interface_cfg.reverse_mode;
+    bool overdub = user_interface_cfg.overdub;
 
-    if (cyclic_mode != user_interface_cfg.last_cyclic_state || reverse_mode != user_interface_cfg.last_reverse_state) {
-        if (cyclic_mode && reverse_mode) {
+    if (cyclic_mode != user_interface_cfg.last_cyclic_state || reverse_mode != user_interface_cfg.last_reverse_state ||
+        overdub != user_interface_cfg.last_overdub_state) {
+        if (overdub) {
+            ws2812_set_static_color(2, (struct ws2812_color){.r = 255, .g = 96, .b = 0});
+        } else if (cyclic_mode && reverse_mode) {
             ws2812_set_static_color(2, (struct ws2812_color){.r = 128, .g = 0, .b = 128});
         } else if (cyclic_mode) {
             ws2812_set_static_color(2, blue);
@@ -196,6 +225,7 @@ void user_iface_process_buttons(uint32_t notified) {
         }
         user_interface_cfg.last_cyclic_state = cyclic_mode;
         user_interface_cfg.last_reverse_state = reverse_mode;
+        user_interface_cfg.last_overdub_state = overdub;
     }
 }
 
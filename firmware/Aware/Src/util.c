@@ -10,8 +10,18 @@
 #include <string.h>
 
 volatile cpu_stats_t cpu_stats;
+volatile audio_deadline_stats_t audio_deadline;
 
 void update_cpu_stats(void) {
+    // the audio task keeps the cycles, the shares of the deadline are worked out here
+    uint32_t deadline = audio_deadline.deadline_cycles;
+    if (deadline > 0) {
+        for (uint32_t i = 0; i < AUDIO_NUM_STAGES; i++) {
+            audio_deadline.stages[i].avg_percent = (uint32_t) (((uint64_t) audio_deadline.stages[i].avg * 100ULL) / deadline);
+            audio_deadline.stages[i].max_percent = (uint32_t) (((uint64_t) audio_deadline.stages[i].max * 100ULL) / deadline);
+        }
+    }
+
     static TaskStatus_t prev[8];
     static uint32_t prev_total;
     static bool first = true;
@@ -48,6 +58,8 @@ void update_cpu_stats(void) {
             cpu_stats.control_percent = pct;
         else if (strncmp(name, "UserIF", 6) == 0)
             cpu_stats.userif_percent = pct;
+        else if (strncmp(name, "Worker", 6) == 0)
+            cpu_stats.worker_percent = pct;
         else if (strncmp(name, "IDLE", 4) == 0)
             cpu_stats.idle_percent = pct;
     }
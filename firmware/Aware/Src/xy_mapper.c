@@ -30,13 +30,22 @@ static xy_map_piecewise_t x_map[] = {
     {.negative = {param_cache_set_schroeder_verb_wet, 0.0f, 1.0f, 0.7f},
      .positive = {param_cache_set_schroeder_verb_wet, 0.0f, 1.0f, 0.7f}},
     {.negative = {param_cache_set_schroeder_verb_lp_alpha, 0.0f, 0.0f, 1.3f},
-     .positive = {param_cache_set_schroeder_verb_lp_alpha, 0.0f, 0.4f, 1.3f}}
+     .positive = {param_cache_set_schroeder_verb_lp_alpha, 0.0f, 0.4f, 1.3f}},
+    // grains only on the right half of X, grains per second
+    {.negative = {param_cache_set_grain_density, 0.0f, 0.0f, 1.0f},
+     .positive = {param_cache_set_grain_density, 0.0f, 80.0f, 2.0f}}
     // add more mappings on x axis here
 };
 
 static xy_map_piecewise_t y_map[] = {
     {.negative = {param_cache_set_schroeder_verb_size, 0.05f, 1.0f, 1.0f},
      .positive = {param_cache_set_schroeder_verb_size, 0.05f, 1.0f, 1.0f}},
+    // grain size in ms: shorter below the center, longer above
+    {.negative = {param_cache_set_grain_size_ms, 60.0f, 10.0f, 1.0f},
+     .positive = {param_cache_set_grain_size_ms, 60.0f, 500.0f, 1.5f}},
+    // overdub feedback: full sound-on-sound at the center and above, the old layers fade faster towards the bottom
+    {.negative = {param_cache_set_overdub_feedback, 1.0f, 0.3f, 1.0f},
+     .positive = {param_cache_set_overdub_feedback, 1.0f, 1.0f, 1.0f}},
     // add more mappings on y axis here
 };
 
@@ -65,7 +65,7 @@ void TIM7_IRQHandler(void);
 void TIM15_IRQHandler(void);
 void TIM17_IRQHandler(void);
 /* USER CODE BEGIN EFP */
-
+void SPI1_IRQHandler(void);
 /* USER CODE END EFP */
 
 #ifdef __cplusplus
@@ -175,7 +175,9 @@ void HAL_I2S_MspInit(I2S_HandleTypeDef* i2sHandle)
     __HAL_LINKDMA(i2sHandle,hdmatx,hdma_spi1_tx);
 
   /* USER CODE BEGIN SPI1_MspInit 1 */
-
+    /* I2S1 error interrupts (overrun, underrun, frame error), enabled by start_ring_dma() */
+    HAL_NVIC_SetPriority(SPI1_IRQn, 5, 0);
+    HAL_NVIC_EnableIRQ(SPI1_IRQn);
   /* USER CODE END SPI1_MspInit 1 */
   }
 }
@@ -208,7 +210,7 @@ void HAL_I2S_MspDeInit(I2S_HandleTypeDef* i2sHandle)
     HAL_DMA_DeInit(i2sHandle->hdmarx);
     HAL_DMA_DeInit(i2sHandle->hdmatx);
   /* USER CODE BEGIN SPI1_MspDeInit 1 */
-
+    HAL_NVIC_DisableIRQ(SPI1_IRQn);
   /* USER CODE END SPI1_MspDeInit 1 */
   }
 }
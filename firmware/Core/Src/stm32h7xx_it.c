@@ -67,7 +67,7 @@ extern TIM_HandleTypeDef htim17;
 extern TIM_HandleTypeDef htim7;
 
 /* USER CODE BEGIN EV */
-
+extern I2S_HandleTypeDef hi2s1;
 /* USER CODE END EV */
 
 /******************************************************************************/
@@ -340,5 +340,11 @@ void TIM17_IRQHandler(void)
 }
 
 /* USER CODE BEGIN 1 */
-
+/**
+  * @brief This function handles SPI1 global interrupt, the error interrupts of I2S1.
+  */
+void SPI1_IRQHandler(void)
+{
+  HAL_I2S_IRQHandler(&hi2s1);
+}
 /* USER CODE END 1 */
@@ -0,0 +1,85 @@
+/**
+ * @file cmd_ring_stress.c
+ * @brief Host concurrency stress test of the gate command ring (Inc/cmd_ring.h).
+ *
+ * gcc -O2 -Ihost -I../Aware/Inc cmd_ring_stress.c -o cmd_ring_stress && ./cmd_ring_stress [commands]
+ *
+ * A SIGALRM handler stands in for the EXTI callback: an interval timer fires it every 20 us and it pushes a burst of
+ * 1..5 commands. The main loop is the audio task: it peeks and pops like take_period_gates() and spends a varying time
+ * on each command, so the handler interrupts it at arbitrary points, between peek and pop included, and now and then
+ * finds the ring full. Every command carries its sequence number in cycles and a check pattern in cmd and frame.
+ * Passes if no command was corrupted or reordered and received + dropped == sent. Build it at -O0 and -O3 as well.
+ */
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/time.h>
+
+#include "cmd_ring.h"
+
+#define BURST_MAX 5
+#define TIMER_US 20
+
+static cmd_ring_t ring;
+static volatile uint32_t sent;
+
+static tape_cmd_msg_t make_cmd(uint32_t seq) {
+    return (tape_cmd_msg_t) {.cmd = (tape_cmd_t) (seq & 3), .cycles = seq, .frame = ~seq};
+}
+
+// the producer, it interrupts the consumer anywhere
+static void gate_isr(int sig) {
+    (void) sig;
+    uint32_t burst = 1 + sent % BURST_MAX;
+    for (uint32_t i = 0; i < burst; i++) {
+        tape_cmd_msg_t msg = make_cmd(sent);
+        cmd_ring_push(&ring, &msg);
+        sent = sent + 1;
+    }
+}
+
+static void set_timer(long us) {
+    struct itimerval it = {.it_interval = {0, us}, .it_value = {0, us}};
+    setitimer(ITIMER_REAL, &it, NULL);
+}
+
+int main(int argc, char** argv) {
+    uint32_t total = argc > 1 ? (uint32_t) strtoul(argv[1], NULL, 0) : 3000000;
+    uint32_t received = 0, corrupt = 0, reordered = 0, next_seq = 0;
+    tape_cmd_msg_t msg;
+
+    signal(SIGALRM, gate_isr);
+    set_timer(TIMER_US);
+
+    for (;;) {
+        bool producing = sent < total;
+        if (!producing)
+            set_timer(0);
+
+        if (!cmd_ring_peek(&ring, &msg)) {
+            if (!producing)
+                break;
+            continue;
+        }
+
+        tape_cmd_msg_t want = make_cmd(msg.cycles);
+        if (msg.cmd != want.cmd || msg.frame != want.frame)
+            corrupt++;
+        if (msg.cycles < next_seq)
+            reordered++;
+        next_seq = msg.cycles + 1;
+
+        // the work of a block, up to a few timer periods now and then so that the ring overflows
+        for (volatile uint32_t spin = (msg.cycles * 2654435761u) % (msg.cycles % 64 ? 300 : 30000); spin > 0; spin--)
+            ;
+        cmd_ring_pop(&ring);
+        received++;
+    }
+
+    uint32_t dropped = ring.dropped;
+    bool ok = corrupt == 0 && reordered == 0 && received + dropped == sent && ring.max_fill <= CMD_RING_LEN;
+    printf("sent %u received %u dropped %u (received + dropped %s sent), max fill %u/%u, corrupt %u, reordered %u\n", sent,
+           received, dropped, received + dropped == sent ? "==" : "!=", ring.max_fill, CMD_RING_LEN, corrupt, reordered);
+    printf(ok ? "PASS\n" : "FAIL\n");
+    return ok ? 0 : 1;
+}
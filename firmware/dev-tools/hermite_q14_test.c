@@ -0,0 +1,203 @@
+/**
+ * @file hermite_q14_test.c
+ * @brief Host reference test of the fixed-point Catmull-Rom path (dsp/hermite_q14.h) against the spline in double precision.
+ *
+ * gcc -O2 -Ihost -I../Aware/Inc hermite_q14_test.c -lm -o hermite_q14_test && ./hermite_q14_test
+ *
+ * Two references:
+ *  - model_sample(): the same fixed-point arithmetic written out in plain 64-bit C, without the packed intrinsics. The
+ *    Q14 path must match it bit for bit, at every phase and hold, for random and extreme taps. This catches overflow,
+ *    sign and packing mistakes, which the bound below would only catch if they are large.
+ *  - ref_sample(): the Catmull-Rom spline of hermite_interpolate() with the zero-order hold blend, evaluated in double
+ *    and rounded to the nearest sample. The Q14 path is not bit-exact with it: __SMLAD takes 16-bit operands and the
+ *    center weight reaches 1.0, so the weights are Q14.
+ *
+ * Error bound against the spline, in Q16 LSB of t for t^2 and t^3 and in output LSB for the sample:
+ *  - t2 is rounded once: |dt2| <= 0.5. t3 = t2 * t rounded again: |dt3| <= 0.5 * t + 0.5 <= 1.
+ *  - 2 * w[i] is a polynomial in t, t2 and t3 with the coefficients above. Its error is at most 1 * |dt3| + 2 * |dt2| = 2
+ *    for w[-1], 3 * |dt3| + 4 * |dt2| = 5 for w[1] and |dt3| + |dt2| = 1.5 for w[2]. Halved and scaled by 1 - g <= 1
+ *    this gives 1, 2.5 and 0.75 / 65536. Rounding to Q14 adds at most 0.5 / 16384 to each.
+ *  - w[0] is 1 minus the others, so the weight errors e[i] sum to 0 and the sample error before rounding is
+ *    sum(e[i] * (x[i] - x[0])) over the outer taps. It grows with the difference between neighbouring samples, not
+ *    with the level.
+ *  - Both outputs are rounded to the nearest sample, 0.5 LSB each. Saturation only brings them closer.
+ * error_bound() evaluates this for given bounds on |x[i] - x[0]|. With full-scale taps it is 10.25 + 1 LSB.
+ *
+ * Checked here:
+ *  - the Q14 path matches model_sample() exactly
+ *  - constant input comes out exact at every phase and hold
+ *  - full-scale sines read at several pitch ratios: within error_bound() of the largest neighbour differences of the sine
+ *  - worst case over every phase, with full-scale taps of the signs that add up the weight errors: within the full-scale bound
+ * Exits with 1 if a check fails.
+ */
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "dsp/hermite_q14.h"
+
+#define FS 48000.0
+#define HOLD_STEP 64 // hold values 0, 64, ... 16384 of grit_hold_q14
+
+static const double sine_hz[] = {100.0, 1000.0, 3000.0, 6000.0, 12000.0};
+static const double ratios[] = {0.5, 1.0001, 1.4142, 2.7};
+
+// exact weights of the taps x[-1..2] at phase t, with the hold share g on x[0]
+static void ref_weights(double t, double g, double* w) {
+    w[0] = (-t * t * t + 2 * t * t - t) / 2;
+    w[1] = (3 * t * t * t - 5 * t * t + 2) / 2;
+    w[2] = (-3 * t * t * t + 4 * t * t + t) / 2;
+    w[3] = (t * t * t - t * t) / 2;
+    for (int i = 0; i < 4; i++)
+        w[i] *= 1.0 - g;
+    w[1] += g;
+}
+
+static int ref_sample(const int16_t* x, uint32_t frac_q16, int32_t hold_q14) {
+    double w[4];
+    ref_weights(frac_q16 / 65536.0, hold_q14 / 16384.0, w);
+    double acc = 0.0;
+    for (int i = 0; i < 4; i++)
+        acc += w[i] * x[i];
+    acc = nearbyint(acc);
+    return acc > 32767.0 ? 32767 : (acc < -32768.0 ? -32768 : (int) acc);
+}
+
+static int q14_sample(const int16_t* x, uint32_t frac_q16, int32_t hold_q14) {
+    uint32_t w_lo, w_hi;
+    hermite_weights_q14(frac_q16, hold_q14, &w_lo, &w_hi);
+    uint32_t taps_lo = __PKHBT((uint16_t) x[0], (uint16_t) x[1], 16);
+    uint32_t taps_hi = __PKHBT((uint16_t) x[2], (uint16_t) x[3], 16);
+    return hermite_dot_q14(taps_lo, taps_hi, w_lo, w_hi);
+}
+
+// The same arithmetic as hermite_weights_q14() and hermite_dot_q14() in 64 bits, where nothing overflows or wraps.
+static int model_sample(const int16_t* x, uint32_t frac_q16, int32_t hold_q14) {
+    int64_t t = frac_q16;
+    int64_t t2 = (t * t + 0x8000) >> 16;
+    int64_t t3 = (t2 * t + 0x8000) >> 16;
+    int64_t scale = 16384 - hold_q14;
+    int64_t w[4];
+    w[0] = ((-t3 + 2 * t2 - t) * scale + (1 << 16)) >> 17;
+    w[2] = ((-3 * t3 + 4 * t2 + t) * scale + (1 << 16)) >> 17;
+    w[3] = ((t3 - t2) * scale + (1 << 16)) >> 17;
+    w[1] = 16384 - w[0] - w[2] - w[3];
+    int64_t acc = 0;
+    for (int i = 0; i < 4; i++)
+        acc += w[i] * x[i];
+    acc = (acc + (1 << 13)) >> 14;
+    return acc > 32767 ? 32767 : (acc < -32768 ? -32768 : (int) acc);
+}
+
+// Bound on |q14_sample() - ref_sample()| in LSB for taps with |x[i] - x[0]| <= d[i], from the analysis at the top.
+static double error_bound(const double* d) {
+    static const double e[4] = {1.0 / 65536 + 0.5 / 16384, 0.0, 2.5 / 65536 + 0.5 / 16384, 0.75 / 65536 + 0.5 / 16384};
+    double bound = 1.0; // rounding of both outputs
+    for (int i = 0; i < 4; i++)
+        bound += e[i] * d[i];
+    return bound;
+}
+
+// Uniform 16-bit taps, the same sequence on every host.
+static int16_t noise(uint32_t* state) {
+    *state = *state * 1664525u + 1013904223u;
+    return (int16_t) (*state >> 16);
+}
+
+static int check_model(void) {
+    static const int16_t extremes[][4] = {
+        {-32768, 32767, -32768, 32767}, {32767, -32768, 32767, -32768}, {32767, -32768, -32768, 32767},
+        {-32768, 32767, 32767, -32768}, {-32768, -32768, -32768, -32768}, {32767, 32767, 32767, 32767},
+    };
+    uint32_t seed = 1;
+    long bad = 0, total = 0;
+    for (int32_t hold = 0; hold <= 16384; hold += HOLD_STEP)
+        for (uint32_t frac = 0; frac < 65536; frac++) {
+            int16_t x[4];
+            for (int i = 0; i < 4; i++)
+                x[i] = noise(&seed);
+            bad += q14_sample(x, frac, hold) != model_sample(x, frac, hold);
+            const int16_t* e = extremes[frac % (sizeof(extremes) / sizeof(extremes[0]))];
+            bad += q14_sample(e, frac, hold) != model_sample(e, frac, hold);
+            total += 2;
+        }
+    printf("fixed-point model: %ld of %ld samples differ\n", bad, total);
+    return bad == 0;
+}
+
+static int check_constant(void) {
+    static const int16_t levels[] = {-32768, -1, 0, 1, 12345, 32767};
+    int bad = 0;
+    for (int32_t hold = 0; hold <= 16384; hold += HOLD_STEP)
+        for (uint32_t frac = 0; frac < 65536; frac++)
+            for (size_t l = 0; l < sizeof(levels) / sizeof(levels[0]); l++) {
+                int16_t x[4] = {levels[l], levels[l], levels[l], levels[l]};
+                bad += q14_sample(x, frac, hold) != levels[l];
+            }
+    printf("constant input: %d mismatches\n", bad);
+    return bad == 0;
+}
+
+static int check_sines(void) {
+    int ok = 1;
+    for (size_t s = 0; s < sizeof(sine_hz) / sizeof(sine_hz[0]); s++) {
+        // neighbours one and two frames from x[0] differ by at most these, plus 1 for rounding the sine to samples
+        double d1 = 2.0 * 32767.0 * sin(fmin(M_PI * sine_hz[s] / FS, M_PI / 2)) + 1.0;
+        double d2 = 2.0 * 32767.0 * sin(fmin(2.0 * M_PI * sine_hz[s] / FS, M_PI / 2)) + 1.0;
+        int tol = (int) error_bound((const double[4]){d1, 0.0, d1, d2});
+        int worst = 0;
+        for (size_t r = 0; r < sizeof(ratios) / sizeof(ratios[0]); r++) {
+            uint64_t inc_q16 = (uint64_t) (ratios[r] * 65536.0);
+            for (uint64_t pos = 1 << 16; pos < (48000ull << 16); pos += inc_q16) {
+                uint32_t idx = (uint32_t) (pos >> 16);
+                int16_t x[4];
+                for (int i = 0; i < 4; i++)
+                    x[i] = (int16_t) lrint(32767.0 * sin(2.0 * M_PI * sine_hz[s] * (idx - 1 + i) / FS));
+                int32_t hold = (int32_t) (idx % 4) * 4096; // none, a quarter, half and three quarters of hold
+                int err = abs(q14_sample(x, pos & 0xFFFF, hold) - ref_sample(x, pos & 0xFFFF, hold));
+                if (err > worst)
+                    worst = err;
+            }
+        }
+        printf("full-scale sine %6.0f Hz: max error %d LSB (bound %d)\n", sine_hz[s], worst, tol);
+        ok &= worst <= tol;
+    }
+    return ok;
+}
+
+static int check_worst(void) {
+    int tol = (int) error_bound((const double[4]){65535.0, 0.0, 65535.0, 65535.0});
+    int worst = 0;
+    uint32_t worst_frac = 0;
+    int32_t worst_hold = 0;
+    for (int32_t hold = 0; hold <= 16384; hold += HOLD_STEP)
+        for (uint32_t frac = 0; frac < 65536; frac++) {
+            uint32_t w_lo, w_hi;
+            hermite_weights_q14(frac, hold, &w_lo, &w_hi);
+            int32_t wq[4] = {host_lo16(w_lo), host_hi16(w_lo), host_lo16(w_hi), host_hi16(w_hi)};
+            double w[4];
+            ref_weights(frac / 65536.0, hold / 16384.0, w);
+
+            // full-scale taps of the sign of each weight error add all of them up
+            int16_t x[4];
+            for (int i = 0; i < 4; i++)
+                x[i] = wq[i] / 16384.0 > w[i] ? 32767 : -32768;
+            int err = abs(q14_sample(x, frac, hold) - ref_sample(x, frac, hold));
+            if (err > worst) {
+                worst = err;
+                worst_frac = frac;
+                worst_hold = hold;
+            }
+        }
+    printf("worst case: %d LSB at phase %u/65536, hold %d/16384 (bound %d)\n", worst, worst_frac, worst_hold, tol);
+    return worst <= tol;
+}
+
+int main(void) {
+    int ok = check_model();
+    ok &= check_constant();
+    ok &= check_sines();
+    ok &= check_worst();
+    printf(ok ? "PASS\n" : "FAIL\n");
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,41 @@
+/**
+ * @file arm_math.h
+ * @brief Host stand-in for the CMSIS DSP header: portable C versions of the Cortex-M7 intrinsics the dev-tools tests need.
+ *
+ * Put dev-tools/host on the include path in front of the firmware headers, see the build line of each test.
+ */
+#pragma once
+
+#include <stdint.h>
+
+typedef int16_t q15_t;
+
+static inline int32_t host_lo16(uint32_t x) {
+    return (int16_t) (x & 0xFFFF);
+}
+
+static inline int32_t host_hi16(uint32_t x) {
+    return (int16_t) (x >> 16);
+}
+
+static inline uint32_t __SMUAD(uint32_t a, uint32_t b) {
+    return (uint32_t) (host_lo16(a) * host_lo16(b) + host_hi16(a) * host_hi16(b));
+}
+
+static inline uint32_t __SMLAD(uint32_t a, uint32_t b, uint32_t acc) {
+    return (uint32_t) ((int32_t) acc + host_lo16(a) * host_lo16(b) + host_hi16(a) * host_hi16(b));
+}
+
+static inline uint32_t __PKHBT(uint32_t a, uint32_t b, uint32_t shift) {
+    return (a & 0xFFFF) | ((b << shift) & 0xFFFF0000u);
+}
+
+static inline uint32_t __PKHTB(uint32_t a, uint32_t b, uint32_t shift) {
+    return (a & 0xFFFF0000u) | ((uint32_t) ((int32_t) b >> shift) & 0xFFFF);
+}
+
+static inline int32_t __SSAT(int32_t v, uint32_t bits) {
+    int32_t max = (1 << (bits - 1)) - 1;
+    return v > max ? max : (v < -max - 1 ? -max - 1 : v);
+}
+
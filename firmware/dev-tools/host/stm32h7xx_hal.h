@@ -0,0 +1,11 @@
+/**
+ * @file stm32h7xx_hal.h
+ * @brief Host stand-in for the HAL header: the CMSIS barrier the lock-free firmware headers use.
+ */
+#pragma once
+
+#include "arm_math.h"
+
+static inline void __DMB(void) {
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+}
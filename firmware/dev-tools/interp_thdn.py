@@ -0,0 +1,112 @@
+#!/usr/bin/env python3
+"""Compare the playback interpolators of the tape player: THD+N and MACs per stereo frame.
+
+Models hold, the Q14 Catmull-Rom of hermite_weights_q14() and the Q15 polyphase windowed sinc of Inc/dsp/sinc_interp.h
+with 8 and 16 taps (cutoff and Kaiser beta read from that header), all in the fixed point of the firmware. A sine is
+played back at a pitch and everything but the transposed sine counts as THD+N. Pitches above 1 show the interpolator
+alone, without the mip levels of CONFIG_TAPE_MIPMAP. The cycles on the target are in the render_cycles of each voice.
+"""
+import argparse
+import os
+import re
+
+import numpy as np
+
+FS = 48000
+HERE = os.path.dirname(os.path.abspath(__file__))
+SINC_HEADER = os.path.join(HERE, "..", "Aware", "Inc", "dsp", "sinc_interp.h")
+PHASE_BITS = 8
+
+
+def sinc_design(taps):
+    src = open(SINC_HEADER).read()
+    block = re.search(r"#if CONFIG_TAPE_SINC_TAPS == 8(.*?)#else(.*?)#endif", src, re.S).group(1 if taps == 8 else 2)
+    cutoff = float(re.search(r"SINC_CUTOFF ([\d.]+)f", block).group(1))
+    beta = float(re.search(r"SINC_BETA ([\d.]+)f", block).group(1))
+    return cutoff, beta
+
+
+# sinc_interp_init(): rows of Q15 weights summing to unity, the rounding error on the largest weight
+def sinc_table(taps):
+    cutoff, beta = sinc_design(taps)
+    half = taps // 2
+    phases = 1 << PHASE_BITS
+    x = np.arange(taps)[None, :] - (half - 1) - np.arange(phases + 1)[:, None] / phases
+    r = np.clip(1 - (x / half) ** 2, 0, None)
+    w = cutoff * np.sinc(cutoff * x) * np.where(r > 0, np.i0(beta * np.sqrt(r)) / np.i0(beta), 0)
+    table = np.round(w / w.sum(axis=1, keepdims=True) * 32768).astype(np.int64)
+    rows = np.arange(phases + 1)
+    table[rows, table.argmax(axis=1)] += 32768 - table.sum(axis=1)
+    return table
+
+
+def taps_around(x, idx, first, n):
+    xp = np.concatenate((np.zeros(n, np.int64), x, np.zeros(n, np.int64)))  # silence around the take
+    return np.stack([xp[idx + first + j + n] for j in range(n)], axis=1)
+
+
+def play_hold(x, pos):
+    return x[pos >> 16]
+
+
+def play_hermite(x, pos):
+    t = pos & 0xFFFF
+    t2 = (t * t) >> 16
+    t3 = (t2 * t) >> 16
+    wm1 = (-t3 + 2 * t2 - t + 4) >> 3
+    w1 = (-3 * t3 + 4 * t2 + t + 4) >> 3
+    w2 = (t3 - t2 + 4) >> 3
+    w = np.stack([wm1, 16384 - wm1 - w1 - w2, w1, w2], axis=1)
+    acc = (taps_around(x, pos >> 16, -1, 4) * w).sum(axis=1)
+    return np.clip((acc + (1 << 13)) >> 14, -32768, 32767)
+
+
+def play_sinc(x, pos, table):
+    taps = table.shape[1]
+    frac = pos & 0xFFFF
+    a = table[frac >> (16 - PHASE_BITS)]
+    b = table[(frac >> (16 - PHASE_BITS)) + 1]
+    mu = (frac & ((1 << (16 - PHASE_BITS)) - 1))[:, None]
+    w = a + (((b - a) * mu) >> (16 - PHASE_BITS))
+    acc = (taps_around(x, pos >> 16, 1 - taps // 2, taps) * w).sum(axis=1)
+    return np.clip((acc + (1 << 14)) >> 15, -32768, 32767)
+
+
+def thdn_db(y, f):
+    n = np.arange(len(y))
+    basis = np.stack([np.sin(2 * np.pi * f * n / FS), np.cos(2 * np.pi * f * n / FS), np.ones(len(y))], axis=1)
+    coef, *_ = np.linalg.lstsq(basis, y, rcond=None)
+    residual = y - basis @ coef
+    wanted = basis[:, :2] @ coef[:2]
+    return 10 * np.log10(max((residual**2).mean(), 1e-20) / (wanted**2).mean())
+
+
+parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+parser.add_argument("--freqs", type=float, nargs="+", default=[1000, 5000, 10000, 15000], help="test tones in Hz")
+parser.add_argument("--pitches", type=float, nargs="+", default=[0.5, 0.77, 1.33, 1.5])
+args = parser.parse_args()
+
+frames = 8192
+interps = {
+    "hold": (play_hold, 0),
+    "hermite": (play_hermite, 4),
+    "sinc8": (lambda x, p, t=sinc_table(8): play_sinc(x, p, t), 8),
+    "sinc16": (lambda x, p, t=sinc_table(16): play_sinc(x, p, t), 16),
+}
+
+# dual 16-bit MACs per stereo frame in the dot products of tape_player_dsp.c, the sinc weights take one multiply per tap on top
+print("MACs/frame " + " ".join(f"{name:>8}" for name in interps))
+print("           " + " ".join(f"{macs:8d}" for _, macs in interps.values()))
+print()
+print("THD+N in dB")
+print(f"{'tone':>6} {'pitch':>6} " + " ".join(f"{name:>8}" for name in interps))
+for f in args.freqs:
+    for p in args.pitches:
+        inc = int(p * 65536)
+        f_out = f * inc / 65536
+        if f_out >= FS / 2:
+            continue
+        take = np.round(16000 * np.sin(2 * np.pi * f * np.arange(int(frames * p) + 64) / FS)).astype(np.int64)
+        pos = (16 << 16) + inc * np.arange(frames, dtype=np.int64)
+        row = [thdn_db(play(take, pos), f_out) for play, _ in interps.values()]
+        print(f"{f:6.0f} {p:6.2f} " + " ".join(f"{v:8.1f}" for v in row))
@@ -0,0 +1,90 @@
+#!/usr/bin/env python3
+"""Measure how much the mip levels of CONFIG_TAPE_MIPMAP reduce aliasing at high pitch.
+
+Models the firmware: mip levels built with the half-band of Src/ressources.c centered on every other frame
+(Src/tape_worker.c), Catmull-Rom playback, and the blend of the two levels around the phase increment
+(tape_render_span_mip() in Src/dsp/tape_player_dsp.c). A sine is recorded, played back at a pitch and everything
+in the output that is not the transposed sine is counted as alias. Tones pitched above Nyquist should vanish.
+"""
+import argparse
+import os
+import re
+
+import numpy as np
+
+FS = 48000
+HERE = os.path.dirname(os.path.abspath(__file__))
+RESSOURCES = os.path.join(HERE, "..", "Aware", "Src", "ressources.c")
+
+
+def load_halfband():
+    src = open(RESSOURCES).read()
+    body = re.search(r"halfband_coeffs_q15\[[^]]*\]\s*=\s*\{([^}]*)\}", src).group(1)
+    return np.array([int(x) for x in body.replace("\n", " ").split(",") if x.strip()]) / 32768.0
+
+
+def build_levels(take, num_levels, h):
+    levels = [take]
+    for _ in range(num_levels):
+        prev = levels[-1]
+        # zero-phase: output frame n is centered on input frame 2n
+        filtered = np.convolve(prev, h, mode="same")
+        levels.append(np.round(filtered[::2]))
+    return levels
+
+
+def catmull_rom(x, pos):
+    idx = np.floor(pos).astype(int)
+    t = pos - idx
+    xp = np.concatenate(([0.0], x, [0.0, 0.0, 0.0]))  # silent frame in front, guard frames behind
+    xm1, x0, x1, x2 = xp[idx], xp[idx + 1], xp[idx + 2], xp[idx + 3]
+    m0 = 0.5 * (x1 - xm1)
+    m1 = 0.5 * (x2 - x0)
+    return ((((2 * x0 - 2 * x1 + m0 + m1) * t) + (-3 * x0 + 3 * x1 - 2 * m0 - m1)) * t + m0) * t + x0
+
+
+def play(levels, pitch, frames, use_mip):
+    pos = 1.0 + pitch * np.arange(frames)
+    if not use_mip or pitch <= 1.0:
+        return catmull_rom(levels[0], pos)
+    k = int(np.floor(np.log2(pitch)))
+    top = len(levels) - 1
+    if k >= top:
+        return catmull_rom(levels[top], pos / 2**top)
+    t = pitch / 2**k - 1.0
+    a = catmull_rom(levels[k], pos / 2**k)
+    b = catmull_rom(levels[k + 1], pos / 2 ** (k + 1))
+    return a + (b - a) * t
+
+
+def spectrum(x):
+    return np.abs(np.fft.rfft(x * np.hanning(len(x)))) ** 2
+
+
+def alias_db(out, f_out, ref_power):
+    spec = spectrum(out)
+    freqs = np.fft.rfftfreq(len(out), 1 / FS)
+    wanted = spec[np.abs(freqs - f_out) < 60].sum() if f_out < FS / 2 else 0.0
+    return 10 * np.log10(max(spec.sum() - wanted, 1e-20) / ref_power)
+
+
+parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+parser.add_argument("--levels", type=int, default=4, help="TAPE_MIP_MAX_LEVELS")
+parser.add_argument("--freqs", type=float, nargs="+", default=[2000, 5000, 9000, 15000, 20000], help="test tones in Hz")
+parser.add_argument("--pitches", type=float, nargs="+", default=[1.5, 2, 3, 4, 6, 8, 12, 16])
+args = parser.parse_args()
+
+h = load_halfband()
+frames = 8192
+amp = 16000
+ref_power = spectrum(amp * np.sin(2 * np.pi * 1000 * np.arange(frames) / FS)).sum()  # the played tone, unattenuated
+
+print("alias power relative to the played tone in dB, gain = direct - mip. In-band tones show the interpolation error instead")
+print(f"{'tone':>8} {'pitch':>6} {'direct':>8} {'mip':>8} {'gain':>7}")
+for f in args.freqs:
+    take = np.round(amp * np.sin(2 * np.pi * f * np.arange(int(frames * max(args.pitches)) + 64) / FS))
+    levels = build_levels(take, args.levels, h)
+    for p in args.pitches:
+        direct = alias_db(play(levels, p, frames, False), f * p, ref_power)
+        mip = alias_db(play(levels, p, frames, True), f * p, ref_power)
+        print(f"{f:8.0f} {p:6.2f} {direct:8.1f} {mip:8.1f} {direct - mip:7.1f}")
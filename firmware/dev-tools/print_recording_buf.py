@@ -7,10 +7,8 @@ import argparse
 import matplotlib.pyplot as plt
 
 # === Config ===
-BUF_ADDR_L = 0x24000110
-BUF_ADDR_R = 0x24075410
-BUF_LEN    = 240000
 FS         = 48000  # audio sample rate
+ADPCM_BLOCK_LEN = 128
 
 # === CLI parser ===
 parser = argparse.ArgumentParser(description="Dump STM32 tape buffers")
@@ -18,24 +16,125 @@ parser.add_argument("--wav", action="store_true", help="Dump WAV file")
 parser.add_argument("--csv", action="store_true", help="Dump CSV file")
 parser.add_argument("--plot", action="store_true", help="Plot both channels")
 parser.add_argument("--name", type=str, default="tape_dump", help="Base filename for dump files")
+parser.add_argument("--layout", choices=["interleaved", "planar"], default="planar",
+                    help="Tape buffer layout, must match CONFIG_TAPE_BUFFER_INTERLEAVED in project_config.h")
+parser.add_argument("--encoding", choices=["pcm16", "pcm8", "mulaw", "alaw", "adpcm"], default="pcm16",
+                    help="Tape encoding, must match CONFIG_TAPE_ENCODING. Compressed encodings are always interleaved")
+# takes live in the tape pool at run time dependent addresses, read them from tape_player.playback_buf in the debugger
+parser.add_argument("--addr", type=lambda x: int(x, 0), required=True,
+                    help="Start of the take: store.ch[0] (pcm16) or store.frames (compressed encodings)")
+parser.add_argument("--r-addr", type=lambda x: int(x, 0), default=None,
+                    help="store.ch[1], needed for --layout planar")
+parser.add_argument("--hdr-addr", type=lambda x: int(x, 0), default=None,
+                    help="store.headers, the ADPCM block header array, needed for --encoding adpcm")
+parser.add_argument("--frames", type=int, required=True, help="Frames to dump, usually valid_samples")
 args = parser.parse_args()
 
+if args.encoding == "adpcm" and args.hdr_addr is None:
+    parser.error("--encoding adpcm needs --hdr-addr")
+if args.encoding == "pcm16" and args.layout == "planar" and args.r_addr is None:
+    parser.error("--layout planar needs --r-addr")
+
+BUF_ADDR_L = args.addr
+BUF_ADDR_R = args.r_addr
+BUF_LEN    = args.frames
+if args.encoding == "adpcm":
+    BUF_LEN = (BUF_LEN + ADPCM_BLOCK_LEN - 1) // ADPCM_BLOCK_LEN * ADPCM_BLOCK_LEN  # whole blocks
+
 if not (args.wav or args.csv or args.plot):
     print("Nothing selected, defaulting to WAV + CSV + plot")
     args.wav = True
     args.csv = True
     args.plot = True
 
+# === Decoders, mirror Src/dsp/tape_codec.c ===
+ADPCM_INDEX = [-1, -1, -1, -1, 2, 4, 6, 8] * 2
+ADPCM_STEP = [
+    7, 8, 9, 10, 11, 12, 13, 14, 16, 17, 19, 21, 23, 25, 28, 31, 34, 37, 41, 45, 50, 55, 60, 66, 73, 80, 88, 97, 107,
+    118, 130, 143, 157, 173, 190, 209, 230, 253, 279, 307, 337, 371, 408, 449, 494, 544, 598, 658, 724, 796, 876, 963,
+    1060, 1166, 1282, 1411, 1552, 1707, 1878, 2066, 2272, 2499, 2749, 3024, 3327, 3660, 4026, 4428, 4871, 5358, 5894,
+    6484, 7132, 7845, 8630, 9493, 10442, 11487, 12635, 13899, 15289, 16818, 18500, 20350, 22385, 24623, 27086, 29794,
+    32767]
+
+
+def ulaw_decode(code):
+    code = ~code & 0xFF
+    t = (((code & 0x0F) << 3) + 0x84) << ((code & 0x70) >> 4)
+    return (0x84 - t) if code & 0x80 else (t - 0x84)
+
+
+def alaw_decode(code):
+    code ^= 0x55
+    t = (code & 0x0F) << 4
+    seg = (code & 0x70) >> 4
+    t = t + 8 if seg == 0 else (t + 0x108) << (seg - 1)
+    return t if code & 0x80 else -t
+
+
+def decode8(codes, encoding):
+    if encoding == "pcm8":
+        lut = np.array([(i - 256 if i > 127 else i) * 256 for i in range(256)], dtype=np.int16)
+    elif encoding == "mulaw":
+        lut = np.array([ulaw_decode(i) for i in range(256)], dtype=np.int16)
+    else:
+        lut = np.array([alaw_decode(i) for i in range(256)], dtype=np.int16)
+    return lut[codes.reshape(-1, 2)]
+
+
+def adpcm_decode(codes, headers):
+    # headers: int16 predictor[2], uint8 step_idx[2] per block
+    out = np.zeros((len(codes), 2), dtype=np.int16)
+    for blk in range(len(codes) // ADPCM_BLOCK_LEN):
+        hdr = headers[blk * 6:(blk + 1) * 6]
+        pred = [int.from_bytes(hdr[0:2], "little", signed=True), int.from_bytes(hdr[2:4], "little", signed=True)]
+        idx = [hdr[4], hdr[5]]
+        for i in range(blk * ADPCM_BLOCK_LEN, (blk + 1) * ADPCM_BLOCK_LEN):
+            for ch, nib in enumerate((codes[i] & 0x0F, codes[i] >> 4)):
+                step = ADPCM_STEP[idx[ch]]
+                diff = step >> 3
+                if nib & 4: diff += step
+                if nib & 2: diff += step >> 1
+                if nib & 1: diff += step >> 2
+                pred[ch] = max(-32768, min(32767, pred[ch] - diff if nib & 8 else pred[ch] + diff))
+                idx[ch] = max(0, min(88, idx[ch] + ADPCM_INDEX[nib]))
+                out[i, ch] = pred[ch]
+    return out
+
+
 # === Connect to target ===
 with ConnectHelper.session_with_chosen_probe() as session:
     target = session.target
-    raw_l = target.read_memory_block8(BUF_ADDR_L, BUF_LEN * 2)
-    raw_r = target.read_memory_block8(BUF_ADDR_R, BUF_LEN * 2)
+    if args.encoding == "adpcm":
+        # one byte per frame, L in the low nibble
+        raw = target.read_memory_block8(BUF_ADDR_L, BUF_LEN)
+        raw_hdr = target.read_memory_block8(args.hdr_addr, (BUF_LEN // ADPCM_BLOCK_LEN) * 6)
+    elif args.encoding != "pcm16":
+        # one byte per channel, L in the low byte
+        raw = target.read_memory_block8(BUF_ADDR_L, BUF_LEN * 2)
+    elif args.layout == "interleaved":
+        # one 32-bit word per frame, L in the low halfword
+        raw = target.read_memory_block8(BUF_ADDR_L, BUF_LEN * 4)
+    else:
+        raw_l = target.read_memory_block8(BUF_ADDR_L, BUF_LEN * 2)
+        raw_r = target.read_memory_block8(BUF_ADDR_R, BUF_LEN * 2)
 
 # === Convert to numpy arrays ===
-left  = np.frombuffer(bytearray(raw_l), dtype=np.int16)
-right = np.frombuffer(bytearray(raw_r), dtype=np.int16)
-stereo = np.stack((left, right), axis=1)
+if args.encoding == "adpcm":
+    stereo = adpcm_decode(np.frombuffer(bytearray(raw), dtype=np.uint8), bytes(raw_hdr))
+    left  = stereo[:, 0]
+    right = stereo[:, 1]
+elif args.encoding != "pcm16":
+    stereo = decode8(np.frombuffer(bytearray(raw), dtype=np.uint8), args.encoding)
+    left  = stereo[:, 0]
+    right = stereo[:, 1]
+elif args.layout == "interleaved":
+    stereo = np.frombuffer(bytearray(raw), dtype=np.int16).reshape(-1, 2)
+    left  = stereo[:, 0]
+    right = stereo[:, 1]
+else:
+    left  = np.frombuffer(bytearray(raw_l), dtype=np.int16)
+    right = np.frombuffer(bytearray(raw_r), dtype=np.int16)
+    stereo = np.stack((left, right), axis=1)
 
 # === Dump WAV ===
 if args.wav:
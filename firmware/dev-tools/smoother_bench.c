@@ -0,0 +1,107 @@
+/**
+ * @file smoother_bench.c
+ * @brief Host benchmark of the parameter smoother: cost per audio block settled and ramping, and the largest step per frame.
+ *
+ * gcc -O2 -I../Aware/Inc smoother_bench.c ../Aware/Src/dsp/smoother.c -lm -o smoother_bench && ./smoother_bench
+ *
+ * A block is 32 frames as in the firmware. The ramps are those of the reverb wet (linear, 20 ms) and size (one-pole,
+ * 60 ms) from one end of their range to the other. Cycles on the target are in the param_apply_cycles and the stage
+ * timing of the audio task.
+ */
+#include <stdio.h>
+#include <time.h>
+
+#include "dsp/smoother.h"
+
+#define FS 48000.0f
+#define FRAMES 32
+#define BLOCKS 2000000
+#define EPSILON 5e-4f // of the reverb size, under one sample of the longest delay
+
+static double now_ns(void) {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec * 1e9 + t.tv_nsec;
+}
+
+// the consumer of the reverb: per-frame value from the block, or the settled value for all of it
+static float consume(smoother_t* s, float* sink) {
+    float out[FRAMES];
+    float acc = 0.0f;
+    if (smoother_process_block(s, out, FRAMES)) {
+        for (int i = 0; i < FRAMES; i++)
+            acc += out[i];
+    } else {
+        acc = s->value * FRAMES;
+    }
+    *sink += acc;
+    return acc;
+}
+
+// average ns per block, a new target every retarget blocks (0 = never)
+static double bench_block(smoother_mode_t mode, float time_ms, int retarget) {
+    smoother_t s;
+    smoother_init(&s, mode, 0.3f, time_ms, FS, EPSILON);
+    float sink = 0.0f;
+    double t0 = now_ns();
+    for (int b = 0; b < BLOCKS; b++) {
+        if (retarget && b % retarget == 0)
+            smoother_set_target(&s, (b / retarget) & 1 ? 0.3f : 1.0f);
+        consume(&s, &sink);
+    }
+    double ns = (now_ns() - t0) / BLOCKS;
+    if (sink == 12345.0f)
+        printf(" ");
+    return ns;
+}
+
+// the same with smoother_next() per frame
+static double bench_frame(smoother_mode_t mode, float time_ms, int retarget) {
+    smoother_t s;
+    smoother_init(&s, mode, 0.3f, time_ms, FS, EPSILON);
+    volatile float sink = 0.0f;
+    double t0 = now_ns();
+    for (int b = 0; b < BLOCKS; b++) {
+        if (retarget && b % retarget == 0)
+            smoother_set_target(&s, (b / retarget) & 1 ? 0.3f : 1.0f);
+        float acc = 0.0f;
+        for (int i = 0; i < FRAMES; i++)
+            acc += smoother_next(&s);
+        sink += acc;
+    }
+    return (now_ns() - t0) / BLOCKS;
+}
+
+// largest change between two frames and frames until settled for a jump over the whole range
+static void ramp_shape(smoother_mode_t mode, float time_ms, float from, float to) {
+    smoother_t s;
+    smoother_init(&s, mode, from, time_ms, FS, EPSILON);
+    smoother_set_target(&s, to);
+    float last = from, max_step = 0.0f;
+    int frames = 0;
+    while (!smoother_settled(&s)) {
+        float out[FRAMES];
+        smoother_process_block(&s, out, FRAMES);
+        for (int i = 0; i < FRAMES; i++) {
+            float d = fabsf(out[i] - last);
+            if (d > max_step)
+                max_step = d;
+            last = out[i];
+        }
+        frames += FRAMES;
+    }
+    printf("  %-9s %5.1f ms  %.3f -> %.3f: max step %.5f per frame, settled after %d frames\n",
+           mode == SMOOTHER_LINEAR ? "linear" : "one-pole", time_ms, from, to, max_step, frames);
+}
+
+int main(void) {
+    printf("ramp shape (a jump of the whole range moves in one step without smoothing)\n");
+    ramp_shape(SMOOTHER_LINEAR, 20.0f, 0.0f, 1.0f);
+    ramp_shape(SMOOTHER_ONE_POLE, 60.0f, 0.3f, 1.0f);
+
+    printf("\nns per %d-frame block       block    per frame\n", FRAMES);
+    printf("  settled                %7.2f  %7.2f\n", bench_block(SMOOTHER_ONE_POLE, 60.0f, 0), bench_frame(SMOOTHER_ONE_POLE, 60.0f, 0));
+    printf("  linear ramping         %7.2f  %7.2f\n", bench_block(SMOOTHER_LINEAR, 20.0f, 20), bench_frame(SMOOTHER_LINEAR, 20.0f, 20));
+    printf("  one-pole ramping       %7.2f  %7.2f\n", bench_block(SMOOTHER_ONE_POLE, 60.0f, 200), bench_frame(SMOOTHER_ONE_POLE, 60.0f, 200));
+    return 0;
+}
@@ -0,0 +1,114 @@
+/**
+ * @file stretch_match_test.c
+ * @brief Host test of the WSOLA similarity search (dsp/stretch_match.h): the chosen grain start follows a time-shifted copy.
+ *
+ * gcc -O2 -Ihost -I../Aware/Inc stretch_match_test.c -lm -o stretch_match_test && ./stretch_match_test
+ *
+ * Each case takes the reference from a signal at REF_POS like stretch_search_begin(), then searches a take that holds the
+ * same signal delayed by d, for every d on the candidate grid within STRETCH_SEARCH_RADIUS. The candidates are scored as in
+ * stretch_search_step(). The delayed copy also gets louder across the search window, up to 4x, so that a candidate
+ * later in the window has more energy than the one that matches. The search passes if it picks COPY_POS + d every time,
+ * the candidate the reference was copied to.
+ * The raw dot product the search used before is run alongside and its misses printed, for comparison only.
+ * Signals: white noise, low-passed noise (neighbouring candidates correlate) and a low-passed noise with a tone mixed in.
+ * Both play directions. Exits with 1 if a check fails.
+ */
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "dsp/stretch_match.h"
+#include "project_config.h"
+
+#define TAKE_LEN 8192
+#define REF_POS 2048  // the reference is taken here
+#define COPY_POS 6144 // and copied to here + d, the middle of the search window
+#define NUM_CANDS (2 * STRETCH_SEARCH_RADIUS / STRETCH_SEARCH_STEP + 1)
+
+static int32_t take[TAKE_LEN];
+
+// Mono sample of the take, in the range of stretch_mono().
+static int32_t sample(double x) {
+    x = x * 8192.0;
+    return x > 32767.0 ? 32767 : (x < -32768.0 ? -32768 : (int32_t) x);
+}
+
+// Uniform in [-1, 1), the same sequence on every host.
+static double noise(uint32_t* state) {
+    *state = *state * 1664525u + 1013904223u;
+    return (double) (int32_t) *state / 2147483648.0;
+}
+
+// Signal s(n) for n in [0, TAKE_LEN): lowpass sets the one-pole coefficient of the noise, tone mixes in a sine of that period.
+static void make_signal(double* s, double lowpass, double tone, uint32_t seed) {
+    double y = 0.0;
+    for (int n = 0; n < TAKE_LEN; n++) {
+        y = lowpass * y + (1.0 - lowpass) * noise(&seed);
+        s[n] = y / (1.0 - lowpass) * 0.3 + (tone > 0.0 ? 0.3 * sin(2.0 * M_PI * n / tone) : 0.0);
+    }
+}
+
+// Position of the best candidate from first on, scored normalized or by the raw dot product.
+static int32_t search(const int32_t* ref, uint32_t first, int32_t dir, bool normalized) {
+    float best = -INFINITY;
+    int32_t best_pos = -1;
+    for (uint32_t c = 0; c < NUM_CANDS; c++) {
+        uint32_t pos = first + c * STRETCH_SEARCH_STEP;
+        stretch_match_t m = {0};
+        for (uint32_t k = 0; k < STRETCH_CORR_LEN; k++)
+            stretch_match_add(&m, ref[k], take[pos + dir * (int32_t) k]);
+        float score = normalized ? stretch_match_score(&m) : (float) m.cross;
+        if (score > best) {
+            best = score;
+            best_pos = (int32_t) pos;
+        }
+    }
+    return best_pos;
+}
+
+static int run_case(const char* name, double lowpass, double tone) {
+    static double s[TAKE_LEN];
+    int misses = 0, raw_misses = 0, total = 0;
+
+    for (uint32_t seed = 1; seed <= 8; seed++) {
+        make_signal(s, lowpass, tone, seed);
+        for (int32_t dir = -2; dir <= 2; dir += 4) {
+            int32_t ref[STRETCH_CORR_LEN];
+            for (uint32_t k = 0; k < STRETCH_CORR_LEN; k++)
+                ref[k] = sample(s[REF_POS + dir * (int32_t) k]);
+
+            for (int32_t d = -STRETCH_SEARCH_RADIUS; d <= STRETCH_SEARCH_RADIUS; d += STRETCH_SEARCH_STEP) {
+                // the signal delayed so that its frame REF_POS lands on COPY_POS + d, 1x to 4x louder across the window
+                for (int32_t n = 0; n < TAKE_LEN; n++) {
+                    int32_t src = n - (COPY_POS + d) + REF_POS;
+                    double gain = 1.0 + 3.0 * (n - (COPY_POS - 2 * STRETCH_SEARCH_RADIUS)) / (4.0 * STRETCH_SEARCH_RADIUS);
+                    gain = gain < 1.0 ? 1.0 : (gain > 4.0 ? 4.0 : gain);
+                    take[n] = src >= 0 && src < TAKE_LEN ? sample(s[src] * gain) : 0;
+                }
+
+                uint32_t first = COPY_POS - STRETCH_SEARCH_RADIUS;
+                int32_t want = COPY_POS + d;
+                int32_t got = search(ref, first, dir, true);
+                if (got != want) {
+                    if (misses < 5)
+                        printf("  %s seed %u dir %+d: shift %+d found at %+d\n", name, seed, dir, d, got - COPY_POS);
+                    misses++;
+                }
+                raw_misses += search(ref, first, dir, false) != want;
+                total++;
+            }
+        }
+    }
+
+    printf("%-22s normalized: %3d of %d missed, raw dot product: %3d missed\n", name, misses, total, raw_misses);
+    return misses == 0;
+}
+
+int main(void) {
+    int ok = 1;
+    ok &= run_case("white noise", 0.0, 0.0);
+    ok &= run_case("low-passed noise", 0.9, 0.0);
+    ok &= run_case("noise and a tone", 0.9, 97.0);
+    printf(ok ? "pass\n" : "FAIL\n");
+    return ok ? 0 : 1;
+}